@@ -0,0 +1,450 @@
+/// acticompact - merges overlapping logs written by actilog into one
+///               sorted, duplicate-free log per host and day.
+///
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <Shlwapi.h>
+#include "logparse.h"
+#include "gzipreader.h"
+
+#pragma comment(lib, "shlwapi.lib")
+
+static const TCHAR* AppInfo = TEXT("acticompact 1.0.4");
+static const DWORD ReadBufSize = 64 * 1024;
+static const DWORD WriteBufSize = 256 * 1024;
+static const size_t MaxLineLength = 4096;
+static const int MaxHostLength = 64;
+static const int MaxSameSecond = 4096;
+
+enum _long_options {
+	SELECT_HELP = 0x1,
+	SELECT_OUTPUT_DIR
+};
+
+static struct option long_options[] = {
+	{ "output-dir",    required_argument, 0, SELECT_OUTPUT_DIR },
+	{ "help",          no_argument, 0, SELECT_HELP },
+	{ NULL,            0, 0, 0 }
+};
+
+
+/// One input log, read sequentially in fixed-size blocks. pLine holds the
+/// current line, ullUtc its time stamp; lines without one (e.g. written
+/// by a crashed instance in the middle of a line) keep the time stamp and
+/// day of the line before them, so they stay where they were. Logs
+/// written with --gzip are inflated through pGzip on the way.
+struct Input {
+	const TCHAR* pszFile;
+	char szHost[MaxHostLength];
+	UINT nSeq;
+	HANDLE hFile;
+	GzipReader* pGzip;
+	BYTE* pGzipBuffers;
+	char* pBuf;
+	DWORD cbBuf;
+	DWORD iBuf;
+	char* pLine;
+	size_t cbLine;
+	ULONGLONG ullUtc;
+	char szDay[11];
+};
+
+
+/// Buffered output to the file of one host and day. szLastDay is the
+/// latest day of the host that has a file yet.
+struct Output {
+	HANDLE hFile;
+	char* pBuf;
+	DWORD cbBuf;
+	char szDay[11];
+	char szLastDay[11];
+	const char* pszHost;
+	UINT nFiles;
+	bool bOk;
+};
+
+
+/// Hashes of the lines written with the current time stamp. Duplicates
+/// can only have the same time stamp, so the set is cleared whenever the
+/// time stamp changes and stays small.
+struct SeenLines {
+	ULONGLONG ullUtc;
+	ULONGLONG aullHashes[MaxSameSecond];
+	int nHashes;
+};
+
+
+const TCHAR* pszOutputDir = TEXT(".");
+ULONGLONG ullLines = 0;
+ULONGLONG ullDuplicates = 0;
+
+
+ULONGLONG hashLine(const char* p, size_t cb)
+{
+	// FNV-1a, 64 bits
+	ULONGLONG h = 14695981039346656037ULL;
+	for (size_t i = 0; i < cb; ++i)
+		h = (h ^ (BYTE)p[i]) * 1099511628211ULL;
+	return h;
+}
+
+
+void hostOf(const TCHAR* pszSpec, Input& in)
+{
+	// "host=file", or the file name up to the first dot
+	const TCHAR* pszEquals = _tcschr(pszSpec, TEXT('='));
+	const TCHAR* pszHost = pszEquals? pszSpec : PathFindFileName(pszSpec);
+	const TCHAR* pszEnd = pszEquals? pszEquals : _tcschr(pszHost, TEXT('.'));
+	size_t cch = pszEnd? pszEnd - pszHost : _tcslen(pszHost);
+	if (cch >= MaxHostLength)
+		cch = MaxHostLength - 1;
+	for (size_t i = 0; i < cch; ++i)
+		in.szHost[i] = (char)pszHost[i];
+	in.szHost[cch] = 0;
+	in.pszFile = pszEquals? pszEquals + 1 : pszSpec;
+}
+
+
+bool readLine(Input& in)
+{
+	in.cbLine = 0;
+	bool bAny = false;
+	for (;;) {
+		if (in.iBuf == in.cbBuf) {
+			in.iBuf = 0;
+			if (in.pGzip != NULL)
+				in.cbBuf = in.pGzip->read((BYTE*)in.pBuf, ReadBufSize);
+			else if (!ReadFile(in.hFile, in.pBuf, ReadBufSize, &in.cbBuf, NULL))
+				in.cbBuf = 0;
+			if (in.cbBuf == 0)
+				return bAny;
+		}
+		const char c = in.pBuf[in.iBuf++];
+		bAny = true;
+		if (c == '\n') {
+			if (in.cbLine > 0 && in.pLine[in.cbLine - 1] == '\r')
+				--in.cbLine;
+			return true;
+		}
+		if (in.cbLine < MaxLineLength)
+			in.pLine[in.cbLine++] = c;
+	}
+}
+
+
+bool advance(Input& in)
+{
+	while (readLine(in)) {
+		ULONGLONG ullUtc;
+		if (LogParser::parseTimestamp(in.pLine, in.cbLine, &ullUtc)) {
+			in.ullUtc = ullUtc;
+			memcpy(in.szDay, in.pLine, 10);
+			in.szDay[10] = 0;
+		}
+		else if (in.ullUtc == 0 || in.cbLine == 0) {
+			// nothing to attach it to
+			continue;
+		}
+		return true;
+	}
+	return false;
+}
+
+
+bool openInput(Input& in)
+{
+	const bool bCompressed = GzipReader::isGzipFile(in.pszFile);
+	in.hFile = CreateFile(in.pszFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (in.hFile == INVALID_HANDLE_VALUE)
+		return false;
+	in.pBuf = (char*)malloc(ReadBufSize);
+	in.pLine = (char*)malloc(MaxLineLength);
+	in.cbBuf = 0;
+	in.iBuf = 0;
+	in.ullUtc = 0;
+	if (bCompressed) {
+		in.pGzipBuffers = (BYTE*)malloc(GzipReader::InputSize + GzipReader::WindowSize);
+		in.pGzip = new GzipReader;
+		if (in.pGzipBuffers == NULL)
+			return false;
+		in.pGzip->attach(in.hFile, in.pGzipBuffers, in.pGzipBuffers + GzipReader::InputSize);
+	}
+	return in.pBuf != NULL && in.pLine != NULL;
+}
+
+
+void closeInput(Input& in)
+{
+	free(in.pBuf);
+	free(in.pLine);
+	in.pBuf = NULL;
+	in.pLine = NULL;
+	delete in.pGzip;
+	free(in.pGzipBuffers);
+	in.pGzip = NULL;
+	in.pGzipBuffers = NULL;
+	if (in.hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(in.hFile);
+	in.hFile = INVALID_HANDLE_VALUE;
+}
+
+
+void flushOutput(Output& out)
+{
+	DWORD dwWritten;
+	if (out.cbBuf > 0 && out.hFile != INVALID_HANDLE_VALUE)
+		out.bOk = WriteFile(out.hFile, out.pBuf, out.cbBuf, &dwWritten, NULL) && dwWritten == out.cbBuf && out.bOk;
+	out.cbBuf = 0;
+}
+
+
+void closeOutput(Output& out)
+{
+	flushOutput(out);
+	if (out.hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(out.hFile);
+	out.hFile = INVALID_HANDLE_VALUE;
+	out.szDay[0] = 0;
+}
+
+
+void writeLine(Output& out, const Input& in)
+{
+	if (strcmp(out.szDay, in.szDay) != 0) {
+		// local time may step back (end of daylight saving time) into a
+		// day written before, and then forward into it again; append to
+		// it instead of starting it over
+		const bool bBack = strcmp(in.szDay, out.szLastDay) <= 0;
+		closeOutput(out);
+		TCHAR szFile[MAX_PATH];
+		_sntprintf(szFile, MAX_PATH, TEXT("%s\\%s-%s.log"), pszOutputDir, out.pszHost, in.szDay);
+		out.hFile = CreateFile(szFile, bBack? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ, NULL, bBack? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (out.hFile == INVALID_HANDLE_VALUE) {
+			fprintf(stderr, "Error: cannot create file '%s'\n", szFile);
+			out.bOk = false;
+			return;
+		}
+		strcpy(out.szDay, in.szDay);
+		if (!bBack) {
+			strcpy(out.szLastDay, in.szDay);
+			++out.nFiles;
+		}
+	}
+	if (out.cbBuf + in.cbLine + 2 > WriteBufSize)
+		flushOutput(out);
+	memcpy(out.pBuf + out.cbBuf, in.pLine, in.cbLine);
+	out.cbBuf += (DWORD)in.cbLine;
+	out.pBuf[out.cbBuf++] = '\r';
+	out.pBuf[out.cbBuf++] = '\n';
+}
+
+
+inline bool before(const Input* a, const Input* b)
+{
+	// equal time stamps keep the order of the inputs, so that the lines
+	// of one interval are never interleaved with those of another file
+	return a->ullUtc < b->ullUtc || (a->ullUtc == b->ullUtc && a->nSeq < b->nSeq);
+}
+
+
+void siftDown(Input** apHeap, int nHeap, int i)
+{
+	for (;;) {
+		int nMin = i;
+		const int l = 2 * i + 1;
+		const int r = l + 1;
+		if (l < nHeap && before(apHeap[l], apHeap[nMin]))
+			nMin = l;
+		if (r < nHeap && before(apHeap[r], apHeap[nMin]))
+			nMin = r;
+		if (nMin == i)
+			return;
+		Input* pTmp = apHeap[i];
+		apHeap[i] = apHeap[nMin];
+		apHeap[nMin] = pTmp;
+		i = nMin;
+	}
+}
+
+
+bool mergeHost(Input* aInputs, int nInputs, Output& out, SeenLines& seen)
+{
+	// k-way merge: only the current line of every input is held in memory
+	Input** apHeap = (Input**)malloc(nInputs * sizeof(Input*));
+	int nHeap = 0;
+	for (int i = 0; i < nInputs; ++i) {
+		if (!openInput(aInputs[i])) {
+			fprintf(stderr, "Error: cannot read '%s'\n", aInputs[i].pszFile);
+			out.bOk = false;
+		}
+		else if (advance(aInputs[i])) {
+			apHeap[nHeap++] = &aInputs[i];
+		}
+	}
+	for (int i = nHeap / 2 - 1; i >= 0; --i)
+		siftDown(apHeap, nHeap, i);
+	seen.nHashes = 0;
+	seen.ullUtc = 0;
+	while (nHeap > 0 && out.bOk) {
+		Input& in = *apHeap[0];
+		++ullLines;
+		if (in.ullUtc != seen.ullUtc) {
+			seen.ullUtc = in.ullUtc;
+			seen.nHashes = 0;
+		}
+		const ULONGLONG ullHash = hashLine(in.pLine, in.cbLine);
+		bool bDuplicate = false;
+		for (int i = 0; i < seen.nHashes && !bDuplicate; ++i)
+			bDuplicate = seen.aullHashes[i] == ullHash;
+		if (bDuplicate) {
+			++ullDuplicates;
+		}
+		else {
+			if (seen.nHashes < MaxSameSecond)
+				seen.aullHashes[seen.nHashes++] = ullHash;
+			writeLine(out, in);
+		}
+		if (!advance(in))
+			apHeap[0] = apHeap[--nHeap];
+		siftDown(apHeap, nHeap, 0);
+	}
+	closeOutput(out);
+	for (int i = 0; i < nInputs; ++i) {
+		// a damaged member ends its input early; the rest is not lost
+		// silently
+		if (aInputs[i].pGzip != NULL && aInputs[i].pGzip->failed()) {
+			fprintf(stderr, "Error: '%s' is corrupt or truncated\n", aInputs[i].pszFile);
+			out.bOk = false;
+		}
+		closeInput(aInputs[i]);
+	}
+	free(apHeap);
+	return out.bOk;
+}
+
+
+void usage()
+{
+	printf("%s - merges logs written by actilog into one sorted log per\n"
+		"host and day, dropping duplicated lines.\n"
+		"\n"
+		"Usage: acticompact [options] [host=]file [[host=]file...]\n"
+		"\n"
+		"  -o dir\n"
+		"  --output-dir dir\n"
+		"     write '<host>-<YYYY-MM-DD>.log' files to 'dir', replacing\n"
+		"     existing ones (default: current directory)\n"
+		"  -h\n"
+		"  -?\n"
+		"  --help\n"
+		"     show this help\n"
+		"\n"
+		"The host of a file is its name up to the first dot unless given\n"
+		"as 'host=file'. Lines with the same time stamp keep the order of\n"
+		"the files on the command line; a line that has already been\n"
+		"written with the same time stamp is dropped. Each file is read\n"
+		"sequentially with a buffer of %u KB; files written with actilog\n"
+		"--gzip are inflated as they are read.\n"
+		"\n",
+		AppInfo,
+		ReadBufSize / 1024);
+}
+
+
+int main(int argc, TCHAR* argv[])
+{
+	for (;;) {
+		int option_index = 0;
+		int c = getopt_long(argc, argv, "h?o:", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+		case 'o':
+			// fall-through
+		case SELECT_OUTPUT_DIR:
+			pszOutputDir = optarg;
+			break;
+		case '?':
+			// fall-through
+		case 'h':
+			// fall-through
+		case SELECT_HELP:
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind >= argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+	CreateDirectory(pszOutputDir, NULL);
+	const int nInputs = argc - optind;
+	Input* aInputs = (Input*)malloc(nInputs * sizeof(Input));
+	for (int i = 0; i < nInputs; ++i) {
+		hostOf(argv[optind + i], aInputs[i]);
+		aInputs[i].nSeq = i;
+		aInputs[i].hFile = INVALID_HANDLE_VALUE;
+		aInputs[i].pGzip = NULL;
+		aInputs[i].pGzipBuffers = NULL;
+		aInputs[i].pBuf = NULL;
+		aInputs[i].pLine = NULL;
+	}
+	// group the inputs by host, keeping their order within a host, so
+	// that only one output file is open at a time
+	for (int i = 1; i < nInputs; ++i) {
+		for (int j = i; j > 0 && strcmp(aInputs[j].szHost, aInputs[j - 1].szHost) < 0; --j) {
+			Input tmp = aInputs[j];
+			aInputs[j] = aInputs[j - 1];
+			aInputs[j - 1] = tmp;
+		}
+	}
+	Output out;
+	out.hFile = INVALID_HANDLE_VALUE;
+	out.pBuf = (char*)malloc(WriteBufSize);
+	out.cbBuf = 0;
+	out.szDay[0] = 0;
+	out.nFiles = 0;
+	out.bOk = true;
+	SeenLines* pSeen = (SeenLines*)malloc(sizeof(SeenLines));
+	for (int i = 0; i < nInputs && out.bOk; ) {
+		int n = 1;
+		while (i + n < nInputs && strcmp(aInputs[i + n].szHost, aInputs[i].szHost) == 0)
+			++n;
+		out.pszHost = aInputs[i].szHost;
+		out.szLastDay[0] = 0;
+		mergeHost(aInputs + i, n, out, *pSeen);
+		i += n;
+	}
+	free(pSeen);
+	free(out.pBuf);
+	free(aInputs);
+	if (!out.bOk) {
+		fprintf(stderr, "Fatal error: compaction failed\n");
+		return EXIT_FAILURE;
+	}
+	printf("%I64u lines read, %I64u duplicates dropped, %u files written to '%s'\n", ullLines, ullDuplicates, out.nFiles, pszOutputDir);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,420 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "recordreader.h"
+#include "logindex.h"
+#include "keyclass.h"
+#include "parquet.h"
+
+static const TCHAR* AppInfo = TEXT("actiexport 1.0.4");
+static const UINT DefaultRowGroupSize = 16384;
+static const ULONGLONG UnixEpoch = 116444736000000000ULL; // 1970-01-01 in FILETIME units
+static const ULONGLONG SeekSlack = 36000000000ULL; // one hour in FILETIME units
+
+enum _long_options {
+	SELECT_HELP = 0x1,
+	SELECT_OUTPUT_FILE,
+	SELECT_ROWS,
+	SELECT_THREADS,
+	SELECT_DIRECT,
+	SELECT_SINCE,
+	SELECT_UNTIL
+};
+
+static struct option long_options[] = {
+	{ "output",        required_argument, 0, SELECT_OUTPUT_FILE },
+	{ "rows",          required_argument, 0, SELECT_ROWS },
+	{ "threads",       required_argument, 0, SELECT_THREADS },
+	{ "direct",        no_argument, 0, SELECT_DIRECT },
+	{ "since",         required_argument, 0, SELECT_SINCE },
+	{ "until",         required_argument, 0, SELECT_UNTIL },
+	{ "help",          no_argument, 0, SELECT_HELP },
+	{ NULL,            0, 0, 0 }
+};
+
+enum Kind {
+	KindInterval,
+	KindPartial,
+	KindRecovered
+};
+static const char* KindLabels[] = { "interval", "partial", "recovered" };
+
+enum Field {
+	FieldMove = 1,
+	FieldWheel = 2,
+	FieldClick = 4,
+	FieldDoubleClick = 8,
+	FieldKeys = 16,
+	FieldKeyClasses = 32,
+	FieldWarp = 64
+};
+
+
+/// Collects the lines belonging to one interval into a row of the
+/// column buffers. A record starts with INTERVAL, PARTIAL or RECOVER;
+/// the INTERVAL that follows a PARTIAL belongs to the same record. Logs
+/// written before INTERVAL existed are grouped by timestamp. Only lines
+/// stamped in [ullSince, ullUntil) are exported.
+struct Exporter {
+	ParquetWriter writer;
+	int nTime, nKind, nSecs, nMouseDist, nMouseMeters, nClicks, nDoubleClicks, nWheel;
+	int aKeys[256];
+	char aKeyNames[256][8];
+	int aKeyClasses[NumKeyClasses];
+	char aKeyClassNames[NumKeyClasses][24];
+	int nWarps, nWarpDist;
+	UINT nRows;
+	ULONGLONG ullRecords;
+	bool bOpen;
+	bool bImplicit;
+	Kind kind;
+	ULONGLONG ullUtc;
+	DWORD dwSeen;
+	ULONGLONG ullSince;
+	ULONGLONG ullUntil;
+	bool bPastEnd;
+	bool bOk;
+};
+
+
+void defineColumns(Exporter& x)
+{
+	ParquetWriter& w = x.writer;
+	x.nTime = w.addColumn("time", ParquetWriter::Timestamp);
+	x.nKind = w.addColumn("kind", ParquetWriter::Enum, KindLabels, 3);
+	x.nSecs = w.addColumn("secs", ParquetWriter::Double);
+	x.nMouseDist = w.addColumn("mouse_px", ParquetWriter::Double);
+	x.nMouseMeters = w.addColumn("mouse_m", ParquetWriter::Double);
+	x.nClicks = w.addColumn("clicks", ParquetWriter::Int32);
+	x.nDoubleClicks = w.addColumn("double_clicks", ParquetWriter::Int32);
+	x.nWheel = w.addColumn("wheel", ParquetWriter::Int32);
+	for (int i = 0; i < 256; ++i) {
+		_snprintf(x.aKeyNames[i], sizeof(x.aKeyNames[i]), "key_%d", i);
+		x.aKeys[i] = w.addColumn(x.aKeyNames[i], ParquetWriter::Int32);
+	}
+	for (int i = 0; i < NumKeyClasses; ++i) {
+		_snprintf(x.aKeyClassNames[i], sizeof(x.aKeyClassNames[i]), "keys_%s", KeyClassTable::name(i));
+		x.aKeyClasses[i] = w.addColumn(x.aKeyClassNames[i], ParquetWriter::Int32);
+	}
+	x.nWarps = w.addColumn("warps", ParquetWriter::Int32);
+	x.nWarpDist = w.addColumn("warp_px", ParquetWriter::Double);
+}
+
+
+void endRecord(Exporter& x)
+{
+	if (!x.bOpen)
+		return;
+	x.bOpen = false;
+	++x.ullRecords;
+	if (++x.nRows == x.writer.rowGroupSize()) {
+		x.bOk = x.bOk && x.writer.writeRowGroup(x.nRows);
+		x.nRows = 0;
+	}
+}
+
+
+void beginRecord(Exporter& x, ULONGLONG ullUtc, Kind kind, double fSecs, bool bImplicit)
+{
+	endRecord(x);
+	ParquetWriter& w = x.writer;
+	const UINT r = x.nRows;
+	w.int64Column(x.nTime)[r] = (LONGLONG)(ullUtc - UnixEpoch) / 10;
+	w.int32Column(x.nKind)[r] = kind;
+	w.doubleColumn(x.nSecs)[r] = fSecs;
+	w.doubleColumn(x.nMouseDist)[r] = 0;
+	w.doubleColumn(x.nMouseMeters)[r] = 0;
+	w.int32Column(x.nClicks)[r] = 0;
+	w.int32Column(x.nDoubleClicks)[r] = 0;
+	w.int32Column(x.nWheel)[r] = 0;
+	for (int i = 0; i < 256; ++i)
+		w.int32Column(x.aKeys[i])[r] = 0;
+	for (int i = 0; i < NumKeyClasses; ++i)
+		w.int32Column(x.aKeyClasses[i])[r] = 0;
+	w.int32Column(x.nWarps)[r] = 0;
+	w.doubleColumn(x.nWarpDist)[r] = 0;
+	x.bOpen = true;
+	x.bImplicit = bImplicit;
+	x.kind = kind;
+	x.ullUtc = ullUtc;
+	x.dwSeen = 0;
+}
+
+
+void addRecord(Exporter& x, const ParsedRecord& parsed)
+{
+	const LogRecord& rec = parsed.rec;
+	ULONGLONG ullUtc;
+	if (!LogParser::toUtc(rec, &ullUtc) || ullUtc < x.ullSince)
+		return;
+	if (ullUtc >= x.ullUntil) {
+		endRecord(x);
+		x.bPastEnd = true;
+		return;
+	}
+	switch (rec.type)
+	{
+	case RecordInterval:
+		// at shutdown actilog writes PARTIAL, then INTERVAL with the
+		// counters of that same partial interval
+		if (x.bOpen && x.kind == KindPartial && x.dwSeen == 0)
+			return;
+		beginRecord(x, ullUtc, KindInterval, 1e-9 * (double)(rec.ullEndNs - rec.ullStartNs), false);
+		return;
+	case RecordPartial:
+		beginRecord(x, ullUtc, KindPartial, rec.fValue, false);
+		return;
+	case RecordRecover:
+		beginRecord(x, ullUtc, KindRecovered, 0, false);
+		return;
+	}
+	DWORD dwField = 0;
+	switch (rec.type)
+	{
+	case RecordMove: dwField = FieldMove; break;
+	case RecordWheel: dwField = FieldWheel; break;
+	case RecordWarp: dwField = FieldWarp; break;
+	case RecordClick: dwField = FieldClick; break;
+	case RecordDoubleClick: dwField = FieldDoubleClick; break;
+	case RecordKeyStat: dwField = FieldKeys; break;
+	case RecordKeyClass: dwField = FieldKeyClasses; break;
+	}
+	if (dwField == 0) {
+		// CLOCK, START, STOP etc. end whatever record is open
+		endRecord(x);
+		return;
+	}
+	if (!x.bOpen || (x.dwSeen & dwField) || (x.bImplicit && ullUtc != x.ullUtc))
+		beginRecord(x, ullUtc, KindInterval, 0, true);
+	x.dwSeen |= dwField;
+	ParquetWriter& w = x.writer;
+	const UINT r = x.nRows;
+	switch (dwField)
+	{
+	case FieldMove:
+		w.doubleColumn(x.nMouseDist)[r] = rec.fValue;
+		w.doubleColumn(x.nMouseMeters)[r] = rec.fMeters;
+		break;
+	case FieldWheel:
+		w.int32Column(x.nWheel)[r] = rec.nCount;
+		break;
+	case FieldWarp:
+		w.int32Column(x.nWarps)[r] = rec.nCount;
+		w.doubleColumn(x.nWarpDist)[r] = rec.fValue;
+		break;
+	case FieldClick:
+		w.int32Column(x.nClicks)[r] = rec.nCount;
+		break;
+	case FieldDoubleClick:
+		w.int32Column(x.nDoubleClicks)[r] = rec.nCount;
+		break;
+	case FieldKeys:
+		for (int i = 0; i < rec.nCount; ++i)
+			w.int32Column(x.aKeys[i])[r] = parsed.anKeys[i];
+		break;
+	case FieldKeyClasses:
+		for (int i = 0; i < rec.nCount && i < NumKeyClasses; ++i)
+			w.int32Column(x.aKeyClasses[i])[r] = parsed.anKeys[i];
+		break;
+	}
+}
+
+
+bool exportLog(Exporter& x, RecordReader& reader, const TCHAR* pszLogFile, bool bDirect)
+{
+	// only the current batch of records and the current row group are
+	// ever held in memory
+	if (!reader.open(pszLogFile, RecordReader::DefaultBatchSize, bDirect))
+		return false;
+	// with a time index everything before --since is skipped unread. The
+	// entry must be earlier than --since, as more lines share its second.
+	// Stamps of the hour repeated when daylight saving time ends convert
+	// to UTC one way, while a live index holds the true UTC of each line,
+	// so the reader starts an hour early; addRecord() drops the surplus.
+	ULONGLONG ullOffset;
+	const ULONGLONG ullSeek = x.ullSince > SeekSlack? x.ullSince - SeekSlack : 1;
+	if (x.ullSince > 0 && LogIndex::lookup(pszLogFile, ullSeek - 1, &ullOffset) && ullOffset > 0 && !reader.seek(ullOffset)) {
+		reader.close();
+		return false;
+	}
+	x.bPastEnd = false;
+	UINT nRecords;
+	while (x.bOk && !x.bPastEnd && (nRecords = reader.next()) > 0)
+		for (UINT i = 0; i < nRecords && !x.bPastEnd; ++i)
+			addRecord(x, reader.record(i));
+	endRecord(x);
+	reader.close();
+	return x.bOk && !reader.failed();
+}
+
+
+bool parseTime(const TCHAR* pszTime, ULONGLONG* pullUtc)
+{
+	// "YYYY-MM-DD[ hh:mm:ss]" in local time, like the time stamps of the log
+	char szStamp[] = "0000-00-00 00:00:00 ";
+	const size_t cch = strlen(pszTime);
+	if (cch != 10 && cch != 19)
+		return false;
+	memcpy(szStamp, pszTime, cch);
+	return LogParser::parseTimestamp(szStamp, 20, pullUtc);
+}
+
+
+void usage()
+{
+	printf("%s - converts logs written by actilog to Parquet.\n"
+		"\n"
+		"Usage: actiexport [options] file [file...]\n"
+		"\n"
+		"  -o file\n"
+		"  --output file\n"
+		"     write to 'file' (default: first input file + '.parquet')\n"
+		"  --rows n\n"
+		"     rows per row group, which bounds the memory used\n"
+		"     (default: %u)\n"
+		"  --threads n\n"
+		"     encode columns on n threads (default: number of processors)\n"
+		"  --direct\n"
+		"     read unbuffered with several blocks in flight, bypassing the\n"
+		"     file cache; for large archives\n"
+		"  --since \"YYYY-MM-DD[ hh:mm:ss]\"\n"
+		"     export only lines stamped at or after this local time; with a\n"
+		"     time index (actilog --index) reading starts right there\n"
+		"  --until \"YYYY-MM-DD[ hh:mm:ss]\"\n"
+		"     export only lines stamped before this local time\n"
+		"  -h\n"
+		"  -?\n"
+		"  --help\n"
+		"     show this help\n"
+		"\n"
+		"Every interval becomes one row with the columns time, kind, secs,\n"
+		"mouse_px, mouse_m, clicks, double_clicks, wheel, key_0 to key_255,\n"
+		"keys_letters to keys_other for logs written with --key-classes, warps\n"
+		"and warp_px.\n"
+		"\n",
+		AppInfo,
+		DefaultRowGroupSize);
+}
+
+
+int main(int argc, TCHAR* argv[])
+{
+	const TCHAR* pszOutputFile = NULL;
+	UINT nRowGroupSize = DefaultRowGroupSize;
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	int nThreads = (int)si.dwNumberOfProcessors;
+	bool bDirect = false;
+	ULONGLONG ullSince = 0;
+	ULONGLONG ullUntil = ~0ULL;
+	for (;;) {
+		int option_index = 0;
+		int c = getopt_long(argc, argv, "h?o:", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+		case 'o':
+			// fall-through
+		case SELECT_OUTPUT_FILE:
+			pszOutputFile = optarg;
+			break;
+		case SELECT_ROWS:
+			nRowGroupSize = atoi(optarg);
+			if (nRowGroupSize == 0) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+		case SELECT_THREADS:
+			nThreads = atoi(optarg);
+			break;
+		case SELECT_DIRECT:
+			bDirect = true;
+			break;
+		case SELECT_SINCE:
+			if (!parseTime(optarg, &ullSince)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+		case SELECT_UNTIL:
+			if (!parseTime(optarg, &ullUntil)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+		case '?':
+			// fall-through
+		case 'h':
+			// fall-through
+		case SELECT_HELP:
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind >= argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+	TCHAR szOutputFile[MAX_PATH];
+	if (pszOutputFile == NULL) {
+		_sntprintf(szOutputFile, MAX_PATH, TEXT("%s.parquet"), argv[optind]);
+		pszOutputFile = szOutputFile;
+	}
+	Exporter* px = new Exporter;
+	Exporter& x = *px;
+	x.nRows = 0;
+	x.ullRecords = 0;
+	x.bOpen = false;
+	x.ullSince = ullSince;
+	x.ullUntil = ullUntil;
+	x.bOk = true;
+	defineColumns(x);
+	if (!x.writer.open(pszOutputFile, nRowGroupSize, nThreads)) {
+		fprintf(stderr, "Fatal error: cannot create file '%s'\n", pszOutputFile);
+		delete px;
+		return EXIT_FAILURE;
+	}
+	// the reader's buffers come from the arena, so every file after the
+	// first reuses them
+	Arena arena;
+	RecordReader reader(arena);
+	for (int i = optind; i < argc; ++i) {
+		arena.reset();
+		if (!exportLog(x, reader, argv[i], bDirect)) {
+			fprintf(stderr, "Fatal error: cannot export '%s'\n", argv[i]);
+			delete px;
+			return EXIT_FAILURE;
+		}
+	}
+	if (!x.writer.writeRowGroup(x.nRows) || !x.writer.close()) {
+		fprintf(stderr, "Fatal error: cannot write '%s'\n", pszOutputFile);
+		delete px;
+		return EXIT_FAILURE;
+	}
+	printf("%I64u records written to '%s'\n", x.ullRecords, pszOutputFile);
+	delete px;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,502 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "parquet.h"
+#include <string.h>
+
+// Parquet constants as defined in parquet.thrift
+enum {
+	TypeInt32 = 1,
+	TypeInt64 = 2,
+	TypeDouble = 5,
+	TypeByteArray = 6
+};
+enum {
+	EncodingPlain = 0,
+	EncodingPlainDictionary = 2,
+	EncodingRle = 3,
+	EncodingRleDictionary = 8
+};
+enum {
+	PageData = 0,
+	PageDictionary = 2
+};
+enum {
+	ConvertedUtf8 = 0,
+	ConvertedTimestampMicros = 10
+};
+enum {
+	RepetitionRequired = 0
+};
+
+static const char* Magic = "PAR1";
+static const char* CreatedBy = "actiexport 1.0.4";
+
+
+void ByteBuffer::append(const void* p, size_t cb)
+{
+	if (cbData + cb > cbAlloc) {
+		size_t cbNew = cbAlloc > 0? cbAlloc : 4096;
+		while (cbNew < cbData + cb)
+			cbNew *= 2;
+		BYTE* pNew = (BYTE*)realloc(pData, cbNew);
+		if (pNew == NULL)
+			return;
+		pData = pNew;
+		cbAlloc = cbNew;
+	}
+	memcpy(pData + cbData, p, cb);
+	cbData += cb;
+}
+
+
+void ByteBuffer::appendVarint(ULONGLONG ullValue)
+{
+	while (ullValue >= 0x80) {
+		append((BYTE)(ullValue | 0x80));
+		ullValue >>= 7;
+	}
+	append((BYTE)ullValue);
+}
+
+
+/// Just enough of the Thrift compact protocol for Parquet metadata.
+class ThriftWriter {
+public:
+	enum {
+		BoolTrue = 1,
+		BoolFalse = 2,
+		I32 = 5,
+		I64 = 6,
+		Binary = 8,
+		List = 9,
+		Struct = 12
+	};
+	ThriftWriter(ByteBuffer& out) : out(out), nDepth(0) { aLastId[0] = 0; }
+	void beginStruct()
+	{
+		aLastId[++nDepth] = 0;
+	}
+	void endStruct()
+	{
+		out.append((BYTE)0);
+		--nDepth;
+	}
+	void field(int nId, int nType)
+	{
+		const int nDelta = nId - aLastId[nDepth];
+		if (nDelta > 0 && nDelta <= 15) {
+			out.append((BYTE)((nDelta << 4) | nType));
+		}
+		else {
+			out.append((BYTE)nType);
+			out.appendVarint(zigzag(nId));
+		}
+		aLastId[nDepth] = nId;
+	}
+	void fieldI32(int nId, int nValue)
+	{
+		field(nId, I32);
+		i32(nValue);
+	}
+	void fieldI64(int nId, LONGLONG llValue)
+	{
+		field(nId, I64);
+		out.appendVarint(zigzag(llValue));
+	}
+	void fieldString(int nId, const char* psz)
+	{
+		field(nId, Binary);
+		string(psz);
+	}
+	void fieldStruct(int nId)
+	{
+		field(nId, Struct);
+		beginStruct();
+	}
+	void fieldList(int nId, int nElemType, int nSize)
+	{
+		field(nId, List);
+		list(nElemType, nSize);
+	}
+	void list(int nElemType, int nSize)
+	{
+		if (nSize < 15) {
+			out.append((BYTE)((nSize << 4) | nElemType));
+		}
+		else {
+			out.append((BYTE)(0xf0 | nElemType));
+			out.appendVarint(nSize);
+		}
+	}
+	void i32(int nValue)
+	{
+		out.appendVarint(zigzag(nValue));
+	}
+	void string(const char* psz)
+	{
+		const size_t cb = strlen(psz);
+		out.appendVarint(cb);
+		out.append(psz, cb);
+	}
+
+private:
+	static const int MaxDepth = 8;
+	ByteBuffer& out;
+	int aLastId[MaxDepth];
+	int nDepth;
+	static ULONGLONG zigzag(LONGLONG llValue)
+	{
+		return ((ULONGLONG)llValue << 1) ^ (ULONGLONG)(llValue >> 63);
+	}
+};
+
+
+static void writePageHeader(ByteBuffer& out, int nPageType, size_t cbPage, int nValues, int nEncoding)
+{
+	ThriftWriter t(out);
+	t.beginStruct();
+	t.fieldI32(1, nPageType);
+	t.fieldI32(2, (int)cbPage);
+	t.fieldI32(3, (int)cbPage);
+	if (nPageType == PageDictionary) {
+		t.fieldStruct(7);
+		t.fieldI32(1, nValues);
+		t.fieldI32(2, nEncoding);
+		t.endStruct();
+	}
+	else {
+		t.fieldStruct(5);
+		t.fieldI32(1, nValues);
+		t.fieldI32(2, nEncoding);
+		t.fieldI32(3, EncodingRle);
+		t.fieldI32(4, EncodingRle);
+		t.endStruct();
+	}
+	t.endStruct();
+}
+
+
+static void appendRleRuns(ByteBuffer& out, const int* aIndices, UINT nValues, int nBitWidth)
+{
+	// RLE/bit-packing hybrid using RLE runs only: long runs of the same
+	// dictionary index (typically the one for 0) collapse to two bytes
+	const int cbValue = (nBitWidth + 7) / 8;
+	for (UINT i = 0; i < nValues; ) {
+		UINT j = i + 1;
+		while (j < nValues && aIndices[j] == aIndices[i])
+			++j;
+		out.appendVarint((ULONGLONG)(j - i) << 1);
+		const UINT uValue = (UINT)aIndices[i];
+		for (int b = 0; b < cbValue; ++b)
+			out.append((BYTE)(uValue >> (8 * b)));
+		i = j;
+	}
+}
+
+
+static int bitWidth(int nDictionary)
+{
+	int nBits = 0;
+	while (nDictionary > (1 << nBits))
+		++nBits;
+	return nBits;
+}
+
+
+ParquetWriter::ParquetWriter()
+	: nColumns(0)
+	, hFile(INVALID_HANDLE_VALUE)
+	, ullOffset(0)
+	, ullRows(0)
+	, nRowGroupSize(0)
+	, nRows(0)
+	, nThreads(1)
+	, nNextColumn(0)
+	, nRowGroups(0)
+{
+	for (int i = 0; i < MAXIMUM_WAIT_OBJECTS; ++i)
+		aEncoders[i].aIndices = NULL;
+}
+
+
+ParquetWriter::~ParquetWriter()
+{
+	if (hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(hFile);
+	for (int i = 0; i < nColumns; ++i)
+		free(aColumns[i].pValues);
+	for (int i = 0; i < nThreads; ++i)
+		free(aEncoders[i].aIndices);
+}
+
+
+size_t ParquetWriter::valueSize(ColumnType type)
+{
+	return (type == Int32 || type == Enum)? sizeof(int) : sizeof(LONGLONG);
+}
+
+
+int ParquetWriter::addColumn(const char* pszName, ColumnType type, const char* const* apszLabels, int nLabels)
+{
+	if (nColumns >= MaxColumns || hFile != INVALID_HANDLE_VALUE)
+		return -1;
+	Column& col = aColumns[nColumns];
+	col.pszName = pszName;
+	col.type = type;
+	col.apszLabels = apszLabels;
+	col.nLabels = nLabels;
+	col.pValues = NULL;
+	col.cbDictionaryPage = 0;
+	col.bDictionary = false;
+	return nColumns++;
+}
+
+
+bool ParquetWriter::write(const void* p, size_t cb)
+{
+	DWORD dwWritten;
+	if (!WriteFile(hFile, p, (DWORD)cb, &dwWritten, NULL) || dwWritten != cb)
+		return false;
+	ullOffset += cb;
+	return true;
+}
+
+
+bool ParquetWriter::open(const TCHAR* pszFilename, UINT nRowGroupSize, int nThreads)
+{
+	this->nRowGroupSize = nRowGroupSize;
+	this->nThreads = nThreads <= 0? 1 : nThreads > MAXIMUM_WAIT_OBJECTS? MAXIMUM_WAIT_OBJECTS : nThreads;
+	for (int i = 0; i < this->nThreads; ++i) {
+		aEncoders[i].pWriter = this;
+		aEncoders[i].aIndices = (int*)malloc(nRowGroupSize * sizeof(int));
+		if (aEncoders[i].aIndices == NULL)
+			return false;
+	}
+	for (int i = 0; i < nColumns; ++i) {
+		aColumns[i].pValues = malloc(nRowGroupSize * valueSize(aColumns[i].type));
+		if (aColumns[i].pValues == NULL)
+			return false;
+	}
+	hFile = CreateFile(pszFilename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	ullOffset = 0;
+	return write(Magic, 4);
+}
+
+
+void ParquetWriter::encodeColumn(Column& col, Encoder& enc)
+{
+	// one column chunk: [dictionary page] data page, both uncompressed
+	col.chunk.clear();
+	col.cbDictionaryPage = 0;
+	col.bDictionary = false;
+	ByteBuffer& page = enc.page;
+	page.clear();
+	if (col.type == Int32 || col.type == Enum) {
+		const int* aValues = (const int*)col.pValues;
+		int aDictionary[MaxDictionary];
+		int nDictionary = 0;
+		int* aIndices = enc.aIndices;
+		if (col.type == Enum) {
+			memcpy(aIndices, aValues, nRows * sizeof(int));
+			nDictionary = col.nLabels;
+			for (int i = 0; i < col.nLabels; ++i) {
+				const DWORD cb = (DWORD)strlen(col.apszLabels[i]);
+				page.append(&cb, sizeof(cb));
+				page.append(col.apszLabels[i], cb);
+			}
+		}
+		else {
+			// open addressing over twice the dictionary size; gives up
+			// and falls back to plain encoding when the column is too diverse
+			static const int HashSize = 2 * MaxDictionary;
+			short aSlots[HashSize];
+			memset(aSlots, 0xff, sizeof(aSlots));
+			for (UINT r = 0; r < nRows && nDictionary >= 0; ++r) {
+				UINT h = ((UINT)aValues[r] * 2654435761u) % HashSize;
+				while (aSlots[h] >= 0 && aDictionary[aSlots[h]] != aValues[r])
+					h = (h + 1) % HashSize;
+				if (aSlots[h] < 0) {
+					if (nDictionary == MaxDictionary) {
+						nDictionary = -1;
+						break;
+					}
+					aSlots[h] = (short)nDictionary;
+					aDictionary[nDictionary++] = aValues[r];
+				}
+				aIndices[r] = aSlots[h];
+			}
+			if (nDictionary > 0)
+				page.append(aDictionary, nDictionary * sizeof(int));
+		}
+		if (nDictionary > 0) {
+			writePageHeader(col.chunk, PageDictionary, page.cbData, nDictionary, EncodingPlainDictionary);
+			col.chunk.append(page.pData, page.cbData);
+			col.cbDictionaryPage = col.chunk.cbData;
+			col.bDictionary = true;
+			page.clear();
+			const int nBits = bitWidth(nDictionary);
+			page.append((BYTE)nBits);
+			appendRleRuns(page, aIndices, nRows, nBits);
+			writePageHeader(col.chunk, PageData, page.cbData, nRows, EncodingRleDictionary);
+			col.chunk.append(page.pData, page.cbData);
+			return;
+		}
+	}
+	// x86 is little endian, which is what PLAIN wants
+	page.append(col.pValues, nRows * valueSize(col.type));
+	writePageHeader(col.chunk, PageData, page.cbData, nRows, EncodingPlain);
+	col.chunk.append(page.pData, page.cbData);
+}
+
+
+DWORD WINAPI ParquetWriter::encodeThread(LPVOID pParam)
+{
+	Encoder& enc = *(Encoder*)pParam;
+	ParquetWriter* pWriter = enc.pWriter;
+	for (;;) {
+		const LONG nColumn = InterlockedIncrement(&pWriter->nNextColumn) - 1;
+		if (nColumn >= pWriter->nColumns)
+			return 0;
+		pWriter->encodeColumn(pWriter->aColumns[nColumn], enc);
+	}
+}
+
+
+void ParquetWriter::encodeRowGroupMeta(ULONGLONG ullStart)
+{
+	// RowGroup structs are self-contained, so they can be serialized right
+	// away and only need the list header in front of them in the footer
+	ThriftWriter t(rowGroups);
+	t.beginStruct();
+	t.fieldList(1, ThriftWriter::Struct, nColumns);
+	ULONGLONG ullChunkOffset = ullStart;
+	ULONGLONG ullTotal = 0;
+	for (int i = 0; i < nColumns; ++i) {
+		const Column& col = aColumns[i];
+		const int nType = col.type == Int32? TypeInt32
+			: col.type == Enum? TypeByteArray
+			: col.type == Double? TypeDouble
+			: TypeInt64;
+		t.beginStruct();
+		t.fieldI64(2, ullChunkOffset);
+		t.fieldStruct(3);
+		t.fieldI32(1, nType);
+		if (col.bDictionary) {
+			t.fieldList(2, ThriftWriter::I32, 3);
+			t.i32(EncodingPlainDictionary);
+			t.i32(EncodingRleDictionary);
+			t.i32(EncodingRle);
+		}
+		else {
+			t.fieldList(2, ThriftWriter::I32, 2);
+			t.i32(EncodingPlain);
+			t.i32(EncodingRle);
+		}
+		t.fieldList(3, ThriftWriter::Binary, 1);
+		t.string(col.pszName);
+		t.fieldI32(4, 0);	// uncompressed
+		t.fieldI64(5, nRows);
+		t.fieldI64(6, col.chunk.cbData);
+		t.fieldI64(7, col.chunk.cbData);
+		t.fieldI64(9, ullChunkOffset + col.cbDictionaryPage);
+		if (col.bDictionary)
+			t.fieldI64(11, ullChunkOffset);
+		t.endStruct();
+		t.endStruct();
+		ullChunkOffset += col.chunk.cbData;
+		ullTotal += col.chunk.cbData;
+	}
+	t.fieldI64(2, ullTotal);
+	t.fieldI64(3, nRows);
+	t.endStruct();
+}
+
+
+bool ParquetWriter::writeRowGroup(UINT nRows)
+{
+	if (nRows == 0)
+		return true;
+	this->nRows = nRows;
+	// columns are independent, so each thread simply grabs the next one
+	nNextColumn = 0;
+	HANDLE ahThreads[MAXIMUM_WAIT_OBJECTS];
+	int nStarted = 0;
+	for (int i = 1; i < nThreads; ++i) {
+		ahThreads[nStarted] = CreateThread(NULL, 0, encodeThread, &aEncoders[i], 0, NULL);
+		if (ahThreads[nStarted] != NULL)
+			++nStarted;
+	}
+	encodeThread(&aEncoders[0]);
+	if (nStarted > 0)
+		WaitForMultipleObjects(nStarted, ahThreads, TRUE, INFINITE);
+	for (int i = 0; i < nStarted; ++i)
+		CloseHandle(ahThreads[i]);
+	const ULONGLONG ullStart = ullOffset;
+	for (int i = 0; i < nColumns; ++i)
+		if (!write(aColumns[i].chunk.pData, aColumns[i].chunk.cbData))
+			return false;
+	encodeRowGroupMeta(ullStart);
+	++nRowGroups;
+	ullRows += nRows;
+	return true;
+}
+
+
+bool ParquetWriter::close()
+{
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	ByteBuffer footer;
+	ThriftWriter t(footer);
+	t.beginStruct();
+	t.fieldI32(1, 1);
+	t.fieldList(2, ThriftWriter::Struct, nColumns + 1);
+	t.beginStruct();
+	t.fieldString(4, "schema");
+	t.fieldI32(5, nColumns);
+	t.endStruct();
+	for (int i = 0; i < nColumns; ++i) {
+		const Column& col = aColumns[i];
+		t.beginStruct();
+		t.fieldI32(1, col.type == Int32? TypeInt32
+			: col.type == Enum? TypeByteArray
+			: col.type == Double? TypeDouble
+			: TypeInt64);
+		t.fieldI32(3, RepetitionRequired);
+		t.fieldString(4, col.pszName);
+		if (col.type == Enum)
+			t.fieldI32(6, ConvertedUtf8);
+		else if (col.type == Timestamp)
+			t.fieldI32(6, ConvertedTimestampMicros);
+		t.endStruct();
+	}
+	t.fieldI64(3, ullRows);
+	t.fieldList(4, ThriftWriter::Struct, nRowGroups);
+	footer.append(rowGroups.pData, rowGroups.cbData);
+	t.fieldString(6, CreatedBy);
+	t.endStruct();
+	const DWORD cbFooter = (DWORD)footer.cbData;
+	const bool bOk = footer.pData != NULL
+		&& write(footer.pData, footer.cbData)
+		&& write(&cbFooter, sizeof(cbFooter))
+		&& write(Magic, 4);
+	CloseHandle(hFile);
+	hFile = INVALID_HANDLE_VALUE;
+	return bOk;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdlib.h>
+
+/// Growable byte buffer used while encoding pages and metadata.
+struct ByteBuffer {
+	BYTE* pData;
+	size_t cbData;
+	size_t cbAlloc;
+	ByteBuffer() : pData(NULL), cbData(0), cbAlloc(0) { /* ... */ }
+	~ByteBuffer() { free(pData); }
+	void clear() { cbData = 0; }
+	void append(const void* p, size_t cb);
+	void append(BYTE b) { append(&b, 1); }
+	void appendVarint(ULONGLONG ullValue);
+};
+
+
+/// Writer for flat Parquet files without nesting, nulls or compression.
+/// Columns are declared up front; the caller then fills one row group at
+/// a time into the column buffers and hands it to writeRowGroup(), which
+/// encodes the columns on several threads and appends them to the file.
+/// Only one row group is held in memory at any time. INT32 columns are
+/// dictionary encoded with RLE runs of dictionary indices while they have
+/// at most MaxDictionary distinct values per row group, which shrinks the
+/// mostly-zero key columns to a few bytes; enumerations are always stored
+/// as dictionary encoded strings.
+class ParquetWriter {
+public:
+	enum ColumnType {
+		Int32,
+		Int64,
+		Timestamp,	// INT64 microseconds since 1970-01-01 UTC
+		Double,
+		Enum		// INT32 index into a fixed table of strings
+	};
+	static const int MaxColumns = 512;
+	static const int MaxDictionary = 1024;
+
+	ParquetWriter();
+	~ParquetWriter();
+	int addColumn(const char* pszName, ColumnType type, const char* const* apszLabels = NULL, int nLabels = 0);
+	bool open(const TCHAR* pszFilename, UINT nRowGroupSize, int nThreads);
+	bool close();
+	UINT rowGroupSize() const { return nRowGroupSize; }
+	int* int32Column(int nColumn) { return (int*)aColumns[nColumn].pValues; }
+	LONGLONG* int64Column(int nColumn) { return (LONGLONG*)aColumns[nColumn].pValues; }
+	double* doubleColumn(int nColumn) { return (double*)aColumns[nColumn].pValues; }
+	bool writeRowGroup(UINT nRows);
+
+private:
+	struct Column {
+		const char* pszName;
+		ColumnType type;
+		const char* const* apszLabels;
+		int nLabels;
+		void* pValues;
+		// result of encoding the current row group
+		ByteBuffer chunk;
+		size_t cbDictionaryPage;
+		bool bDictionary;
+	};
+	// per-thread scratch, kept from one row group to the next so that
+	// encoding does not allocate once the first row group is through
+	struct Encoder {
+		ParquetWriter* pWriter;
+		int* aIndices;
+		ByteBuffer page;
+	};
+	Column aColumns[MaxColumns];
+	Encoder aEncoders[MAXIMUM_WAIT_OBJECTS];
+	int nColumns;
+	HANDLE hFile;
+	ULONGLONG ullOffset;
+	ULONGLONG ullRows;
+	UINT nRowGroupSize;
+	UINT nRows;
+	int nThreads;
+	volatile LONG nNextColumn;
+	int nRowGroups;
+	ByteBuffer rowGroups;
+	bool write(const void* p, size_t cb);
+	void encodeColumn(Column& col, Encoder& enc);
+	void encodeRowGroupMeta(ULONGLONG ullStart);
+	static DWORD WINAPI encodeThread(LPVOID pParam);
+	static size_t valueSize(ColumnType type);
+};
@@ -0,0 +1,740 @@
+/// actigen - writes synthetic actilog logs for any number of hosts.
+///
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+static const TCHAR* AppInfo = TEXT("actigen 1.0.4");
+static const DWORD WriteBufSize = 1024 * 1024;
+static const int DefaultHosts = 10;
+static const int DefaultDays = 7;
+static const UINT DefaultInterval = 60;
+static const ULONGLONG DefaultSeed = 1;
+static const TCHAR* DefaultStart = TEXT("2013-01-07");
+static const int SecsPerDay = 24 * 60 * 60;
+static const int ClockAnchorInterval = 3600;
+static const ULONGLONG Pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+enum _long_options {
+	SELECT_HELP = 0x1,
+	SELECT_HOSTS,
+	SELECT_DAYS,
+	SELECT_START,
+	SELECT_INTERVAL,
+	SELECT_SEED,
+	SELECT_THREADS,
+	SELECT_OUTPUT_DIR
+};
+
+static struct option long_options[] = {
+	{ "hosts",         required_argument, 0, SELECT_HOSTS },
+	{ "days",          required_argument, 0, SELECT_DAYS },
+	{ "start",         required_argument, 0, SELECT_START },
+	{ "interval",      required_argument, 0, SELECT_INTERVAL },
+	{ "seed",          required_argument, 0, SELECT_SEED },
+	{ "threads",       required_argument, 0, SELECT_THREADS },
+	{ "output-dir",    required_argument, 0, SELECT_OUTPUT_DIR },
+	{ "help",          no_argument, 0, SELECT_HELP },
+	{ NULL,            0, 0, 0 }
+};
+
+// relative frequencies of virtual key codes in office typing
+static const struct { BYTE vk; WORD wWeight; } KeyWeights[] = {
+	{ 'E', 127 }, { 'T', 91 }, { 'A', 82 }, { 'O', 75 }, { 'I', 70 }, { 'N', 67 },
+	{ 'S', 63 }, { 'H', 61 }, { 'R', 60 }, { 'D', 43 }, { 'L', 40 }, { 'C', 28 },
+	{ 'U', 28 }, { 'M', 24 }, { 'W', 24 }, { 'F', 22 }, { 'G', 20 }, { 'Y', 20 },
+	{ 'P', 19 }, { 'B', 15 }, { 'V', 10 }, { 'K', 8 }, { 'J', 2 }, { 'X', 2 },
+	{ 'Q', 1 }, { 'Z', 1 },
+	{ '0', 5 }, { '1', 6 }, { '2', 5 }, { '3', 4 }, { '4', 4 },
+	{ '5', 4 }, { '6', 3 }, { '7', 3 }, { '8', 3 }, { '9', 3 },
+	{ VK_SPACE, 180 }, { VK_BACK, 60 }, { VK_RETURN, 25 }, { VK_TAB, 6 },
+	{ VK_LSHIFT, 30 }, { VK_RSHIFT, 8 }, { VK_LCONTROL, 12 }, { VK_ESCAPE, 2 },
+	{ VK_LEFT, 8 }, { VK_UP, 6 }, { VK_RIGHT, 8 }, { VK_DOWN, 7 }, { VK_DELETE, 4 },
+	{ VK_OEM_PERIOD, 15 }, { VK_OEM_COMMA, 12 }, { VK_OEM_MINUS, 3 }
+};
+static const int NumKeys = sizeof(KeyWeights) / sizeof(KeyWeights[0]);
+
+static const TCHAR* pszOutputDir = TEXT(".");
+static int nHosts = DefaultHosts;
+static int nDays = DefaultDays;
+static UINT uInterval = DefaultInterval;
+static ULONGLONG ullSeed = DefaultSeed;
+static int nFirstDay = 0;
+static volatile LONG nNextHost = 0;
+
+// Walker's alias table over KeyWeights, so that drawing a key is O(1);
+// the probabilities are scaled to 32 bit to avoid floating point
+static DWORD adwKeyProb[NumKeys];
+static BYTE abKeyAlias[NumKeys];
+
+
+/// xorshift64* seeded through splitmix64; every host gets a stream of
+/// its own that only depends on the seed and the host number, so the
+/// output does not depend on the number of threads.
+struct Random {
+	ULONGLONG s;
+	Random(ULONGLONG ullSeed, ULONGLONG ullStream)
+	{
+		ULONGLONG z = ullSeed + 0x9e3779b97f4a7c15ULL * (ullStream + 1);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		s = (z ^ (z >> 31)) | 1;
+	}
+	ULONGLONG next()
+	{
+		s ^= s >> 12;
+		s ^= s << 25;
+		s ^= s >> 27;
+		return s * 0x2545f4914f6cdd1dULL;
+	}
+	double uniform() { return (double)(next() >> 11) * (1.0 / 9007199254740992.0); }
+	double normal()
+	{
+		const double u = uniform() + 1e-300;
+		return sqrt(-2 * log(u)) * cos(6.283185307179586 * uniform());
+	}
+	double lognormal(double fMu, double fSigma) { return exp(fMu + fSigma * normal()); }
+	int poisson(double fMean)
+	{
+		if (fMean <= 0)
+			return 0;
+		if (fMean > 30) {
+			const double f = fMean + sqrt(fMean) * normal() + 0.5;
+			return f > 0? (int)f : 0;
+		}
+		const double fLimit = exp(-fMean);
+		double p = uniform();
+		int n = 0;
+		while (p > fLimit) {
+			p *= uniform();
+			++n;
+		}
+		return n;
+	}
+	int key(DWORD r)
+	{
+		const ULONGLONG x = (ULONGLONG)r * NumKeys;
+		const int i = (int)(x >> 32);
+		return KeyWeights[(DWORD)x < adwKeyProb[i]? i : abKeyAlias[i]].vk;
+	}
+};
+
+
+/// The habits of one simulated user.
+struct Profile {
+	double fStartHour;
+	double fHours;
+	double fKeysPerMin;
+	double fPixelsPerMin;
+	double fDPI;
+	double fWeekend;
+	double fBreakRate;
+	bool bVerbose;
+};
+
+
+/// Buffered output of one host's log with hand-rolled formatting; the
+/// C runtime's printf would cost more than the whole simulation.
+struct Output {
+	HANDLE hFile;
+	char* pBuf;
+	DWORD cbBuf;
+	ULONGLONG ullLines;
+	ULONGLONG ullBytes;
+	bool bOk;
+	char szDate[12];
+	void flush()
+	{
+		DWORD dwWritten;
+		if (cbBuf > 0 && (!WriteFile(hFile, pBuf, cbBuf, &dwWritten, NULL) || dwWritten != cbBuf))
+			bOk = false;
+		ullBytes += cbBuf;
+		cbBuf = 0;
+	}
+	void str(const char* psz)
+	{
+		while (*psz)
+			pBuf[cbBuf++] = *psz++;
+	}
+	void uint(ULONGLONG v)
+	{
+		if (v < 10) {
+			pBuf[cbBuf++] = (char)('0' + v);
+			return;
+		}
+		char sz[24];
+		int n = 0;
+		do {
+			sz[n++] = (char)('0' + v % 10);
+			v /= 10;
+		} while (v);
+		while (n)
+			pBuf[cbBuf++] = sz[--n];
+	}
+	void fixed(double f, int nDecimals)
+	{
+		const ULONGLONG v = (ULONGLONG)(f * Pow10[nDecimals] + 0.5);
+		uint(v / Pow10[nDecimals]);
+		pBuf[cbBuf++] = '.';
+		ULONGLONG ullFraction = v % Pow10[nDecimals];
+		for (int i = nDecimals - 1; i >= 0; --i) {
+			pBuf[cbBuf + i] = (char)('0' + ullFraction % 10);
+			ullFraction /= 10;
+		}
+		cbBuf += nDecimals;
+	}
+	void time(int nSecs)
+	{
+		// "hh:mm:ss"
+		const int h = nSecs / 3600, m = nSecs / 60 % 60, s = nSecs % 60;
+		char* p = pBuf + cbBuf;
+		p[0] = (char)('0' + h / 10);
+		p[1] = (char)('0' + h % 10);
+		p[2] = ':';
+		p[3] = (char)('0' + m / 10);
+		p[4] = (char)('0' + m % 10);
+		p[5] = ':';
+		p[6] = (char)('0' + s / 10);
+		p[7] = (char)('0' + s % 10);
+		cbBuf += 8;
+	}
+	void stamp(int nSecs)
+	{
+		// "YYYY-MM-DD hh:mm:ss "; a line is never longer than 2 KB
+		if (cbBuf > WriteBufSize - 2048)
+			flush();
+		memcpy(pBuf + cbBuf, szDate, 11);
+		cbBuf += 11;
+		time(nSecs);
+		pBuf[cbBuf++] = ' ';
+	}
+	void endLine()
+	{
+		pBuf[cbBuf++] = '\r';
+		pBuf[cbBuf++] = '\n';
+		++ullLines;
+	}
+};
+
+
+/// Counters of one simulated interval.
+struct Activity {
+	double fPixels;
+	int nWheel;
+	int nClicks;
+	int nDoubleClicks;
+	int nKeys;
+	int aHisto[256];
+};
+
+
+void buildKeyTable()
+{
+	double fTotal = 0;
+	for (int i = 0; i < NumKeys; ++i)
+		fTotal += KeyWeights[i].wWeight;
+	double afScaled[NumKeys];
+	int anSmall[NumKeys], anLarge[NumKeys];
+	int nSmall = 0, nLarge = 0;
+	for (int i = 0; i < NumKeys; ++i) {
+		afScaled[i] = KeyWeights[i].wWeight * NumKeys / fTotal;
+		abKeyAlias[i] = (BYTE)i;
+		if (afScaled[i] < 1)
+			anSmall[nSmall++] = i;
+		else
+			anLarge[nLarge++] = i;
+	}
+	while (nSmall > 0 && nLarge > 0) {
+		const int s = anSmall[--nSmall];
+		const int l = anLarge[nLarge - 1];
+		adwKeyProb[s] = (DWORD)(afScaled[s] * 4294967296.0);
+		abKeyAlias[s] = (BYTE)l;
+		afScaled[l] -= 1 - afScaled[s];
+		if (afScaled[l] < 1) {
+			--nLarge;
+			anSmall[nSmall++] = l;
+		}
+	}
+	while (nSmall > 0)
+		adwKeyProb[anSmall[--nSmall]] = 0xffffffff;
+	while (nLarge > 0)
+		adwKeyProb[anLarge[--nLarge]] = 0xffffffff;
+}
+
+
+bool parseDate(const TCHAR* psz, int* pnDays)
+{
+	// days since 1970-01-01 of "YYYY-MM-DD" (proleptic Gregorian)
+	int y, m, d;
+	if (_stscanf(psz, TEXT("%d-%d-%d"), &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 || d > 31)
+		return false;
+	y -= m <= 2;
+	const int nEra = (y >= 0? y : y - 399) / 400;
+	const int nYoe = y - nEra * 400;
+	const int nDoy = (153 * (m + (m > 2? -3 : 9)) + 2) / 5 + d - 1;
+	const int nDoe = nYoe * 365 + nYoe / 4 - nYoe / 100 + nDoy;
+	*pnDays = nEra * 146097 + nDoe - 719468;
+	return true;
+}
+
+
+void formatDate(int nDays, char* pszDest)
+{
+	// inverse of parseDate(), as "YYYY-MM-DD "
+	const int z = nDays + 719468;
+	const int nEra = (z >= 0? z : z - 146096) / 146097;
+	const int nDoe = z - nEra * 146097;
+	const int nYoe = (nDoe - nDoe / 1460 + nDoe / 36524 - nDoe / 146096) / 365;
+	const int nDoy = nDoe - (365 * nYoe + nYoe / 4 - nYoe / 100);
+	const int mp = (5 * nDoy + 2) / 153;
+	const int d = nDoy - (153 * mp + 2) / 5 + 1;
+	const int m = mp < 10? mp + 3 : mp - 9;
+	const int y = nYoe + nEra * 400 + (m <= 2);
+	_snprintf(pszDest, 12, "%04d-%02d-%02d ", y, m, d);
+}
+
+
+double clamp(double f, double fMin, double fMax)
+{
+	return f < fMin? fMin : f > fMax? fMax : f;
+}
+
+
+void makeProfile(Random& rng, Profile& p)
+{
+	static const double DPIs[] = { 96, 96, 96, 120, 144 };
+	p.fStartHour = clamp(8.25 + 0.75 * rng.normal(), 5, 12);
+	p.fHours = clamp(8.5 + 0.75 * rng.normal(), 4, 12);
+	p.fKeysPerMin = rng.lognormal(log(110.0), 0.4);
+	p.fPixelsPerMin = rng.lognormal(log(5000.0), 0.5);
+	p.fDPI = DPIs[rng.next() % 5];
+	p.fWeekend = 0.15 * rng.uniform();
+	p.fBreakRate = 1 / 3000.0 * 2 * rng.uniform();
+	p.bVerbose = rng.uniform() < 0.3;
+}
+
+
+double activeProbability(const Profile& p, double fHour)
+{
+	// diurnal curve: slow start, lunch dip, trailing off in the evening
+	const double fIn = fHour - p.fStartHour;
+	if (fIn < 0.5)
+		return 0.6;
+	if (fIn > 3.75 && fIn < 4.5)
+		return 0.25;
+	if (fIn > p.fHours - 0.5)
+		return 0.5;
+	return 0.85;
+}
+
+
+void simulate(Random& rng, const Profile& p, double fSecs, double fIntensity, Activity& a)
+{
+	const double fScale = fSecs / 60 * fIntensity;
+	a.nKeys = rng.poisson(p.fKeysPerMin * fScale);
+	ZeroMemory(a.aHisto, sizeof(a.aHisto));
+	for (int i = 0; i < a.nKeys; i += 2) {
+		const ULONGLONG r = rng.next();
+		++a.aHisto[rng.key((DWORD)r)];
+		if (i + 1 < a.nKeys)
+			++a.aHisto[rng.key((DWORD)(r >> 32))];
+	}
+	a.fPixels = p.fPixelsPerMin * fScale * rng.lognormal(0, 0.3);
+	a.nClicks = rng.poisson(a.fPixels / 500);
+	a.nDoubleClicks = rng.poisson(a.nClicks * 0.08);
+	a.nWheel = rng.poisson(a.fPixels / 800);
+}
+
+
+void writeCounters(Output& out, const Profile& p, int nSecs, const Activity& a)
+{
+	// same lines and order as actilog's logCounters()
+	if (a.fPixels > 0) {
+		out.stamp(nSecs);
+		out.str("MOVE ");
+		out.fixed(a.fPixels, 6);
+		out.str(" px (");
+		out.fixed(a.fPixels / p.fDPI * 2.54 / 100, 6);
+		out.str(" m)");
+		out.endLine();
+	}
+	if (a.nWheel > 0) {
+		out.stamp(nSecs);
+		out.str("WHEEL ");
+		out.uint(a.nWheel);
+		out.endLine();
+	}
+	if (a.nClicks > 0) {
+		out.stamp(nSecs);
+		out.str("CLICK ");
+		out.uint(a.nClicks);
+		out.endLine();
+	}
+	if (a.nDoubleClicks > 0) {
+		out.stamp(nSecs);
+		out.str("DBLCLICK ");
+		out.uint(a.nDoubleClicks);
+		out.endLine();
+	}
+	if (a.nKeys > 0) {
+		out.stamp(nSecs);
+		out.str("KEYSTAT ");
+		// most of the 256 counts are zero or single digits
+		char* p = out.pBuf + out.cbBuf;
+		for (int i = 0; i < 256; ++i) {
+			const int n = a.aHisto[i];
+			if (n < 10) {
+				*p++ = (char)('0' + n);
+			}
+			else {
+				out.cbBuf = (DWORD)(p - out.pBuf);
+				out.uint(n);
+				p = out.pBuf + out.cbBuf;
+			}
+			*p++ = ',';
+		}
+		out.cbBuf = (DWORD)(p - out.pBuf) - 1;
+		out.endLine();
+	}
+}
+
+
+/// One run of actilog, from its start to a break or the end of the day;
+/// the monotonic clock counts from the boot of the machine.
+struct Run {
+	int nStart;
+	ULONGLONG ullBootNs;
+	int nNextAnchor;
+	ULONGLONG monotonic(int nSecs) const { return ullBootNs + (ULONGLONG)(nSecs - nStart) * 1000000000ULL; }
+};
+
+
+void writeClock(Output& out, Random& rng, Run& run, int nSecs)
+{
+	// logClockAnchor(): at start and then hourly; local time is UTC here
+	const ULONGLONG ullJitterNs = rng.next() % 1000000;
+	out.stamp(nSecs);
+	out.str("CLOCK ");
+	out.uint(run.monotonic(nSecs) + ullJitterNs);
+	out.str(" ns = ");
+	memcpy(out.pBuf + out.cbBuf, out.szDate, 10);
+	out.cbBuf += 10;
+	out.pBuf[out.cbBuf++] = 'T';
+	out.time(nSecs);
+	out.pBuf[out.cbBuf++] = '.';
+	const ULONGLONG ullFraction = ullJitterNs / 100;
+	for (int i = 6; i >= 0; --i)
+		out.pBuf[out.cbBuf + 6 - i] = (char)('0' + ullFraction / Pow10[i] % 10);
+	out.cbBuf += 7;
+	out.pBuf[out.cbBuf++] = 'Z';
+	out.endLine();
+	run.nNextAnchor = nSecs + ClockAnchorInterval;
+}
+
+
+void writeInterval(Output& out, Random& rng, const Profile& p, const Run& run, int nFrom, int nSecs, const Activity& a)
+{
+	// logInterval(): nothing at all for an interval without input
+	if (a.nKeys == 0 && a.fPixels == 0)
+		return;
+	const ULONGLONG ullStartNs = run.monotonic(nFrom);
+	const ULONGLONG ullEndNs = run.monotonic(nSecs);
+	const ULONGLONG ullSpan = ullEndNs - ullStartNs;
+	const ULONGLONG ullFirst = ullStartNs + (ULONGLONG)(rng.uniform() * 0.3 * ullSpan);
+	const ULONGLONG ullLast = ullEndNs - (ULONGLONG)(rng.uniform() * 0.3 * ullSpan);
+	out.stamp(nSecs);
+	out.str("INTERVAL ");
+	out.uint(ullStartNs);
+	out.pBuf[out.cbBuf++] = ' ';
+	out.uint(ullEndNs);
+	out.str(" ns, events ");
+	out.uint(ullFirst);
+	out.pBuf[out.cbBuf++] = ' ';
+	out.uint(ullLast);
+	out.str(" ns");
+	out.endLine();
+	writeCounters(out, p, nSecs, a);
+}
+
+
+void writeStop(Output& out, Random& rng, const Profile& p, const Run& run, const char* pszReason, int nFrom, int nSecs)
+{
+	// the reason, then finalFlush()'s partial interval, then STOP
+	out.stamp(nSecs);
+	out.str(pszReason);
+	out.endLine();
+	out.stamp(nSecs);
+	out.str("PARTIAL ");
+	out.fixed(nSecs - nFrom, 3);
+	out.str(" secs");
+	out.endLine();
+	Activity a;
+	simulate(rng, p, nSecs - nFrom, rng.lognormal(0, 0.5), a);
+	writeInterval(out, rng, p, run, nFrom, nSecs, a);
+	if (p.bVerbose) {
+		out.stamp(nSecs);
+		out.str("STOP");
+		out.endLine();
+	}
+}
+
+
+void writeHost(int nHost, Output& out)
+{
+	Random rng(ullSeed, nHost);
+	Profile p;
+	makeProfile(rng, p);
+	Activity a;
+	const int nInterval = (int)uInterval;
+	for (int nDay = nFirstDay; nDay < nFirstDay + nDays && out.bOk; ++nDay) {
+		// 1970-01-01 was a Thursday
+		const int nWeekday = (nDay + 4) % 7;
+		if ((nWeekday == 0 || nWeekday == 6) && rng.uniform() >= p.fWeekend)
+			continue;
+		formatDate(nDay, out.szDate);
+		int nStart = (int)(3600 * (p.fStartHour + 0.33 * rng.normal()));
+		const int nEnd = (int)(nStart + 3600 * (p.fHours + 0.5 * rng.normal()));
+		if (nStart < 0)
+			nStart = 0;
+		while (nStart < nEnd && nEnd < SecsPerDay) {
+			// one run of actilog: START and STOP only appear with -v
+			Run run;
+			run.nStart = nStart;
+			run.ullBootNs = (ULONGLONG)(60 + 600 * rng.uniform()) * 1000000000ULL;
+			if (p.bVerbose) {
+				out.stamp(nStart);
+				out.str("START interval = ");
+				out.uint(nInterval);
+				out.str(" secs, dpi = ");
+				out.fixed(p.fDPI, 6);
+				out.endLine();
+			}
+			writeClock(out, rng, run, nStart);
+			int nFrom = nStart;
+			int t = (nStart / nInterval + 1) * nInterval;
+			for (; t <= nEnd; t += nInterval) {
+				if (rng.uniform() < p.fBreakRate) {
+					const int nStop = t - nInterval + (int)(rng.uniform() * nInterval);
+					writeStop(out, rng, p, run, "BREAK", nFrom, nStop);
+					nStart = nStop + 300 + (int)(1500 * rng.uniform());
+					break;
+				}
+				if (rng.uniform() < activeProbability(p, t / 3600.0)) {
+					simulate(rng, p, t - nFrom, rng.lognormal(0, 0.5), a);
+					writeInterval(out, rng, p, run, nFrom, t, a);
+				}
+				if (t >= run.nNextAnchor)
+					writeClock(out, rng, run, t);
+				nFrom = t;
+			}
+			if (t > nEnd) {
+				writeStop(out, rng, p, run, rng.uniform() < 0.7? "LOGOFF" : "SHUTDOWN", nFrom, nEnd);
+				break;
+			}
+		}
+	}
+}
+
+
+DWORD WINAPI hostThread(LPVOID pParam)
+{
+	// hosts are independent, so each thread simply grabs the next one
+	Output& total = *(Output*)pParam;
+	Output out = total;
+	for (;;) {
+		const LONG nHost = InterlockedIncrement(&nNextHost) - 1;
+		if (nHost >= nHosts || !out.bOk)
+			break;
+		TCHAR szFile[MAX_PATH];
+		_sntprintf(szFile, MAX_PATH, TEXT("%s\\host%04d.log"), pszOutputDir, nHost);
+		out.hFile = CreateFile(szFile, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (out.hFile == INVALID_HANDLE_VALUE) {
+			fprintf(stderr, "Fatal error: cannot create file '%s'\n", szFile);
+			out.bOk = false;
+			break;
+		}
+		writeHost(nHost, out);
+		out.flush();
+		CloseHandle(out.hFile);
+	}
+	total = out;
+	return 0;
+}
+
+
+void usage()
+{
+	printf("%s - writes synthetic logs in the format of actilog for\n"
+		"sizing and benchmarking the tools that process them.\n"
+		"\n"
+		"Usage: actigen [options]\n"
+		"\n"
+		"  -n hosts\n"
+		"  --hosts hosts\n"
+		"     number of simulated hosts (default: %d)\n"
+		"  -d days\n"
+		"  --days days\n"
+		"     number of simulated days (default: %d)\n"
+		"  --start YYYY-MM-DD\n"
+		"     first simulated day (default: %s)\n"
+		"  -i interval\n"
+		"  --interval interval\n"
+		"     logging interval in seconds (default: %u)\n"
+		"  --seed n\n"
+		"     seed of the random generator (default: %I64u)\n"
+		"  --threads n\n"
+		"     simulate hosts on n threads (default: number of processors)\n"
+		"  -o dir\n"
+		"  --output-dir dir\n"
+		"     write 'host<NNNN>.log' files to 'dir', replacing existing\n"
+		"     ones (default: current directory)\n"
+		"  -h\n"
+		"  -?\n"
+		"  --help\n"
+		"     show this help\n"
+		"\n"
+		"Every host gets a user with habits of their own: when the working\n"
+		"day starts and how long it lasts, how fast they type and how much\n"
+		"they move the mouse. Activity follows a daily curve with a lunch\n"
+		"break, keys are drawn from typical office typing, and actilog is\n"
+		"started and stopped (LOGOFF, SHUTDOWN, BREAK) like on a real\n"
+		"desk. The same seed always gives the same logs, independent of\n"
+		"the number of threads.\n"
+		"\n",
+		AppInfo,
+		DefaultHosts,
+		DefaultDays,
+		DefaultStart,
+		DefaultInterval,
+		DefaultSeed);
+}
+
+
+int main(int argc, TCHAR* argv[])
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	int nThreads = (int)si.dwNumberOfProcessors;
+	const TCHAR* pszStart = DefaultStart;
+	for (;;) {
+		int option_index = 0;
+		int c = getopt_long(argc, argv, "h?n:d:i:o:", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+		case 'n':
+			// fall-through
+		case SELECT_HOSTS:
+			nHosts = atoi(optarg);
+			break;
+		case 'd':
+			// fall-through
+		case SELECT_DAYS:
+			nDays = atoi(optarg);
+			break;
+		case SELECT_START:
+			pszStart = optarg;
+			break;
+		case 'i':
+			// fall-through
+		case SELECT_INTERVAL:
+			uInterval = atoi(optarg);
+			if (uInterval == 0) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+		case SELECT_SEED:
+			ullSeed = _strtoui64(optarg, NULL, 10);
+			break;
+		case SELECT_THREADS:
+			nThreads = atoi(optarg);
+			break;
+		case 'o':
+			// fall-through
+		case SELECT_OUTPUT_DIR:
+			pszOutputDir = optarg;
+			break;
+		case '?':
+			// fall-through
+		case 'h':
+			// fall-through
+		case SELECT_HELP:
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (nHosts <= 0 || nDays <= 0 || !parseDate(pszStart, &nFirstDay)) {
+		usage();
+		return EXIT_FAILURE;
+	}
+	if (nThreads <= 0)
+		nThreads = 1;
+	if (nThreads > nHosts)
+		nThreads = nHosts;
+	if (nThreads > MAXIMUM_WAIT_OBJECTS)
+		nThreads = MAXIMUM_WAIT_OBJECTS;
+	buildKeyTable();
+	CreateDirectory(pszOutputDir, NULL);
+	const DWORD dwStart = GetTickCount();
+	Output aOutputs[MAXIMUM_WAIT_OBJECTS];
+	HANDLE ahThreads[MAXIMUM_WAIT_OBJECTS];
+	int nStarted = 0;
+	for (int i = 0; i < nThreads; ++i) {
+		Output& out = aOutputs[nStarted];
+		out.pBuf = (char*)malloc(WriteBufSize);
+		out.cbBuf = 0;
+		out.ullLines = 0;
+		out.ullBytes = 0;
+		out.bOk = out.pBuf != NULL;
+		ahThreads[nStarted] = CreateThread(NULL, 0, hostThread, &out, 0, NULL);
+		if (ahThreads[nStarted] != NULL)
+			++nStarted;
+		else
+			free(out.pBuf);
+	}
+	if (nStarted > 0)
+		WaitForMultipleObjects(nStarted, ahThreads, TRUE, INFINITE);
+	const DWORD dwElapsed = GetTickCount() - dwStart;
+	ULONGLONG ullLines = 0, ullBytes = 0;
+	bool bOk = nStarted > 0;
+	for (int i = 0; i < nStarted; ++i) {
+		CloseHandle(ahThreads[i]);
+		ullLines += aOutputs[i].ullLines;
+		ullBytes += aOutputs[i].ullBytes;
+		bOk = bOk && aOutputs[i].bOk;
+		free(aOutputs[i].pBuf);
+	}
+	if (!bOk) {
+		fprintf(stderr, "Fatal error: generating the logs failed\n");
+		return EXIT_FAILURE;
+	}
+	printf("%I64u lines (%I64u MB) for %d hosts written to '%s' in %.1lf secs (%.0lf MB/s)\n",
+		ullLines, ullBytes >> 20, nHosts, pszOutputDir, dwElapsed / 1000.0,
+		dwElapsed > 0? ullBytes / 1048576.0 / (dwElapsed / 1000.0) : 0.0);
+	return EXIT_SUCCESS;
+}
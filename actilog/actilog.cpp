@@ -17,23 +17,72 @@
 ///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ///
 
+#define _CRT_RAND_S
 #include <windows.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 #include <getopt.h>
 #include "log.h"
+#include "gzipreader.h"
+#include "journal.h"
+#include "clock.h"
+#include "rrd.h"
 #include "util.h"
+#include "counters.h"
+#include "timerwheel.h"
+#include "metrics.h"
+#include "format.h"
+#include "selfstat.h"
+#include "events.h"
+#include "rawinput.h"
+#include "distance.h"
+#include "seats.h"
+#include "warp.h"
+#include "activity.h"
+#include "anomaly.h"
+#include "config.h"
 
 static const TCHAR* AppInfo = TEXT("actilog 1.0.4");
 static const UINT DefaultTimerInterval = 600;
 static const double DefaultDPI = 92.0;
+static const UINT JournalCheckpointInterval = 5;
+static const DWORD ShutdownTimeout = 2000;
+static const UINT ClockAnchorInterval = 3600;
+static const LONGLONG ClockJumpThreshold = 10000000; // 1 sec in 100 ns units
+static const TCHAR* JournalExtension = TEXT(".journal");
+static const TCHAR* DefaultRrdTiers = TEXT("600x1008,3600x8760,86400x36525");
+static const int MaxRrdTiers = 8;
+static const UINT DefaultIndexEvery = 64;
+static const size_t MaxMetricsSize = 32 * 1024;
 
 enum _long_options {
 	SELECT_HELP = 0x1,
 	SELECT_INTERVAL,
 	SELECT_OUTPUT_FILE,
 	SELECT_OVERWRITE,
-	SELECT_DPI
+	SELECT_DPI,
+	SELECT_JOURNAL,
+	SELECT_WINDOW,
+	SELECT_RRD,
+	SELECT_RRD_TIERS,
+	SELECT_INDEX,
+	SELECT_REBUILD_INDEX,
+	SELECT_METRICS_PORT,
+	SELECT_FORMAT,
+	SELECT_SELFSTAT,
+	SELECT_KEY_CLASSES,
+	SELECT_KEY_NOISE,
+	SELECT_SEAT,
+	SELECT_LIST_DEVICES,
+	SELECT_CONFIG,
+	SELECT_RAW_DISTANCE,
+	SELECT_DEVICE_DPI,
+	SELECT_WARP_SPEED,
+	SELECT_WARP_MONITORS,
+	SELECT_IDLE,
+	SELECT_ANOMALY,
+	SELECT_GZIP
 };
 
 static struct option long_options[] = {
@@ -42,72 +91,149 @@ static struct option long_options[] = {
 	{ "help",          no_argument, 0, SELECT_HELP },
 	{ "overwrite",     no_argument, 0, SELECT_OVERWRITE },
 	{ "dpi",           required_argument, 0, SELECT_DPI },
+	{ "journal",       required_argument, 0, SELECT_JOURNAL },
+	{ "window",        required_argument, 0, SELECT_WINDOW },
+	{ "rrd",           required_argument, 0, SELECT_RRD },
+	{ "rrd-tiers",     required_argument, 0, SELECT_RRD_TIERS },
+	{ "index",         required_argument, 0, SELECT_INDEX },
+	{ "rebuild-index", required_argument, 0, SELECT_REBUILD_INDEX },
+	{ "metrics-port",  required_argument, 0, SELECT_METRICS_PORT },
+	{ "format",        required_argument, 0, SELECT_FORMAT },
+	{ "selfstat",      no_argument, 0, SELECT_SELFSTAT },
+	{ "key-classes",   no_argument, 0, SELECT_KEY_CLASSES },
+	{ "key-noise",     required_argument, 0, SELECT_KEY_NOISE },
+	{ "seat",          required_argument, 0, SELECT_SEAT },
+	{ "list-devices",  no_argument, 0, SELECT_LIST_DEVICES },
+	{ "config",        required_argument, 0, SELECT_CONFIG },
+	{ "raw-distance",  no_argument, 0, SELECT_RAW_DISTANCE },
+	{ "device-dpi",    required_argument, 0, SELECT_DEVICE_DPI },
+	{ "warp-speed",    required_argument, 0, SELECT_WARP_SPEED },
+	{ "warp-monitors", no_argument, 0, SELECT_WARP_MONITORS },
+	{ "idle",          required_argument, 0, SELECT_IDLE },
+	{ "anomaly",       required_argument, 0, SELECT_ANOMALY },
+	{ "gzip",          no_argument, 0, SELECT_GZIP },
 	{ NULL,            0, 0, 0 }
 };
 
 
 Logger logger;
-POINT ptLastMousePos = { LONG_MAX, LONG_MAX };
-double fMouseDist = 0;
+Window windows[TimerWheel::MaxLevels];
+int nWindows = 1;
+RawInput rawInput;
+DeviceDistance distances;
+bool bRawDistance = false;
+SeatTable seats;
+TimerWheel wheel;
+Counters aJournal[TimerWheel::MaxLevels];
+RoundRobinArchive archives[MaxRrdTiers];
+int nArchives = 0;
+const TCHAR* pszRrdPrefix = NULL;
+const TCHAR* pszRrdTiers = DefaultRrdTiers;
+UINT nIndexEvery = 0;
+Journal journal;
+ConfigFile config;
+TCHAR szOutputFile[MAX_PATH] = { 0 };
+MetricsServer metrics;
+USHORT uMetricsPort = 0;
+Counters totals;
+char szMetrics[MaxMetricsSize];
+TCHAR szJournalFile[MAX_PATH] = { 0 };
+WarpFilter warp;
+Counters counters;
+Counters lastCheckpoint;
+Counters completed;
+SelfMonitor monitor;
+SelfStats completedSelf;
+bool bSelfStat = false;
+ActivityTracker activity;
+ActivityTimeline completedActivity;
+bool bActivity = false;
+AnomalyDetector detector;
+UINT anAnomalies[NumAnomalyKinds] = { 0 };
+bool bAnomalies = false;
+bool bKeyClasses = false;
+double fKeyNoise = 0;
+bool bCompletedPending = false;
+ULONGLONG ullIntervalStartNs = 0;
+ULONGLONG ullIntervalEndNs = 0;
+ULONGLONG ullCompletedStartNs = 0;
+ULONGLONG ullCompletedEndNs = 0;
+ULONGLONG ullNextAnchorNs = 0;
+UINT uTimerInterval = DefaultTimerInterval;
+UINT_PTR uIDTimer = 0;
 double fDPI = DefaultDPI;
-int nClicks = 0;
-int nDoubleClicks = 0;
-int nWheel = 0;
+OutputFormat outputFormat = FormatText;
 bool bVerbose = false;
 bool bOverwrite = false;
-int aHisto[256];
-int aLastHisto[256];
+bool bGzip = false;
+HANDLE hShutdownEvent = NULL;
+HANDLE hShutdownDoneEvent = NULL;
+const TCHAR* volatile pszShutdownReason = NULL;
 
 
-inline bool hasHistoChanged()
+void closeInterval(ULONGLONG ullNow);
+
+
+inline ULONGLONG stampEvent()
 {
-	for (int i = 0; i < 256; ++i)
-		if (aHisto[i] != aLastHisto[i] && aHisto[i] != 0)
-			return true;
-	return false;
+	const ULONGLONG ullNow = Clock::now();
+	if (ullNow >= ullIntervalEndNs)
+		closeInterval(ullNow);
+	if (bActivity)
+		activity.event(ullNow);
+	if (counters.ullFirstEventNs == 0)
+		counters.ullFirstEventNs = ullNow;
+	counters.ullLastEventNs = ullNow;
+	return ullNow;
+}
+
+
+inline ULONGLONG stampKeyEvent()
+{
+	// with --key-noise a key press leaves no trace but in the noised
+	// class counts: it marks neither the event times nor activity
+	if (fKeyNoise <= 0)
+		return stampEvent();
+	const ULONGLONG ullNow = Clock::now();
+	if (ullNow >= ullIntervalEndNs)
+		closeInterval(ullNow);
+	return ullNow;
 }
 
 
+// counter each CounterSlot increments; the hooks only run on the main
+// thread, so plain pointers into the running counters are fine. Moves
+// land in nUncounted, which is cleared right after each increment so
+// that it cannot overflow over weeks of mouse movement.
+int nUncounted = 0;
+int* const apSlots[NumCounterSlots] = { &nUncounted, &counters.nClicks, &counters.nDoubleClicks, &counters.nWheel, &nUncounted };
+
+
 LRESULT CALLBACK LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam)
 {
 	MSLLHOOKSTRUCT* pMouse = (MSLLHOOKSTRUCT*)lParam;
-	switch (wParam)
-	{
-	case WM_MOUSEMOVE:
-		if (ptLastMousePos.x < LONG_MAX && ptLastMousePos.y < LONG_MAX)
-			fMouseDist += sqrt((double)squared(ptLastMousePos.x - pMouse->pt.x) + (double)squared(ptLastMousePos.y - pMouse->pt.y));
-		ptLastMousePos = pMouse->pt;
-		break;
-#if (_WIN32_WINNT >= 0x0600)
-	case WM_MOUSEHWHEEL:
-		// fall-through
-#endif
-	case WM_MOUSEWHEEL:
-		++nWheel;
-		break;
-#if (_WIN32_WINNT >= 0x0500)
-	case WM_XBUTTONDBLCLK:
-		// fall-through
-#endif
-	case WM_LBUTTONDBLCLK:
-		// fall-through
-	case WM_MBUTTONDBLCLK:
-		// fall-through
-	case WM_RBUTTONDBLCLK:
-		++nDoubleClicks;
-		break;
-#if (_WIN32_WINNT >= 0x0500)
-	case WM_XBUTTONUP:
-		// fall-through
-#endif
-	case WM_LBUTTONUP:
-		// fall-through
-	case WM_MBUTTONUP:
-		// fall-through
-	case WM_RBUTTONUP:
-		++nClicks;
-		break;
+	const ULONGLONG ullStartNs = stampEvent();
+	const EventClass& ec = EventTable::mouse(wParam);
+	++*apSlots[ec.slot];
+	nUncounted = 0;
+	if (ec.kind == EventMove) {
+		double fDist;
+		if (warp.move(pMouse->pt, pMouse->time, &fDist)) {
+			++counters.nWarps;
+			counters.fWarpDist += fDist;
+		}
+		else {
+			counters.fMouseDist += fDist;
+		}
+	}
+	else if (ec.kind == EventButtonDown) {
+		monitor.press(EventTable::mouseButton(ec, pMouse->mouseData));
 	}
+	else if (ec.kind == EventButtonUp) {
+		monitor.release(EventTable::mouseButton(ec, pMouse->mouseData));
+	}
+	monitor.event((EventKind)ec.kind, pMouse->time);
+	monitor.mouseDone(ullStartNs, Clock::now());
 	return 0;
 }
 
@@ -115,80 +241,808 @@ LRESULT CALLBACK LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam)
 LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
 {
 	KBDLLHOOKSTRUCT* pKeyBoard = (KBDLLHOOKSTRUCT*)lParam;
-	switch (wParam)
-	{
-	case WM_KEYUP:
-		{
-			const DWORD dwKeyCode = pKeyBoard->vkCode;
-			if (dwKeyCode >= 0 && dwKeyCode < 256)
-				++aHisto[dwKeyCode];
-			break;
-		}
-	default:
-		return CallNextHookEx(NULL, nCode, wParam, lParam);
+	const ULONGLONG ullStartNs = stampKeyEvent();
+	const EventClass& ec = EventTable::keyboard(wParam);
+	const DWORD dwKeyCode = pKeyBoard->vkCode & 0xff;
+	if (ec.kind == EventKeyDown)
+		monitor.press(dwKeyCode);
+	else if (ec.kind == EventKeyUp)
+		monitor.release(dwKeyCode);
+	monitor.event((EventKind)ec.kind, pKeyBoard->time);
+	if (ec.slot == SlotKeys) {
+		if (bKeyClasses)
+			++counters.aKeyClasses[KeyClassTable::classOf(dwKeyCode)];
+		else
+			++counters.aHisto[dwKeyCode];
+		monitor.keyboardDone(ullStartNs, Clock::now());
+		return 0;
 	}
-	return 0;
+	monitor.keyboardDone(ullStartNs, Clock::now());
+	return CallNextHookEx(NULL, nCode, wParam, lParam);
 }
 
 
 BOOL WINAPI CtlHandlerRoutine(DWORD dwCtrlType)
 {
-	printf("CtlHandlerRoutine(%u)\n", dwCtrlType);
+	// runs on a thread of its own: only tell the message loop to shut down
+	const TCHAR* pszReason;
 	switch (dwCtrlType) {
 	case CTRL_C_EVENT:
 		// fall-through
 	case CTRL_BREAK_EVENT:
-		logger.logWithTimestamp("BREAK");
-		PostMessage(NULL, WM_ENDSESSION, NULL, NULL);
-		ExitProcess(0);
-		return TRUE;
+		pszReason = "BREAK";
+		break;
 	case CTRL_CLOSE_EVENT:
-		logger.logWithTimestamp("CLOSED");
-		return FALSE;
+		pszReason = "CLOSED";
+		break;
 	case CTRL_LOGOFF_EVENT:
-		logger.logWithTimestamp("LOGOFF");
-		return FALSE;
+		pszReason = "LOGOFF";
+		break;
 	case CTRL_SHUTDOWN_EVENT:
-		logger.logWithTimestamp("SHUTDOWN");
-		return FALSE;
-	default:
+		pszReason = "SHUTDOWN";
 		break;
+	default:
+		return FALSE;
+	}
+	InterlockedCompareExchangePointer((void* volatile*)&pszShutdownReason, (void*)pszReason, NULL);
+	SetEvent(hShutdownEvent);
+	// the process is terminated as soon as this handler returns from
+	// anything but Ctrl-C/Ctrl-Break, so wait for the final flush
+	if (dwCtrlType != CTRL_C_EVENT && dwCtrlType != CTRL_BREAK_EVENT)
+		WaitForSingleObject(hShutdownDoneEvent, ShutdownTimeout);
+	return TRUE;
+}
+
+
+double laplace(double fScale)
+{
+	// inverse CDF of the Laplace distribution; rand_s() draws from the
+	// system's cryptographic generator, so the noise cannot be predicted
+	unsigned int r = 0;
+	rand_s(&r);
+	const double u = ((double)r + 0.5) / 4294967296.0 - 0.5;
+	return u < 0? fScale * log(1 + 2 * u) : -fScale * log(1 - 2 * u);
+}
+
+
+double mouseMeters(const Counters& c)
+{
+	// raw distances are converted per device as they come in
+	return bRawDistance? c.fMouseMeters : c.fMouseDist / fDPI * 2.54 / 100;
+}
+
+
+void logCounters(Window& w, const Counters& c)
+{
+	Logger& out = *w.pLogger;
+	if (c.fMouseDist > 0)
+		out.logWithTimestamp("MOVE %lf px (%lf m)", c.fMouseDist, mouseMeters(c));
+	if (c.nWheel > 0)
+		out.logWithTimestamp("WHEEL %d", c.nWheel);
+	if (c.nWarps > 0)
+		out.logWithTimestamp("WARP %d (%lf px)", c.nWarps, c.fWarpDist);
+	if (c.nClicks > 0)
+		out.logWithTimestamp("CLICK %d", c.nClicks);
+	if (c.nDoubleClicks > 0)
+		out.logWithTimestamp("DBLCLICK %d", c.nDoubleClicks);
+	// every interval with key presses gets its full histogram, so that
+	// readers never have to carry one over from an earlier interval
+	if (!bKeyClasses && keyPresses(c) > 0) {
+		out.logWithTimestampNoLF("KEYSTAT ");
+		for (int i = 0; i < 256; ++i) {
+			out.log("%d", c.aHisto[i]);
+			if (i < 255)
+				out.log(",");
+		}
+		out.flush();
+	}
+	if (bKeyClasses) {
+		out.logWithTimestampNoLF("KEYCLASS ");
+		for (int i = 0; i < NumKeyClasses; ++i)
+			out.log(i < NumKeyClasses - 1? "%s %d, " : "%s %d", KeyClassTable::name(i), c.aKeyClasses[i]);
+		out.flush();
+	}
+}
+
+
+void writeCounters(Logger& out, const char* pszKind, ULONGLONG ullStartUtc, ULONGLONG ullEndUtc, const Counters& c)
+{
+	writeRecord(out, outputFormat, pszKind, ullStartUtc, ullEndUtc, c, mouseMeters(c), bKeyClasses? c.aKeyClasses : NULL);
+}
+
+
+bool hasActivity(const Counters& c)
+{
+	if (c.fMouseDist > 0 || c.nWheel > 0 || c.nClicks > 0 || c.nDoubleClicks > 0 || c.nWarps > 0)
+		return true;
+	return keyPresses(c) != 0;
+}
+
+
+void noiseKeyClasses(Counters& c)
+{
+	// with --key-noise the class counts of every base interval, idle or
+	// not, get independent Laplace noise of scale 1/epsilon, since one key
+	// press changes one count by one. Whether an interval is logged at all
+	// is then decided on the noised counts, so an interval whose only
+	// input was a key press cannot be told from an idle one. This happens
+	// once, before the interval is reported anywhere: windows, totals and
+	// archives are sums of noised intervals, so reporting them again
+	// reveals nothing new. The journal never sees the exact counts either,
+	// see journalCounters().
+	if (fKeyNoise <= 0)
+		return;
+	for (int i = 0; i < NumKeyClasses; ++i) {
+		const double fCount = c.aKeyClasses[i] + laplace(1 / fKeyNoise);
+		c.aKeyClasses[i] = fCount > 0? (int)(fCount + 0.5) : 0;
+	}
+}
+
+
+void logInterval(Window& w, ULONGLONG ullStartNs, ULONGLONG ullEndNs, const Counters& c)
+{
+	if (outputFormat != FormatText) {
+		writeCounters(*w.pLogger, "interval", Clock::toUtc(ullStartNs), Clock::toUtc(ullEndNs), c);
+		return;
+	}
+	if (!hasActivity(c))
+		return;
+	w.pLogger->logWithTimestamp("INTERVAL %I64u %I64u ns, events %I64u %I64u ns", ullStartNs, ullEndNs, c.ullFirstEventNs, c.ullLastEventNs);
+	logCounters(w, c);
+}
+
+
+void rollup(const Counters& closed, int nExpired, ULONGLONG ullEndNs)
+{
+	// hand the closed counters of each expired window on to the next
+	// coarser one; stop at the first window that keeps running
+	Counters carry = closed;
+	for (int i = 1; i < nWindows; ++i) {
+		Window& w = windows[i];
+		addCounters(w.counters, carry);
+		if (i >= nExpired)
+			break;
+		logInterval(w, w.ullStartNs, ullEndNs, w.counters);
+		carry = w.counters;
+		SecureZeroMemory(&w.counters, sizeof(w.counters));
+		w.ullStartNs = ullEndNs;
 	}
-	return FALSE;
 }
 
 
+void updateArchives(ULONGLONG ullStartNs, const Counters& c)
+{
+	if (nArchives == 0 || !hasActivity(c))
+		return;
+	RrdRecord r;
+	r.ullSlot = 0;
+	r.fMouseDist = c.fMouseDist;
+	r.nClicks = c.nClicks;
+	r.nDoubleClicks = c.nDoubleClicks;
+	r.nWheel = c.nWheel;
+	// with --key-noise these are the noised class counts
+	r.nKeys = keyPresses(c);
+	const ULONGLONG ullUtc = Clock::toUtc(ullStartNs);
+	for (int i = 0; i < nArchives; ++i)
+		archives[i].update(ullUtc, r);
+}
+
+
+bool archivesFit(UINT uInterval)
+{
+	for (int i = 0; i < nArchives; ++i)
+		if (archives[i].step() % uInterval != 0)
+			return false;
+	return true;
+}
+
+
+ULONGLONG baseTick(ULONGLONG ullNs)
+{
+	return Clock::toUtc(ullNs) / (10000000ULL * uTimerInterval);
+}
+
+
+int appendMetric(int cb, const char* pszFormat, ...)
+{
+	if (cb < 0 || (size_t)cb >= MaxMetricsSize)
+		return cb;
+	va_list args;
+	va_start(args, pszFormat);
+	const int n = _vsnprintf(szMetrics + cb, MaxMetricsSize - cb, pszFormat, args);
+	va_end(args);
+	return n < 0? (int)MaxMetricsSize : cb + n;
+}
+
+
+void publishMetrics(const Counters& last, ULONGLONG ullFlushNs)
+{
+	// rendered once per flush; scrapes only send the prepared text
+	const int nKeys = keyPresses(last);
+	int cb = 0;
+	cb = appendMetric(cb, "# TYPE actilog_mouse_distance_pixels counter\n"
+		"actilog_mouse_distance_pixels_total %.3lf\n"
+		"# TYPE actilog_mouse_distance_meters counter\n"
+		"actilog_mouse_distance_meters_total %.6lf\n"
+		"# TYPE actilog_clicks counter\n"
+		"actilog_clicks_total %d\n"
+		"# TYPE actilog_double_clicks counter\n"
+		"actilog_double_clicks_total %d\n"
+		"# TYPE actilog_wheel counter\n"
+		"actilog_wheel_total %d\n"
+		"# TYPE actilog_cursor_warps counter\n"
+		"actilog_cursor_warps_total %d\n"
+		"# TYPE actilog_cursor_warp_distance_pixels counter\n"
+		"actilog_cursor_warp_distance_pixels_total %.3lf\n"
+		"# TYPE actilog_key_presses counter\n",
+		totals.fMouseDist, mouseMeters(totals),
+		totals.nClicks, totals.nDoubleClicks, totals.nWheel,
+		totals.nWarps, totals.fWarpDist);
+	for (int i = 0; i < 256; ++i)
+		if (totals.aHisto[i] != 0)
+			cb = appendMetric(cb, "actilog_key_presses_total{vk=\"%d\"} %d\n", i, totals.aHisto[i]);
+	if (bKeyClasses) {
+		cb = appendMetric(cb, "# TYPE actilog_key_class_presses counter\n");
+		for (int i = 0; i < NumKeyClasses; ++i)
+			cb = appendMetric(cb, "actilog_key_class_presses_total{class=\"%s\"} %d\n", KeyClassTable::name(i), totals.aKeyClasses[i]);
+	}
+	if (bAnomalies) {
+		cb = appendMetric(cb, "# TYPE actilog_anomalies counter\n");
+		for (int i = 0; i < NumAnomalyKinds; ++i)
+			cb = appendMetric(cb, "actilog_anomalies_total{kind=\"%s\"} %u\n", AnomalyDetector::name((AnomalyKind)i), anAnomalies[i]);
+	}
+	cb = appendMetric(cb, "# TYPE actilog_interval_mouse_distance_pixels gauge\n"
+		"actilog_interval_mouse_distance_pixels %.3lf\n"
+		"# TYPE actilog_interval_clicks gauge\n"
+		"actilog_interval_clicks %d\n"
+		"# TYPE actilog_interval_double_clicks gauge\n"
+		"actilog_interval_double_clicks %d\n"
+		"# TYPE actilog_interval_wheel gauge\n"
+		"actilog_interval_wheel %d\n"
+		"# TYPE actilog_interval_key_presses gauge\n"
+		"actilog_interval_key_presses %d\n"
+		"# TYPE actilog_interval_seconds gauge\n"
+		"actilog_interval_seconds %u\n"
+		"# TYPE actilog_last_flush_timestamp_seconds gauge\n"
+		"actilog_last_flush_timestamp_seconds %.3lf\n"
+		"# EOF\n",
+		last.fMouseDist, last.nClicks, last.nDoubleClicks, last.nWheel, nKeys, uTimerInterval,
+		// FILETIME epoch (1601) to Unix epoch
+		(double)(LONGLONG)(Clock::toUtc(ullFlushNs) - 116444736000000000ULL) / 1e7);
+	if (cb < 0 || (size_t)cb >= MaxMetricsSize)
+		return;
+	metrics.publish(szMetrics, cb);
+}
+
+
+void logActivity(const ActivityTimeline& t)
+{
+	// runs in ms, '+' active and '-' idle
+	logger.logWithTimestampNoLF("ACTIVE %.3lf secs, timeline ", 1e-9 * (double)t.ullActiveNs);
+	for (int i = 0; i < t.nRuns; ++i)
+		logger.log("%c%I64u", t.bStartsActive == ((i & 1) == 0)? '+' : '-', t.aullRuns[i] / 1000000);
+	if (t.bTruncated)
+		logger.log("...");
+	logger.flush();
+}
+
+
+void checkAnomalies(const Counters& c)
+{
+	Anomaly aFound[AnomalyDetector::MaxAnomalies];
+	const int n = detector.check(c, aFound);
+	for (int i = 0; i < n; ++i) {
+		const Anomaly& a = aFound[i];
+		++anAnomalies[a.kind];
+		if (outputFormat != FormatText)
+			continue;
+		if (a.nKey >= 0)
+			logger.logWithTimestamp("ANOMALY %s vk %d value %.3lf baseline %.3lf score %.2lf", AnomalyDetector::name(a.kind), a.nKey, a.fValue, a.fBaseline, a.fScore);
+		else
+			logger.logWithTimestamp("ANOMALY %s %s value %.3lf baseline %.3lf score %.2lf", AnomalyDetector::name(a.kind), a.pszMetric, a.fValue, a.fBaseline, a.fScore);
+	}
+}
+
+
+void logSelfStats(const SelfStats& s)
+{
+	UINT nEvents = 0;
+	for (int i = 0; i < NumEventKinds; ++i)
+		nEvents += s.anEvents[i];
+	logger.logWithTimestamp("SELFSTAT events %u (move %u, wheel %u, down %u, up %u, dblclick %u, keydown %u, keyup %u, other %u), "
+		"mouse hook p50 %I64u p99 %I64u max %I64u ns, keyboard hook p50 %I64u p99 %I64u max %I64u ns, "
+		"slow %u, late %u, unmatched %u, missed %u",
+		nEvents, s.anEvents[EventMove], s.anEvents[EventWheel], s.anEvents[EventButtonDown], s.anEvents[EventButtonUp],
+		s.anEvents[EventDoubleClick], s.anEvents[EventKeyDown], s.anEvents[EventKeyUp], s.anEvents[EventOther],
+		s.mouseLatency.percentile(50), s.mouseLatency.percentile(99), s.mouseLatency.maximum(),
+		s.keyboardLatency.percentile(50), s.keyboardLatency.percentile(99), s.keyboardLatency.maximum(),
+		s.nSlow, s.nLate, s.nUnmatched, s.nMissed);
+}
+
+
+void logDevices()
+{
+	DeviceTable& table = rawInput.devices();
+	for (int i = 0; i < distances.count(); ++i) {
+		const double fCounts = distances.completedCounts(i);
+		if (fCounts > 0)
+			logger.logWithTimestamp("DEVICE %d %lf counts (%lf m) %s", i, fCounts, DeviceDistance::toMeters(fCounts, distances.dpi(i)), table.name(i));
+	}
+}
+
+
+void recycleDevices()
+{
+	// devices unplugged during the interval just written give their
+	// numbers to new devices from now on
+	DeviceTable& table = rawInput.devices();
+	for (int i = 0; i < table.count(); ++i) {
+		if (table.isRetired(i)) {
+			seats.resetDevice(i);
+			distances.resetDevice(i);
+			table.release(i);
+		}
+	}
+}
+
+
+void emitCompleted()
+{
+	logInterval(windows[0], ullCompletedStartNs, ullCompletedEndNs, completed);
+	if (bRawDistance && outputFormat == FormatText)
+		logDevices();
+	for (int i = 0; i < seats.count(); ++i)
+		logInterval(seats[i].window, ullCompletedStartNs, ullCompletedEndNs, seats[i].completed);
+	recycleDevices();
+	if (bSelfStat && outputFormat == FormatText)
+		logSelfStats(completedSelf);
+	if (bActivity && outputFormat == FormatText)
+		logActivity(completedActivity);
+	if (bAnomalies)
+		checkAnomalies(completed);
+	updateArchives(ullCompletedStartNs, completed);
+	if (metrics.isOpen()) {
+		addCounters(totals, completed);
+		publishMetrics(completed, ullCompletedEndNs);
+	}
+	bCompletedPending = false;
+	if (nWindows == 1)
+		return;
+	const ULONGLONG ullEndTick = baseTick(ullCompletedEndNs);
+	if (ullEndTick <= wheel.position() || ullEndTick - wheel.position() > wheel.revolution() + 1) {
+		// the wall clock has been stepped: close whatever is running
+		rollup(completed, nWindows, ullCompletedEndNs);
+		wheel.align(ullEndTick);
+		return;
+	}
+	rollup(completed, wheel.tick(), ullCompletedEndNs);
+	// base intervals skipped while the machine was asleep still have to
+	// close the coarser windows they span
+	Counters empty;
+	SecureZeroMemory(&empty, sizeof(empty));
+	while (wheel.position() < ullEndTick)
+		rollup(empty, wheel.tick(), ullCompletedEndNs);
+}
+
+
+void logClockAnchor()
+{
+	// structured records carry UTC already
+	if (outputFormat != FormatText)
+		return;
+	TCHAR szUtc[40];
+	Clock::formatUtc(Clock::anchorUtc(), szUtc, 40);
+	logger.logWithTimestamp("CLOCK %I64u ns = %s", Clock::anchorNs(), szUtc);
+}
+
+
+ULONGLONG nextBoundary(ULONGLONG ullNs)
+{
+	// intervals end on multiples of the interval length in UTC,
+	// e.g. at :00, :10, :20 ... for the default of 600 seconds
+	const ULONGLONG ullStep = 10000000ULL * uTimerInterval;
+	return Clock::toMonotonic((Clock::toUtc(ullNs) / ullStep + 1) * ullStep);
+}
+
+
+void closeInterval(ULONGLONG ullNow)
+{
+	// only one closed interval can wait for the timer; if the timer is
+	// late by more than a whole interval write out the older one now
+	if (bCompletedPending)
+		emitCompleted();
+	completed = counters;
+	noiseKeyClasses(completed);
+	seats.closeInterval();
+	for (int i = 0; i < seats.count(); ++i)
+		noiseKeyClasses(seats[i].completed);
+	distances.closeInterval();
+	rawInput.devices().closeInterval();
+	completedSelf = monitor.stats();
+	if (bActivity)
+		activity.close(ullIntervalEndNs, completedActivity);
+	monitor.stats().clear();
+	ullCompletedStartNs = ullIntervalStartNs;
+	ullCompletedEndNs = ullIntervalEndNs;
+	bCompletedPending = true;
+	SecureZeroMemory(&counters, sizeof(counters));
+	SecureZeroMemory(&lastCheckpoint, sizeof(lastCheckpoint));
+	ullIntervalStartNs = ullIntervalEndNs;
+	ullIntervalEndNs = nextBoundary(ullNow > ullIntervalEndNs? ullNow : ullIntervalEndNs);
+}
+
+
+void scheduleTimer(ULONGLONG ullNow);
+void checkpoint();
+void reloadSettings();
+
+
 void CALLBACK TimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
 {
-	if (fMouseDist > 0) {
-		logger.logWithTimestamp("MOVE %lf px (%lf m)", fMouseDist, fMouseDist / fDPI * 2.54 / 100);
-		fMouseDist = 0;
+	monitor.checkMissed();
+	// monitors may have been attached or rearranged since
+	if (warp.isMonitorAware())
+		warp.refreshMonitors();
+	ULONGLONG ullNow = Clock::now();
+	if (ullNow >= ullIntervalEndNs)
+		closeInterval(ullNow);
+	if (bCompletedPending) {
+		emitCompleted();
+		checkpoint();
+		// settings change only between two flushes, so every interval
+		// is written out entirely under one configuration
+		if (config.swap())
+			reloadSettings();
 	}
-	if (nWheel > 0) {
-		logger.logWithTimestamp("WHEEL %d", nWheel);
-		nWheel = 0;
+	const LONGLONG llDrift = Clock::drift();
+	if (ullNow >= ullNextAnchorNs || llDrift > ClockJumpThreshold || llDrift < -ClockJumpThreshold) {
+		Clock::anchor();
+		logClockAnchor();
+		ullNow = Clock::now();
+		ullNextAnchorNs = ullNow + 1000000000ULL * ClockAnchorInterval;
+		// the wall clock may have jumped: realign the running interval
+		ullIntervalEndNs = nextBoundary(ullNow);
 	}
-	if (nClicks > 0) {
-		logger.logWithTimestamp("CLICK %d", nClicks);
-		nClicks = 0;
+	scheduleTimer(ullNow);
+}
+
+
+void scheduleTimer(ULONGLONG ullNow)
+{
+	const UINT uDelay = ullIntervalEndNs > ullNow? (UINT)((ullIntervalEndNs - ullNow) / 1000000) + 1 : 1;
+	uIDTimer = SetTimer(NULL, uIDTimer, uDelay, TimerProc);
+}
+
+
+void journalCounters(Counters& dst, const Counters& src)
+{
+	// the running interval's key counts are not noised yet, so with
+	// --key-noise they stay out of the journal; a recovered interval
+	// reports noise only for them
+	dst = src;
+	if (fKeyNoise > 0)
+		SecureZeroMemory(dst.aKeyClasses, sizeof(dst.aKeyClasses));
+}
+
+
+void checkpoint()
+{
+	// the journal holds the running base interval followed by the
+	// accumulated, not yet written counters of every coarser window
+	journalCounters(aJournal[0], counters);
+	for (int i = 1; i < nWindows; ++i)
+		aJournal[i] = windows[i].counters;
+	bool bPending = false;
+	for (int i = 0; i < nWindows && !bPending; ++i)
+		bPending = hasActivity(aJournal[i]);
+	if (!bPending) {
+		journal.clear();
 	}
-	if (nDoubleClicks > 0) {
-		logger.logWithTimestamp("DBLCLICK %d", nDoubleClicks);
-		nDoubleClicks = 0;
+	else {
+		FILETIME ftIntervalStart;
+		Clock::toFileTime(Clock::toUtc(ullIntervalStartNs), &ftIntervalStart);
+		journal.checkpoint(aJournal, ftIntervalStart);
 	}
-	if (hasHistoChanged()) {
-		logger.logWithTimestampNoLF("KEYSTAT ");
-		for (int i = 0; i < 256; ++i) {
-			logger.log("%d", aHisto[i]);
-			if (i < 255)
-				logger.log(",");
+	lastCheckpoint = aJournal[0];
+}
+
+
+void runningSettings(Settings& s)
+{
+	s.uInterval = uTimerInterval;
+	s.fDPI = fDPI;
+	_tcsncpy(s.szOutput, logger.filename(), MAX_PATH);
+	s.uMetricsPort = uMetricsPort;
+	s.bSelfStat = bSelfStat;
+}
+
+
+void reportOpenError(const Logger& out)
+{
+	// Logger does not append gzip members to a plain log or vice versa
+	const DWORD dwError = GetLastError();
+	if (dwError == ERROR_BAD_FORMAT && bGzip)
+		fprintf(stderr, "Fatal error: '%s' is not compressed; append without --gzip, or use --overwrite or another file\n", out.filename());
+	else if (dwError == ERROR_BAD_FORMAT)
+		fprintf(stderr, "Fatal error: '%s' is compressed; append with --gzip, or use --overwrite or another file\n", out.filename());
+	else
+		fprintf(stderr, "Fatal error: cannot create file '%s'\n", out.filename());
+}
+
+
+void applyOutput(const TCHAR* pszOutput)
+{
+	// the logger keeps a pointer to its file name
+	TCHAR szPrevious[MAX_PATH];
+	_tcsncpy(szPrevious, logger.filename(), MAX_PATH);
+	_tcsncpy(szOutputFile, pszOutput, MAX_PATH);
+	if (!logger.open(false, szOutputFile)) {
+		fprintf(stderr, "Error: cannot create file '%s', keeping '%s'\n", szOutputFile, szPrevious);
+		_tcsncpy(szOutputFile, szPrevious, MAX_PATH);
+		logger.open(false, szOutputFile);
+	}
+	if (outputFormat == FormatCsv && !writeCsvHeader(logger, bKeyClasses)) {
+		fprintf(stderr, "Error: '%s' has other CSV columns, keeping '%s'\n", szOutputFile, szPrevious);
+		_tcsncpy(szOutputFile, szPrevious, MAX_PATH);
+		logger.open(false, szOutputFile);
+	}
+}
+
+
+void reloadSettings()
+{
+	const Settings& s = *config.current();
+	if (_tcscmp(s.szOutput, logger.filename()) != 0)
+		applyOutput(s.szOutput);
+	fDPI = s.fDPI;
+	distances.setDefaultDPI(fDPI);
+	bSelfStat = s.bSelfStat;
+	if (s.uInterval != uTimerInterval) {
+		if (nWindows > 1) {
+			// the timer wheel is laid out for the ratios between the windows
+			fprintf(stderr, "Error: cannot change the interval while --window is in use\n");
 		}
-		logger.flush();
-		for (int i = 0; i < 256; ++i) {
-			aLastHisto[i] = aHisto[i];
-			aHisto[i] = 0;
+		else if (!archivesFit(s.uInterval)) {
+			fprintf(stderr, "Error: cannot change the interval to %u secs, the archive steps are no multiples of it\n", s.uInterval);
+		}
+		else {
+			// the interval that has just begun already ends on the new grid
+			uTimerInterval = s.uInterval;
+			windows[0].uSeconds = uTimerInterval;
+			ullIntervalEndNs = nextBoundary(ullIntervalStartNs);
+		}
+	}
+	if (s.uMetricsPort != uMetricsPort) {
+		metrics.close();
+		uMetricsPort = s.uMetricsPort;
+		if (uMetricsPort != 0 && !metrics.open(uMetricsPort)) {
+			fprintf(stderr, "Error: cannot listen on port %u\n", uMetricsPort);
+			uMetricsPort = 0;
+		}
+		if (metrics.isOpen())
+			publishMetrics(completed, ullCompletedEndNs);
+	}
+	if (outputFormat == FormatText)
+		logger.logWithTimestamp("CONFIG interval = %d secs, dpi = %lf, metrics port = %u", uTimerInterval, fDPI, uMetricsPort);
+}
+
+
+void CALLBACK CheckpointProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
+{
+	// only touch the journal if something it records has happened since
+	// the last checkpoint; with --key-noise key presses alone do not count
+	Counters current;
+	journalCounters(current, counters);
+	if (memcmp(&current, &lastCheckpoint, sizeof(current)) == 0)
+		return;
+	checkpoint();
+}
+
+
+void formatFileTime(const FILETIME& ft, TCHAR* pszDest, size_t cchDest)
+{
+	FILETIME ftLocal;
+	SYSTEMTIME t;
+	FileTimeToLocalFileTime(&ft, &ftLocal);
+	FileTimeToSystemTime(&ftLocal, &t);
+	_sntprintf(pszDest, cchDest, TEXT("%4d-%02d-%02d %02d:%02d:%02d"), t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond);
+}
+
+
+void drainMessages(DWORD dwTimeout)
+{
+	// dispatch whatever input has been queued up so far, but never
+	// longer than dwTimeout milliseconds
+	const DWORD dwStart = GetTickCount();
+	MSG msg;
+	while (GetTickCount() - dwStart < dwTimeout && PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+		if (msg.message == WM_QUIT)
+			break;
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+}
+
+
+void finalFlush()
+{
+	const ULONGLONG ullNow = Clock::now();
+	if (bCompletedPending)
+		emitCompleted();
+	noiseKeyClasses(counters);
+	updateArchives(ullIntervalStartNs, counters);
+	Counters carry = counters;
+	for (int i = 0; i < nWindows; ++i) {
+		Window& w = windows[i];
+		const ULONGLONG ullStartNs = i == 0? ullIntervalStartNs : w.ullStartNs;
+		if (i > 0) {
+			addCounters(w.counters, carry);
+			carry = w.counters;
+		}
+		if (outputFormat != FormatText) {
+			writeCounters(*w.pLogger, "partial", Clock::toUtc(ullStartNs), Clock::toUtc(ullNow), carry);
+			continue;
+		}
+		w.pLogger->logWithTimestamp("PARTIAL %.3lf secs", 1e-9 * (double)(ullNow - ullStartNs));
+		logInterval(w, ullStartNs, ullNow, carry);
+	}
+	if (bActivity && outputFormat == FormatText) {
+		activity.close(ullNow, completedActivity);
+		logActivity(completedActivity);
+	}
+	for (int i = 0; i < seats.count(); ++i) {
+		Window& w = seats[i].window;
+		noiseKeyClasses(w.counters);
+		if (outputFormat != FormatText) {
+			writeCounters(*w.pLogger, "partial", Clock::toUtc(ullIntervalStartNs), Clock::toUtc(ullNow), w.counters);
+			continue;
+		}
+		w.pLogger->logWithTimestamp("PARTIAL %.3lf secs", 1e-9 * (double)(ullNow - ullIntervalStartNs));
+		logInterval(w, ullIntervalStartNs, ullNow, w.counters);
+	}
+	SecureZeroMemory(&counters, sizeof(counters));
+	journal.clear();
+}
+
+
+void recoverJournal()
+{
+	FILETIME ftStart, ftCheckpoint;
+	if (!journal.recover(aJournal, &ftStart, &ftCheckpoint))
+		return;
+	TCHAR szStart[32], szCheckpoint[32];
+	formatFileTime(ftStart, szStart, 32);
+	formatFileTime(ftCheckpoint, szCheckpoint, 32);
+	// a coarser window had not seen the pending counters of the finer ones
+	// yet; only the base interval's counts still need their noise
+	noiseKeyClasses(aJournal[0]);
+	Counters recovered;
+	SecureZeroMemory(&recovered, sizeof(recovered));
+	for (int i = 0; i < nWindows; ++i) {
+		addCounters(recovered, aJournal[i]);
+		if (!hasActivity(recovered))
+			continue;
+		if (outputFormat != FormatText) {
+			ULARGE_INTEGER uStart, uCheckpoint;
+			uStart.LowPart = ftStart.dwLowDateTime;
+			uStart.HighPart = ftStart.dwHighDateTime;
+			uCheckpoint.LowPart = ftCheckpoint.dwLowDateTime;
+			uCheckpoint.HighPart = ftCheckpoint.dwHighDateTime;
+			writeCounters(*windows[i].pLogger, "recovered", uStart.QuadPart, uCheckpoint.QuadPart, recovered);
+			continue;
+		}
+		windows[i].pLogger->logWithTimestamp("RECOVER %s - %s", szStart, szCheckpoint);
+		logCounters(windows[i], recovered);
+	}
+	journal.clear();
+}
+
+
+void RawInputProc(int nDevice, const RAWINPUT& ri, double fMotion)
+{
+	// raw input does not pass stampEvent(), but must not be added to an
+	// interval that has ended before the timer got to close it either
+	const ULONGLONG ullNow = Clock::now();
+	if (ullNow >= ullIntervalEndNs)
+		closeInterval(ullNow);
+	const TCHAR* pszName = rawInput.devices().name(nDevice);
+	double fMeters = 0;
+	if (bRawDistance && fMotion > 0) {
+		// absolute devices move in pixels, which only --dpi can convert
+		if (rawInput.devices().isAbsolute(nDevice))
+			fMeters = DeviceDistance::toMeters(fMotion, fDPI);
+		else
+			fMeters = distances.add(nDevice, pszName, fMotion);
+		counters.fMouseMeters += fMeters;
+	}
+	seats.input(nDevice, pszName, ri, fMotion, fMeters);
+}
+
+
+bool addWindow(const TCHAR* pszSpec)
+{
+	// "seconds[,file]"
+	if (nWindows >= TimerWheel::MaxLevels)
+		return false;
+	Window& w = windows[nWindows];
+	TCHAR* pszEnd;
+	w.uSeconds = _tcstoul(pszSpec, &pszEnd, 10);
+	if (w.uSeconds == 0)
+		return false;
+	if (*pszEnd != TEXT(',') && *pszEnd != 0)
+		return false;
+	w.pLogger = new Logger;
+	if (*pszEnd == TEXT(','))
+		w.pLogger->setFilename(pszEnd + 1);
+	++nWindows;
+	return true;
+}
+
+
+bool openArchives()
+{
+	// "<step>x<rows>,..." -> one file "<prefix>.<step>.rrd" per tier
+	if (pszRrdPrefix == NULL)
+		return true;
+	const TCHAR* p = pszRrdTiers;
+	while (*p != 0) {
+		TCHAR* pszEnd;
+		const UINT uStep = _tcstoul(p, &pszEnd, 10);
+		const UINT uRows = (*pszEnd == TEXT('x'))? _tcstoul(pszEnd + 1, &pszEnd, 10) : 0;
+		if (uStep == 0 || uRows == 0 || (*pszEnd != 0 && *pszEnd != TEXT(',')) || nArchives >= MaxRrdTiers) {
+			fprintf(stderr, "Fatal error: bad archive tier specification '%s'\n", pszRrdTiers);
+			return false;
+		}
+		if (uStep % uTimerInterval != 0) {
+			// every interval is added to one row only, so the rows in between would stay empty
+			fprintf(stderr, "Fatal error: archive step of %u secs is not a multiple of the interval of %u secs\n", uStep, uTimerInterval);
+			return false;
+		}
+		TCHAR szFilename[MAX_PATH];
+		_sntprintf(szFilename, MAX_PATH, TEXT("%s.%u.rrd"), pszRrdPrefix, uStep);
+		if (!archives[nArchives].open(szFilename, uStep, uRows)) {
+			fprintf(stderr, "Fatal error: cannot open archive '%s'\n", szFilename);
+			return false;
 		}
+		++nArchives;
+		p = (*pszEnd == TEXT(','))? pszEnd + 1 : pszEnd;
 	}
+	return true;
+}
+
+
+bool setupWindows()
+{
+	windows[0].uSeconds = uTimerInterval;
+	windows[0].pLogger = &logger;
+	for (int i = 1; i < nWindows; ++i) {
+		for (int j = i; j > 1 && windows[j].uSeconds < windows[j - 1].uSeconds; --j) {
+			Window tmp = windows[j];
+			windows[j] = windows[j - 1];
+			windows[j - 1] = tmp;
+		}
+	}
+	for (int i = 1; i < nWindows; ++i) {
+		if (windows[i].uSeconds <= windows[i - 1].uSeconds || windows[i].uSeconds % windows[i - 1].uSeconds != 0) {
+			fprintf(stderr, "Fatal error: window of %u secs is not a multiple of %u secs\n", windows[i].uSeconds, windows[i - 1].uSeconds);
+			return false;
+		}
+		wheel.addLevel(windows[i].uSeconds / windows[i - 1].uSeconds);
+	}
+	for (int i = 0; i < nWindows; ++i) {
+		SecureZeroMemory(&windows[i].counters, sizeof(windows[i].counters));
+		windows[i].pLogger->setIndex(nIndexEvery);
+		windows[i].pLogger->setCompression(bGzip);
+		if (i > 0 && !windows[i].pLogger->open(bOverwrite)) {
+			reportOpenError(*windows[i].pLogger);
+			return false;
+		}
+		if (outputFormat == FormatCsv && !writeCsvHeader(*windows[i].pLogger, bKeyClasses)) {
+			fprintf(stderr, "Fatal error: '%s' has other CSV columns; use --overwrite or another file\n", windows[i].pLogger->filename());
+			return false;
+		}
+	}
+	return true;
 }
 
 
@@ -227,10 +1081,97 @@ void usage()
 		"     (default: %lf)\n"
 		"  --overwrite\n"
 		"     do not append to file\n"
+		"  --gzip\n"
+		"     compress the files as gzip while writing; with --index the\n"
+		"     index points at the gzip members\n"
+		"  --journal file\n"
+		"     checkpoint pending counters to 'file' every %d seconds and\n"
+		"     recover them after a crash (default: output file + '%s';\n"
+		"     none when writing to console)\n"
 		"  -i interval\n"
 		"  --interval interval\n"
 		"     log summarized mouse events every 'interval' seconds\n"
-		"     (default: %d seconds)\n"
+		"     (intervals end on UTC multiples of 'interval';\n"
+		"     default: %d seconds)\n"
+		"  --window secs[,file]\n"
+		"     additionally log rollups over 'secs' seconds to 'file'\n"
+		"     (default: console); 'secs' must be a multiple of 'interval'\n"
+		"     and of any shorter window; may be given up to %d times\n"
+		"  --index n\n"
+		"     maintain a sidecar time index '<file>%s' with an entry\n"
+		"     every n records (default: no index)\n"
+		"  --rebuild-index file\n"
+		"     (re)build the time index of an existing log and exit\n"
+		"     (one entry every %d records unless --index comes first;\n"
+		"     not for a --gzip log, whose index is written along with it)\n"
+		"  --rrd prefix\n"
+		"     also keep bounded round-robin archives 'prefix.<step>.rrd'\n"
+		"  --rrd-tiers <step>x<rows>[,...]\n"
+		"     archive resolutions and sizes; every step must be a multiple of\n"
+		"     'interval' (default: %s, i.e. 10 minutes for a\n"
+		"     week, hours for a year, days for 100 years)\n"
+		"  --format text|ndjson|csv\n"
+		"     write one line per interval with all counters as fields\n"
+		"     (kind, start, end, secs, first_event_ns, last_event_ns,\n"
+		"     mouse_px, mouse_m, clicks, double_clicks, wheel, keys,\n"
+		"     warps, warp_px)\n"
+		"     instead of the text format (default: text)\n"
+		"  --selfstat\n"
+		"     log a SELFSTAT line per interval with the number of events by\n"
+		"     type, hook latency percentiles and counts of slow hook calls,\n"
+		"     late events, unmatched releases and input the hooks missed\n"
+		"  --key-classes\n"
+		"     count key presses only per class (letters, digits, modifiers,\n"
+		"     navigation, editing, function, other) and log them as KEYCLASS\n"
+		"     instead of per-key KEYSTAT\n"
+		"  --key-noise epsilon\n"
+		"     implies --key-classes; add Laplace noise of scale 1/epsilon\n"
+		"     to the key class counts of every interval, once, idle or not;\n"
+		"     windows, totals and archives are sums of the noised counts, and\n"
+		"     key presses do not show in event times, activity or the journal\n"
+		"  --metrics-port port\n"
+		"     serve totals and the last interval in OpenMetrics text format\n"
+		"     on http://127.0.0.1:port/ (refreshed every interval)\n"
+		"  --seat match[,file]\n"
+		"     additionally count the input of all devices whose name contains\n"
+		"     'match' (e.g. a VID_xxxx&PID_xxxx pair) on their own and log it\n"
+		"     to 'file' (default: console); mouse distances are in raw device\n"
+		"     counts, or in pixels for tablets and remote sessions, double\n"
+		"     clicks are not counted; may be given up to %d times\n"
+		"  --list-devices\n"
+		"     list the names of all mice and keyboards and exit\n"
+		"  --raw-distance\n"
+		"     measure mouse distances in meters from the raw motion counts of\n"
+		"     each device instead of from screen pixels, which removes pointer\n"
+		"     acceleration; devices are converted with --dpi unless calibrated\n"
+		"     with --device-dpi, and in text format a DEVICE line per device\n"
+		"     and interval shows its share; tablets and remote sessions report\n"
+		"     absolute positions, whose pixels are converted with --dpi and\n"
+		"     get no DEVICE line\n"
+		"  --device-dpi match=dpi\n"
+		"     implies --raw-distance; devices whose name contains 'match'\n"
+		"     report 'dpi' counts per inch (see --list-devices)\n"
+		"  --warp-speed v\n"
+		"     count moves faster than v pixels per millisecond as cursor\n"
+		"     warps, which are logged as WARP instead of adding to the\n"
+		"     distance (suggested: %.0lf; default: no filtering)\n"
+		"  --warp-monitors\n"
+		"     also count moves between monitors that do not touch and wraps\n"
+		"     from one edge of the desktop to the opposite one as warps\n"
+		"  --idle secs\n"
+		"     log an ACTIVE line per interval with the exact active time and\n"
+		"     a timeline of active (+) and idle (-) runs in ms; every event\n"
+		"     keeps the user active for 'secs' seconds (suggested: %u)\n"
+		"  --anomaly z\n"
+		"     log an ANOMALY line for spikes and drops of a counter by more\n"
+		"     than z deviations from its running baseline (suggested: %.0lf),\n"
+		"     for a stuck key and for a constant click rate\n"
+		"  --config file\n"
+		"     read interval, dpi, output, metrics-port and selfstat from the\n"
+		"     [actilog] section of the INI file 'file' (options given after it\n"
+		"     take precedence) and reload them whenever the file changes;\n"
+		"     only values changed in the file are applied, at the end of the\n"
+		"     running interval\n"
 		"  -h\n"
 		"  -?\n"
 		"  --help\n"
@@ -238,13 +1179,22 @@ void usage()
 		"\n",
 		AppInfo,
 		DefaultDPI,
-		DefaultTimerInterval);
+		JournalCheckpointInterval,
+		JournalExtension,
+		DefaultTimerInterval,
+		TimerWheel::MaxLevels - 1,
+		LogIndex::Extension,
+		DefaultIndexEvery,
+		DefaultRrdTiers,
+		SeatTable::MaxSeats,
+		WarpFilter::DefaultMaxSpeed,
+		ActivityTracker::DefaultIdleSeconds,
+		AnomalyDetector::DefaultThreshold);
 }
 
 
 int main(int argc, TCHAR* argv[])
 {
-	UINT uTimerInterval = DefaultTimerInterval;
 	for (;;) {
 		int option_index = 0;
 		int c = getopt_long(argc, argv, "h?i:vo:", long_options, &option_index);
@@ -264,6 +1214,9 @@ int main(int argc, TCHAR* argv[])
 		case SELECT_OVERWRITE:
 			bOverwrite = true;
 			break;
+		case SELECT_GZIP:
+			bGzip = true;
+			break;
 		case 'o':
 			// fall-through
 		case SELECT_OUTPUT_FILE:
@@ -276,6 +1229,113 @@ int main(int argc, TCHAR* argv[])
 		case SELECT_DPI:
 			fDPI = atof(optarg);
 			break;
+		case SELECT_JOURNAL:
+			_tcsncpy(szJournalFile, optarg, MAX_PATH - 1);
+			break;
+		case SELECT_INDEX:
+			nIndexEvery = atoi(optarg);
+			break;
+		case SELECT_REBUILD_INDEX:
+			if (GzipReader::isGzipFile(optarg)) {
+				fprintf(stderr, "Fatal error: '%s' is compressed; its index cannot be rebuilt\n", optarg);
+				return EXIT_FAILURE;
+			}
+			if (!LogIndex::rebuild(optarg, nIndexEvery > 0? nIndexEvery : DefaultIndexEvery)) {
+				fprintf(stderr, "Fatal error: cannot index '%s'\n", optarg);
+				return EXIT_FAILURE;
+			}
+			return EXIT_SUCCESS;
+		case SELECT_FORMAT:
+			if (optarg == NULL || !parseFormat(optarg, &outputFormat)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+		case SELECT_KEY_NOISE:
+			fKeyNoise = atof(optarg);
+			if (fKeyNoise <= 0) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			// fall-through
+		case SELECT_KEY_CLASSES:
+			bKeyClasses = true;
+			break;
+		case SELECT_SELFSTAT:
+			bSelfStat = true;
+			break;
+		case SELECT_METRICS_PORT:
+			uMetricsPort = (USHORT)atoi(optarg);
+			break;
+		case SELECT_RRD:
+			pszRrdPrefix = optarg;
+			break;
+		case SELECT_RRD_TIERS:
+			pszRrdTiers = optarg;
+			break;
+		case SELECT_SEAT:
+			if (optarg == NULL || !seats.add(optarg)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+		case SELECT_CONFIG:
+		{
+			Settings defaults;
+			runningSettings(defaults);
+			if (!config.open(optarg, defaults)) {
+				fprintf(stderr, "Fatal error: cannot read configuration '%s'\n", optarg);
+				return EXIT_FAILURE;
+			}
+			const Settings& s = *config.current();
+			uTimerInterval = s.uInterval;
+			fDPI = s.fDPI;
+			_tcsncpy(szOutputFile, s.szOutput, MAX_PATH);
+			logger.setFilename(szOutputFile);
+			uMetricsPort = s.uMetricsPort;
+			bSelfStat = s.bSelfStat;
+			break;
+		}
+		case SELECT_DEVICE_DPI:
+			if (optarg == NULL || !distances.addProfile(optarg)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			// fall-through
+		case SELECT_RAW_DISTANCE:
+			bRawDistance = true;
+			break;
+		case SELECT_WARP_SPEED:
+			warp.setMaxSpeed(atof(optarg));
+			break;
+		case SELECT_WARP_MONITORS:
+			warp.setMonitorAware(true);
+			break;
+		case SELECT_IDLE:
+			if (atoi(optarg) <= 0) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			activity.setIdleThreshold(1000000000ULL * atoi(optarg));
+			bActivity = true;
+			break;
+		case SELECT_ANOMALY:
+			if (atof(optarg) <= 0) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			detector.setThreshold(atof(optarg));
+			bAnomalies = true;
+			break;
+		case SELECT_LIST_DEVICES:
+			RawInput::listDevices();
+			return EXIT_SUCCESS;
+		case SELECT_WINDOW:
+			if (optarg == NULL || !addWindow(optarg)) {
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'i':
 			// fall-through
 		case SELECT_INTERVAL:
@@ -284,37 +1344,130 @@ int main(int argc, TCHAR* argv[])
 				return EXIT_FAILURE;
 			}
 			uTimerInterval = atoi(optarg);
+			if (uTimerInterval == 0) {
+				usage();
+				return EXIT_FAILURE;
+			}
 			break;
 		default:
 			usage();
 			return EXIT_FAILURE;
 		}
 	}
-	SecureZeroMemory(aHisto, 256*sizeof(aHisto[0]));
-	SecureZeroMemory(aLastHisto, 256*sizeof(aLastHisto[0]));
+	SecureZeroMemory(&counters, sizeof(counters));
+	SecureZeroMemory(&lastCheckpoint, sizeof(lastCheckpoint));
+	SecureZeroMemory(&totals, sizeof(totals));
+	logger.setIndex(nIndexEvery);
+	logger.setCompression(bGzip);
 	bool success = logger.open(bOverwrite);
 	if (!success) {
-		fprintf(stderr, "Fatal error: cannot create file '%s'\n", logger.filename());
+		reportOpenError(logger);
 		return EXIT_FAILURE;
 	}
-	if (bVerbose)
+	if (!setupWindows() || !openArchives())
+		return EXIT_FAILURE;
+	if (!seats.open(bOverwrite, nIndexEvery, bGzip, bKeyClasses))
+		return EXIT_FAILURE;
+	distances.setDefaultDPI(fDPI);
+	if ((bRawDistance || seats.count() > 0) && !rawInput.open(RawInputProc)) {
+		fprintf(stderr, "Fatal error: cannot register for raw input\n");
+		return EXIT_FAILURE;
+	}
+	for (int i = 0; i < seats.count(); ++i) {
+		if (outputFormat == FormatCsv && !writeCsvHeader(*seats[i].window.pLogger, bKeyClasses)) {
+			fprintf(stderr, "Fatal error: '%s' has other CSV columns; use --overwrite or another file\n", seats[i].window.pLogger->filename());
+			return EXIT_FAILURE;
+		}
+	}
+	if (szJournalFile[0] == 0 && !logger.isConsole())
+		_sntprintf(szJournalFile, MAX_PATH, TEXT("%s%s"), logger.filename(), JournalExtension);
+	if (szJournalFile[0] != 0) {
+		if (!journal.open(szJournalFile, nWindows * sizeof(Counters))) {
+			fprintf(stderr, "Fatal error: cannot open journal '%s'\n", szJournalFile);
+			return EXIT_FAILURE;
+		}
+		recoverJournal();
+	}
+	Clock::init();
+	ullIntervalStartNs = Clock::now();
+	ullIntervalEndNs = nextBoundary(ullIntervalStartNs);
+	activity.start(ullIntervalStartNs);
+	ullNextAnchorNs = ullIntervalStartNs + 1000000000ULL * ClockAnchorInterval;
+	for (int i = 1; i < nWindows; ++i)
+		windows[i].ullStartNs = ullIntervalStartNs;
+	wheel.align(baseTick(ullIntervalEndNs) - 1);
+	if (bVerbose && outputFormat == FormatText)
 		logger.logWithTimestamp("START interval = %d secs, dpi = %lf", uTimerInterval, fDPI);
+	logClockAnchor();
+	if (uMetricsPort != 0) {
+		if (!metrics.open(uMetricsPort)) {
+			fprintf(stderr, "Fatal error: cannot listen on port %u\n", uMetricsPort);
+			return EXIT_FAILURE;
+		}
+		publishMetrics(counters, ullIntervalStartNs);
+	}
 	HINSTANCE hApp = GetModuleHandle(NULL);
+	hShutdownEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	hShutdownDoneEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 	SetConsoleCtrlHandler(CtlHandlerRoutine, TRUE);
 	HHOOK hKeyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, LowLevelKeyboardProc, hApp, 0);
 	HHOOK hMouseHook = SetWindowsHookEx(WH_MOUSE_LL, LowLevelMouseProc, hApp, 0);
-	UINT_PTR uIDTimer = SetTimer(NULL, 0, 1000 * uTimerInterval, TimerProc);
+	scheduleTimer(Clock::now());
+	UINT_PTR uIDCheckpointTimer = journal.isOpen()? SetTimer(NULL, 0, 1000 * JournalCheckpointInterval, CheckpointProc) : 0;
 	MSG msg;
-	while (GetMessage(&msg, NULL, 0, 0) > 0) {
-		TranslateMessage(&msg);
-		DispatchMessage(&msg);
+	bool bRunning = true;
+	while (bRunning) {
+		// a reload may open or close the metrics socket
+		HANDLE ahWait[3] = { hShutdownEvent, config.event(), metrics.event() };
+		if (!config.isOpen())
+			ahWait[1] = ahWait[2];
+		const DWORD nWait = 1 + (config.isOpen()? 1 : 0) + (metrics.isOpen()? 1 : 0);
+		const DWORD dwWait = MsgWaitForMultipleObjects(nWait, ahWait, FALSE, INFINITE, QS_ALLINPUT);
+		if (dwWait == WAIT_OBJECT_0)
+			break;
+		if (dwWait > WAIT_OBJECT_0 && dwWait < WAIT_OBJECT_0 + nWait) {
+			if (ahWait[dwWait - WAIT_OBJECT_0] == config.event()) {
+				Settings running;
+				runningSettings(running);
+				config.poll(running);
+			}
+			else {
+				metrics.process();
+			}
+		}
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+			if (msg.message == WM_QUIT) {
+				bRunning = false;
+				break;
+			}
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
 	}
+	if (pszShutdownReason && outputFormat == FormatText)
+		logger.logWithTimestamp("%s", pszShutdownReason);
+	drainMessages(ShutdownTimeout / 2);
+	if (uIDCheckpointTimer)
+		KillTimer(NULL, uIDCheckpointTimer);
 	KillTimer(NULL, uIDTimer);
 	UnhookWindowsHookEx(hMouseHook);
 	UnhookWindowsHookEx(hKeyboardHook);
-	if (bVerbose)
+	finalFlush();
+	if (bVerbose && outputFormat == FormatText)
 		logger.logWithTimestamp("STOP");
 	logger.close();
+	for (int i = 1; i < nWindows; ++i) {
+		windows[i].pLogger->close();
+		delete windows[i].pLogger;
+	}
+	rawInput.close();
+	seats.close();
+	for (int i = 0; i < nArchives; ++i)
+		archives[i].close();
+	journal.close();
+	metrics.close();
+	config.close();
+	SetEvent(hShutdownDoneEvent);
 	return EXIT_SUCCESS;
 }
 
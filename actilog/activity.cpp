@@ -0,0 +1,90 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "activity.h"
+
+
+ActivityTracker::ActivityTracker()
+	: ullThresholdNs(1000000000ULL * DefaultIdleSeconds)
+	, ullCursorNs(0)
+	, ullActiveUntilNs(0)
+{
+	SecureZeroMemory(&timeline, sizeof(timeline));
+}
+
+
+void ActivityTracker::start(ULONGLONG ullStartNs)
+{
+	ullCursorNs = ullStartNs;
+	ullActiveUntilNs = 0;
+	timeline.ullActiveNs = 0;
+	timeline.nRuns = 0;
+	timeline.bTruncated = false;
+}
+
+
+void ActivityTracker::append(bool bActive, ULONGLONG ullNs)
+{
+	if (ullNs == 0)
+		return;
+	if (bActive)
+		timeline.ullActiveNs += ullNs;
+	const bool bLastActive = timeline.bStartsActive == ((timeline.nRuns & 1) != 0);
+	if (timeline.nRuns > 0 && bLastActive == bActive) {
+		timeline.aullRuns[timeline.nRuns - 1] += ullNs;
+		return;
+	}
+	if (timeline.nRuns == ActivityTimeline::MaxRuns) {
+		timeline.aullRuns[timeline.nRuns - 1] += ullNs;
+		timeline.bTruncated = true;
+		return;
+	}
+	if (timeline.nRuns == 0)
+		timeline.bStartsActive = bActive;
+	timeline.aullRuns[timeline.nRuns++] = ullNs;
+}
+
+
+void ActivityTracker::beginPeriod(ULONGLONG ullNow)
+{
+	// the previous period ended at ullActiveUntilNs, idle since then
+	if (ullActiveUntilNs > ullCursorNs) {
+		append(true, ullActiveUntilNs - ullCursorNs);
+		ullCursorNs = ullActiveUntilNs;
+	}
+	if (ullNow > ullCursorNs) {
+		append(false, ullNow - ullCursorNs);
+		ullCursorNs = ullNow;
+	}
+	ullActiveUntilNs = ullNow + ullThresholdNs;
+}
+
+
+void ActivityTracker::close(ULONGLONG ullEndNs, ActivityTimeline& completed)
+{
+	if (ullActiveUntilNs > ullCursorNs) {
+		const ULONGLONG ullActiveEndNs = ullActiveUntilNs < ullEndNs? ullActiveUntilNs : ullEndNs;
+		append(true, ullActiveEndNs - ullCursorNs);
+		ullCursorNs = ullActiveEndNs;
+	}
+	if (ullEndNs > ullCursorNs)
+		append(false, ullEndNs - ullCursorNs);
+	completed = timeline;
+	// a period running across the boundary goes on in the next interval
+	const ULONGLONG ullActiveUntilNs = this->ullActiveUntilNs;
+	start(ullEndNs);
+	this->ullActiveUntilNs = ullActiveUntilNs;
+}
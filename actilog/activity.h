@@ -0,0 +1,64 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+
+/// Active and idle time of one interval: the exact active time and the
+/// lengths of alternating idle and active runs, in nanoseconds, which
+/// together cover the interval without gaps.
+struct ActivityTimeline {
+	static const int MaxRuns = 512;
+	ULONGLONG ullActiveNs;
+	ULONGLONG aullRuns[MaxRuns];
+	int nRuns;
+	bool bStartsActive;
+	bool bTruncated;
+};
+
+
+/// Tracks activity periods from the time stamps of single events. Every
+/// event keeps the user active for the idle threshold after it, the way a
+/// screen saver timeout does, so active time is the union of those spans.
+/// An event inside a running period only pushes its end; runs are only
+/// recorded where a period starts or ends, and periods running across an
+/// interval boundary are split there. If an interval has more runs than
+/// fit, the rest of it is recorded as one run and the timeline is marked
+/// truncated; the active time stays exact.
+class ActivityTracker {
+public:
+	static const UINT DefaultIdleSeconds = 60;
+	ActivityTracker();
+	void setIdleThreshold(ULONGLONG ullNs) { ullThresholdNs = ullNs; }
+	void start(ULONGLONG ullStartNs);
+	void event(ULONGLONG ullNow)
+	{
+		if (ullNow < ullActiveUntilNs)
+			ullActiveUntilNs = ullNow + ullThresholdNs;
+		else
+			beginPeriod(ullNow);
+	}
+	void close(ULONGLONG ullEndNs, ActivityTimeline& completed);
+
+private:
+	ULONGLONG ullThresholdNs;
+	ULONGLONG ullCursorNs;
+	ULONGLONG ullActiveUntilNs;
+	ActivityTimeline timeline;
+	void beginPeriod(ULONGLONG ullNow);
+	void append(bool bActive, ULONGLONG ullNs);
+};
@@ -0,0 +1,140 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "anomaly.h"
+#include <math.h>
+
+const double AnomalyDetector::DefaultThreshold = 4.0;
+// about the last 20 active intervals carry weight
+const double AnomalyDetector::Alpha = 0.1;
+const char* AnomalyDetector::MetricNames[NumMetrics] = { "mouse_px", "clicks", "wheel", "keys" };
+
+static const char* KindNames[NumAnomalyKinds] = { "spike", "drop", "stuck_key", "constant_clicks" };
+// a stuck key dominates the presses of an interval
+static const double StuckKeyShare = 0.5;
+static const int StuckKeyMinPresses = 100;
+static const double ConstantClicksTolerance = 0.02;
+static const int ConstantClicksMin = 20;
+
+
+void Baseline::update(double x, double fAlpha, double fClamp)
+{
+	if (nSamples++ == 0) {
+		fMean = x;
+		fVar = 0;
+		return;
+	}
+	const double fLimit = fClamp * deviation();
+	if (x > fMean + fLimit)
+		x = fMean + fLimit;
+	else if (x < fMean - fLimit)
+		x = fMean - fLimit;
+	// West's incremental form of the exponentially weighted variance
+	const double fDiff = x - fMean;
+	const double fIncr = fAlpha * fDiff;
+	fMean += fIncr;
+	fVar = (1 - fAlpha) * (fVar + fDiff * fIncr);
+}
+
+
+double Baseline::deviation() const
+{
+	// counts are at least as noisy as a Poisson process with the same
+	// mean, which keeps quiet series from producing huge scores
+	const double fFloor = fMean > 1? fMean : 1;
+	return sqrt(fVar > fFloor? fVar : fFloor);
+}
+
+
+AnomalyDetector::AnomalyDetector()
+	: fThreshold(DefaultThreshold)
+	, nLastClicks(0)
+	, nSameClicks(0)
+{
+	SecureZeroMemory(aMetrics, sizeof(aMetrics));
+	SecureZeroMemory(aKeys, sizeof(aKeys));
+}
+
+
+const char* AnomalyDetector::name(AnomalyKind kind)
+{
+	return KindNames[kind];
+}
+
+
+int AnomalyDetector::check(const Counters& c, Anomaly* aAnomalies)
+{
+	const int nKeys = keyPresses(c);
+	double afValues[NumMetrics];
+	afValues[MetricMouse] = c.fMouseDist;
+	afValues[MetricClicks] = c.nClicks;
+	afValues[MetricWheel] = c.nWheel;
+	afValues[MetricKeys] = nKeys;
+	if (c.fMouseDist == 0 && c.nClicks == 0 && c.nWheel == 0 && nKeys == 0)
+		return 0;
+	int n = 0;
+	const bool bWarm = aMetrics[0].nSamples >= WarmupIntervals;
+	for (int i = 0; i < NumMetrics && bWarm; ++i) {
+		const double fScore = aMetrics[i].score(afValues[i]);
+		if (fScore > fThreshold || fScore < -fThreshold) {
+			Anomaly& a = aAnomalies[n++];
+			a.kind = fScore > 0? AnomalySpike : AnomalyDrop;
+			a.pszMetric = MetricNames[i];
+			a.nKey = -1;
+			a.fValue = afValues[i];
+			a.fBaseline = aMetrics[i].fMean;
+			a.fScore = fScore;
+		}
+	}
+	if (bWarm && nKeys >= StuckKeyMinPresses) {
+		for (int i = 0; i < 256; ++i) {
+			if (c.aHisto[i] < StuckKeyShare * nKeys)
+				continue;
+			const double fScore = aKeys[i].score(c.aHisto[i]);
+			if (fScore > fThreshold) {
+				Anomaly& a = aAnomalies[n++];
+				a.kind = AnomalyStuckKey;
+				a.pszMetric = "key";
+				a.nKey = i;
+				a.fValue = c.aHisto[i];
+				a.fBaseline = aKeys[i].fMean;
+				a.fScore = fScore;
+			}
+			// no second key can have the majority
+			break;
+		}
+	}
+	const int nDiff = c.nClicks > nLastClicks? c.nClicks - nLastClicks : nLastClicks - c.nClicks;
+	if (c.nClicks >= ConstantClicksMin && nDiff <= ConstantClicksTolerance * c.nClicks)
+		++nSameClicks;
+	else
+		nSameClicks = 0;
+	nLastClicks = c.nClicks;
+	if (nSameClicks >= ConstantClicksRun) {
+		Anomaly& a = aAnomalies[n++];
+		a.kind = AnomalyConstantClicks;
+		a.pszMetric = MetricNames[MetricClicks];
+		a.nKey = -1;
+		a.fValue = c.nClicks;
+		a.fBaseline = aMetrics[MetricClicks].fMean;
+		a.fScore = nSameClicks;
+	}
+	for (int i = 0; i < NumMetrics; ++i)
+		aMetrics[i].update(afValues[i], Alpha, fThreshold);
+	for (int i = 0; i < 256; ++i)
+		aKeys[i].update(c.aHisto[i], Alpha, fThreshold);
+	return n;
+}
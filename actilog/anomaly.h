@@ -0,0 +1,89 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include "counters.h"
+
+/// Exponentially weighted mean and variance of one series.
+struct Baseline {
+	double fMean;
+	double fVar;
+	UINT nSamples;
+	void update(double x, double fAlpha, double fClamp);
+	double deviation() const;
+	double score(double x) const { return (x - fMean) / deviation(); }
+};
+
+
+enum AnomalyKind {
+	AnomalySpike,
+	AnomalyDrop,
+	AnomalyStuckKey,
+	AnomalyConstantClicks,
+	NumAnomalyKinds
+};
+
+
+struct Anomaly {
+	AnomalyKind kind;
+	const char* pszMetric;
+	int nKey;
+	double fValue;
+	double fBaseline;
+	double fScore;
+};
+
+
+/// Online detector over the counters of closed intervals. Each metric
+/// has an EWMA baseline and every key its own one, so the state is of
+/// constant size. A value is a spike or a drop if its z-score exceeds
+/// the threshold; a stuck key is a key far above its own baseline that
+/// makes up most of the key presses; constant clicks are click counts
+/// that stay the same within 2% over ConstantClicksRun intervals, which
+/// no human manages. Values are learned clamped to the threshold, so a
+/// single outlier does not blind the baseline while a lasting change is
+/// still taken over after a while. Intervals without any input are
+/// breaks, not anomalies, and are neither scored nor learned from.
+/// Nothing is reported before WarmupIntervals active intervals.
+class AnomalyDetector {
+public:
+	static const double DefaultThreshold;
+	static const double Alpha;
+	static const UINT WarmupIntervals = 12;
+	static const int ConstantClicksRun = 6;
+	static const int MaxAnomalies = 8;
+	AnomalyDetector();
+	void setThreshold(double fThreshold) { this->fThreshold = fThreshold; }
+	int check(const Counters& c, Anomaly* aAnomalies);
+	static const char* name(AnomalyKind kind);
+
+private:
+	enum Metric {
+		MetricMouse,
+		MetricClicks,
+		MetricWheel,
+		MetricKeys,
+		NumMetrics
+	};
+	static const char* MetricNames[NumMetrics];
+	Baseline aMetrics[NumMetrics];
+	Baseline aKeys[256];
+	double fThreshold;
+	int nLastClicks;
+	int nSameClicks;
+};
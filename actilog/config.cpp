@@ -0,0 +1,135 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "config.h"
+#include <stdlib.h>
+#include <Shlwapi.h>
+
+#pragma comment(lib, "shlwapi.lib")
+
+const TCHAR* ConfigFile::Section = TEXT("actilog");
+
+
+ConfigFile::ConfigFile()
+	: hChange(INVALID_HANDLE_VALUE)
+	, nCurrent(0)
+	, bPending(false)
+{
+	szFilename[0] = 0;
+}
+
+
+ConfigFile::~ConfigFile()
+{
+	close();
+}
+
+
+bool ConfigFile::open(const TCHAR* pszFilename, const Settings& defaults)
+{
+	close();
+	// the profile functions look in the Windows directory for relative names
+	if (GetFullPathName(pszFilename, MAX_PATH, szFilename, NULL) == 0)
+		return false;
+	nCurrent = 0;
+	bPending = false;
+	if (!lastWrite(&ftLastWrite) || !read(defaults, aSettings[0]))
+		return false;
+	aSettings[1] = aSettings[0];
+	fromFile = aSettings[0];
+	// watch the directory; the notification does not tell which file
+	// changed, so poll() compares the time of the last write
+	TCHAR szDir[MAX_PATH];
+	_tcsncpy(szDir, szFilename, MAX_PATH);
+	PathRemoveFileSpec(szDir);
+	hChange = FindFirstChangeNotification(szDir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+	return hChange != INVALID_HANDLE_VALUE;
+}
+
+
+void ConfigFile::close()
+{
+	if (hChange != INVALID_HANDLE_VALUE)
+		FindCloseChangeNotification(hChange);
+	hChange = INVALID_HANDLE_VALUE;
+}
+
+
+bool ConfigFile::lastWrite(FILETIME* pft) const
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesEx(szFilename, GetFileExInfoStandard, &fad))
+		return false;
+	*pft = fad.ftLastWriteTime;
+	return true;
+}
+
+
+bool ConfigFile::read(const Settings& defaults, Settings& s) const
+{
+	s = defaults;
+	s.uInterval = GetPrivateProfileInt(Section, TEXT("interval"), defaults.uInterval, szFilename);
+	s.uMetricsPort = (USHORT)GetPrivateProfileInt(Section, TEXT("metrics-port"), defaults.uMetricsPort, szFilename);
+	s.bSelfStat = GetPrivateProfileInt(Section, TEXT("selfstat"), defaults.bSelfStat? 1 : 0, szFilename) != 0;
+	TCHAR szValue[MAX_PATH];
+	if (GetPrivateProfileString(Section, TEXT("dpi"), TEXT(""), szValue, MAX_PATH, szFilename) > 0)
+		s.fDPI = _tstof(szValue);
+	if (GetPrivateProfileString(Section, TEXT("output"), TEXT(""), szValue, MAX_PATH, szFilename) > 0)
+		_tcsncpy(s.szOutput, szValue, MAX_PATH);
+	return s.uInterval > 0 && s.fDPI > 0;
+}
+
+
+bool ConfigFile::poll(const Settings& running)
+{
+	// re-arm first so that a write during parsing is not missed
+	FindNextChangeNotification(hChange);
+	FILETIME ft;
+	if (!lastWrite(&ft) || CompareFileTime(&ft, &ftLastWrite) == 0)
+		return false;
+	ftLastWrite = ft;
+	Settings fresh;
+	if (!read(fromFile, fresh))
+		return false;
+	// a reload arriving before the last one was swapped in adds its
+	// changes to it
+	Settings& next = aSettings[nCurrent ^ 1];
+	if (!bPending)
+		next = running;
+	if (fresh.uInterval != fromFile.uInterval)
+		next.uInterval = fresh.uInterval;
+	if (fresh.fDPI != fromFile.fDPI)
+		next.fDPI = fresh.fDPI;
+	if (_tcscmp(fresh.szOutput, fromFile.szOutput) != 0)
+		_tcsncpy(next.szOutput, fresh.szOutput, MAX_PATH);
+	if (fresh.uMetricsPort != fromFile.uMetricsPort)
+		next.uMetricsPort = fresh.uMetricsPort;
+	if (fresh.bSelfStat != fromFile.bSelfStat)
+		next.bSelfStat = fresh.bSelfStat;
+	fromFile = fresh;
+	bPending = true;
+	return true;
+}
+
+
+bool ConfigFile::swap()
+{
+	if (!bPending)
+		return false;
+	nCurrent ^= 1;
+	bPending = false;
+	return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// The settings that can be changed while actilog is running.
+struct Settings {
+	UINT uInterval;
+	double fDPI;
+	TCHAR szOutput[MAX_PATH];
+	USHORT uMetricsPort;
+	bool bSelfStat;
+};
+
+
+/// An INI file with Settings in its [actilog] section, watched for changes.
+/// A reload is parsed into a spare copy and only published by swap(),
+/// which the caller invokes between two flushes; until then current()
+/// keeps returning the settings in force. Keys missing from the file
+/// keep the values the program is running with, and a reload only applies
+/// the keys whose value in the file has changed since the last read, so
+/// options given on the command line after --config stay in force until
+/// the file changes them.
+class ConfigFile {
+public:
+	static const TCHAR* Section;
+	ConfigFile();
+	~ConfigFile();
+	bool open(const TCHAR* pszFilename, const Settings& defaults);
+	void close();
+	bool isOpen() const { return hChange != INVALID_HANDLE_VALUE; }
+	HANDLE event() const { return hChange; }
+	bool poll(const Settings& running);
+	bool swap();
+	bool isPending() const { return bPending; }
+	const Settings* current() const { return &aSettings[nCurrent]; }
+	const TCHAR* filename() const { return szFilename; }
+
+private:
+	TCHAR szFilename[MAX_PATH];
+	HANDLE hChange;
+	FILETIME ftLastWrite;
+	Settings aSettings[2];
+	Settings fromFile;
+	int nCurrent;
+	bool bPending;
+	bool read(const Settings& defaults, Settings& s) const;
+	bool lastWrite(FILETIME* pft) const;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include "keyclass.h"
+#include "log.h"
+
+/// Counters collected over one interval. The hooks only ever touch the
+/// instance of the running base interval; coarser windows are built by
+/// adding up the closed intervals of the next finer one.
+struct Counters {
+	double fMouseDist;
+	double fMouseMeters;
+	int nClicks;
+	int nDoubleClicks;
+	int nWheel;
+	int nWarps;
+	double fWarpDist;
+	int aHisto[256];
+	int aKeyClasses[NumKeyClasses];
+	ULONGLONG ullFirstEventNs;
+	ULONGLONG ullLastEventNs;
+};
+
+
+inline void addCounters(Counters& dst, const Counters& src)
+{
+	dst.fMouseDist += src.fMouseDist;
+	dst.fMouseMeters += src.fMouseMeters;
+	dst.nClicks += src.nClicks;
+	dst.nDoubleClicks += src.nDoubleClicks;
+	dst.nWheel += src.nWheel;
+	dst.nWarps += src.nWarps;
+	dst.fWarpDist += src.fWarpDist;
+	for (int i = 0; i < 256; ++i)
+		dst.aHisto[i] += src.aHisto[i];
+	for (int i = 0; i < NumKeyClasses; ++i)
+		dst.aKeyClasses[i] += src.aKeyClasses[i];
+	if (src.ullFirstEventNs != 0 && (dst.ullFirstEventNs == 0 || src.ullFirstEventNs < dst.ullFirstEventNs))
+		dst.ullFirstEventNs = src.ullFirstEventNs;
+	if (src.ullLastEventNs > dst.ullLastEventNs)
+		dst.ullLastEventNs = src.ullLastEventNs;
+}
+
+
+inline int keyPresses(const Counters& c)
+{
+	// only one of the two is ever filled
+	int n = 0;
+	for (int i = 0; i < 256; ++i)
+		n += c.aHisto[i];
+	for (int i = 0; i < NumKeyClasses; ++i)
+		n += c.aKeyClasses[i];
+	return n;
+}
+
+
+/// An aggregation window with its own output. windows[0] is the base
+/// interval set by --interval; every further window is a multiple of the
+/// one before and is fed from it when that one closes.
+struct Window {
+	UINT uSeconds;
+	Logger* pLogger;
+	Counters counters;
+	ULONGLONG ullStartNs;
+};
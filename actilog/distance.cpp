@@ -0,0 +1,86 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "distance.h"
+#include <stdlib.h>
+#include <Shlwapi.h>
+
+#pragma comment(lib, "shlwapi.lib")
+
+
+DeviceDistance::DeviceDistance()
+	: nProfiles(0)
+	, fDefaultDPI(0)
+	, nDevices(0)
+{
+	for (int i = 0; i < DeviceTable::MaxDevices; ++i) {
+		anProfiles[i] = Unresolved;
+		afCounts[i] = 0;
+		afCompleted[i] = 0;
+	}
+}
+
+
+bool DeviceDistance::addProfile(const TCHAR* pszSpec)
+{
+	// "match=dpi"; split in place, the spec comes from the command line
+	if (nProfiles >= MaxProfiles)
+		return false;
+	TCHAR* pszEquals = (TCHAR*)_tcschr(pszSpec, TEXT('='));
+	if (pszEquals == NULL || pszEquals == pszSpec)
+		return false;
+	const double fDPI = _tstof(pszEquals + 1);
+	if (fDPI <= 0)
+		return false;
+	*pszEquals = 0;
+	apszMatch[nProfiles] = pszSpec;
+	afProfileDPI[nProfiles] = fDPI;
+	++nProfiles;
+	return true;
+}
+
+
+double DeviceDistance::add(int nDevice, const TCHAR* pszName, double fCounts)
+{
+	if (anProfiles[nDevice] == Unresolved) {
+		anProfiles[nDevice] = -1;
+		for (int i = 0; i < nProfiles && anProfiles[nDevice] < 0; ++i)
+			if (StrStrI(pszName, apszMatch[i]) != NULL)
+				anProfiles[nDevice] = i;
+		if (nDevice >= nDevices)
+			nDevices = nDevice + 1;
+	}
+	afCounts[nDevice] += fCounts;
+	return toMeters(fCounts, dpi(nDevice));
+}
+
+
+void DeviceDistance::resetDevice(int nDevice)
+{
+	// the number goes to another device, which may have another profile;
+	// what the old one counted has been written out already
+	anProfiles[nDevice] = Unresolved;
+	afCompleted[nDevice] = 0;
+}
+
+
+void DeviceDistance::closeInterval()
+{
+	for (int i = 0; i < nDevices; ++i) {
+		afCompleted[i] = afCounts[i];
+		afCounts[i] = 0;
+	}
+}
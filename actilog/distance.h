@@ -0,0 +1,53 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include "rawinput.h"
+
+/// Mouse distance per input device from raw motion counts. Each device
+/// gets the resolution of the first calibration profile whose match string
+/// occurs in its device name, or the default resolution (--dpi) if none
+/// does. Raw counts are taken before pointer acceleration, so there is no
+/// acceleration curve to undo, and devices of different resolutions add
+/// up to one correct total in meters.
+class DeviceDistance {
+public:
+	static const int MaxProfiles = 16;
+	DeviceDistance();
+	bool addProfile(const TCHAR* pszSpec);
+	void setDefaultDPI(double fDPI) { fDefaultDPI = fDPI; }
+	double add(int nDevice, const TCHAR* pszName, double fCounts);
+	void closeInterval();
+	void resetDevice(int nDevice);
+	int count() const { return nDevices; }
+	double completedCounts(int i) const { return afCompleted[i]; }
+	double dpi(int i) const { return anProfiles[i] < 0? fDefaultDPI : afProfileDPI[anProfiles[i]]; }
+	static double toMeters(double fCounts, double fDPI) { return fCounts / fDPI * 2.54 / 100; }
+
+private:
+	static const int Unresolved = -2;
+	const TCHAR* apszMatch[MaxProfiles];
+	double afProfileDPI[MaxProfiles];
+	int nProfiles;
+	double fDefaultDPI;
+	int anProfiles[DeviceTable::MaxDevices];
+	double afCounts[DeviceTable::MaxDevices];
+	double afCompleted[DeviceTable::MaxDevices];
+	int nDevices;
+};
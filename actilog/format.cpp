@@ -0,0 +1,189 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "format.h"
+#include "textbuf.h"
+#include "gzipreader.h"
+#include <stdlib.h>
+#include <string.h>
+
+// field names shared by both structured modes, in their order; the keys
+// come between the fields up to "wheel" and those added later, so that
+// new fields only ever appear at the end of a record
+static const char* Fields[] = {
+	"kind", "start", "end", "secs", "first_event_ns", "last_event_ns",
+	"mouse_px", "mouse_m", "clicks", "double_clicks", "wheel",
+	"warps", "warp_px"
+};
+static const int NumFields = sizeof(Fields) / sizeof(Fields[0]);
+static const int NumLeadingFields = 11;
+
+
+bool parseFormat(const TCHAR* pszFormat, OutputFormat* pFormat)
+{
+	if (_tcsicmp(pszFormat, TEXT("text")) == 0)
+		*pFormat = FormatText;
+	else if (_tcsicmp(pszFormat, TEXT("ndjson")) == 0)
+		*pFormat = FormatNdjson;
+	else if (_tcsicmp(pszFormat, TEXT("csv")) == 0)
+		*pFormat = FormatCsv;
+	else
+		return false;
+	return true;
+}
+
+
+static bool fileStartsWith(const TCHAR* pszFilename, const char* pData, size_t cb)
+{
+	HANDLE h = CreateFile(pszFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+	char aHead[TextBuffer::Capacity];
+	DWORD cbRead = 0;
+	if (ReadFile(h, aHead, (DWORD)cb, &cbRead, NULL) && GzipReader::isGzip(aHead, cbRead)) {
+		// a compressed file is inflated just far enough to compare
+		SetFilePointer(h, 0, NULL, FILE_BEGIN);
+		cbRead = 0;
+		BYTE* pBuffers = (BYTE*)malloc(GzipReader::InputSize + GzipReader::WindowSize);
+		if (pBuffers != NULL) {
+			GzipReader gzip;
+			gzip.attach(h, pBuffers, pBuffers + GzipReader::InputSize);
+			DWORD cbChunk;
+			while (cbRead < cb && (cbChunk = gzip.read((BYTE*)aHead + cbRead, (DWORD)cb - cbRead)) > 0)
+				cbRead += cbChunk;
+			free(pBuffers);
+		}
+	}
+	CloseHandle(h);
+	return cbRead == cb && memcmp(aHead, pData, cb) == 0;
+}
+
+
+bool writeCsvHeader(Logger& out, bool bKeyClasses)
+{
+	// rows appended under a header with other columns would be read with
+	// the wrong names, so such a file is refused instead
+	TextBuffer buf;
+	for (int i = 0; i < NumLeadingFields; ++i) {
+		buf.append(Fields[i]);
+		buf.append(',');
+	}
+	for (int i = 0; bKeyClasses && i < NumKeyClasses; ++i) {
+		buf.append("keys_");
+		buf.append(KeyClassTable::name(i));
+		buf.append(',');
+	}
+	for (int i = 0; !bKeyClasses && i < 256; ++i) {
+		buf.append("key_");
+		buf.appendUInt(i);
+		buf.append(',');
+	}
+	for (int i = NumLeadingFields; i < NumFields; ++i) {
+		buf.append(Fields[i]);
+		buf.append(i < NumFields - 1? ',' : '\r');
+	}
+	buf.append('\n');
+	if (out.offset() == 0) {
+		out.writeRecord(buf.data(), buf.size());
+		return true;
+	}
+	return out.isConsole() || fileStartsWith(out.filename(), buf.data(), buf.size());
+}
+
+
+static void beginField(TextBuffer& buf, bool bJson, int nField)
+{
+	if (bJson) {
+		buf.append(nField == 0? '{' : ',');
+		buf.appendQuoted(Fields[nField]);
+		buf.append(':');
+	}
+	else if (nField > 0) {
+		buf.append(',');
+	}
+}
+
+
+void writeRecord(Logger& out, OutputFormat format, const char* pszKind, ULONGLONG ullStartUtc, ULONGLONG ullEndUtc, const Counters& c, double fMouseMeters, const int* aKeyClasses)
+{
+	// the buffer lives on the stack, so a record costs no allocation;
+	// 256 keys of at most 11 characters each fit easily
+	TextBuffer buf;
+	const bool bJson = format == FormatNdjson;
+	const char* pszQuote = bJson? "\"" : "";
+	int nField = 0;
+	beginField(buf, bJson, nField++);
+	if (bJson)
+		buf.appendQuoted(pszKind);
+	else
+		buf.append(pszKind);
+	beginField(buf, bJson, nField++);
+	buf.append(pszQuote);
+	buf.appendUtc(ullStartUtc);
+	buf.append(pszQuote);
+	beginField(buf, bJson, nField++);
+	buf.append(pszQuote);
+	buf.appendUtc(ullEndUtc);
+	buf.append(pszQuote);
+	beginField(buf, bJson, nField++);
+	buf.appendFixed(1e-7 * (double)(ullEndUtc - ullStartUtc), 3);
+	beginField(buf, bJson, nField++);
+	buf.appendUInt(c.ullFirstEventNs);
+	beginField(buf, bJson, nField++);
+	buf.appendUInt(c.ullLastEventNs);
+	beginField(buf, bJson, nField++);
+	buf.appendFixed(c.fMouseDist, 3);
+	beginField(buf, bJson, nField++);
+	buf.appendFixed(fMouseMeters, 6);
+	beginField(buf, bJson, nField++);
+	buf.appendInt(c.nClicks);
+	beginField(buf, bJson, nField++);
+	buf.appendInt(c.nDoubleClicks);
+	beginField(buf, bJson, nField++);
+	buf.appendInt(c.nWheel);
+	if (aKeyClasses) {
+		buf.append(bJson? ",\"key_classes\":{" : ",");
+		for (int i = 0; i < NumKeyClasses; ++i) {
+			if (i > 0)
+				buf.append(',');
+			if (bJson) {
+				buf.appendQuoted(KeyClassTable::name(i));
+				buf.append(':');
+			}
+			buf.appendInt(aKeyClasses[i]);
+		}
+		if (bJson)
+			buf.append('}');
+	}
+	else {
+		buf.append(bJson? ",\"keys\":[" : ",");
+		for (int i = 0; i < 256; ++i) {
+			if (i > 0)
+				buf.append(',');
+			buf.appendInt(c.aHisto[i]);
+		}
+		if (bJson)
+			buf.append(']');
+	}
+	beginField(buf, bJson, nField++);
+	buf.appendInt(c.nWarps);
+	beginField(buf, bJson, nField++);
+	buf.appendFixed(c.fWarpDist, 3);
+	if (bJson)
+		buf.append('}');
+	buf.append("\r\n");
+	out.writeRecord(buf.data(), buf.size());
+}
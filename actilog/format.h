@@ -0,0 +1,38 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include "log.h"
+#include "counters.h"
+
+/// Output modes selected by --format. The structured modes write one
+/// self-contained line per interval that always carries the same fields
+/// in the same order, whether they are zero or not. In key class mode the
+/// per-key counts are replaced by one field per KeyClass. Fields added
+/// later go after the keys, so that older readers keep working; a CSV
+/// file with a different header is not appended to.
+enum OutputFormat {
+	FormatText,
+	FormatNdjson,
+	FormatCsv
+};
+
+bool parseFormat(const TCHAR* pszFormat, OutputFormat* pFormat);
+bool writeCsvHeader(Logger& out, bool bKeyClasses);
+void writeRecord(Logger& out, OutputFormat format, const char* pszKind, ULONGLONG ullStartUtc, ULONGLONG ullEndUtc, const Counters& c, double fMouseMeters, const int* aKeyClasses);
@@ -0,0 +1,224 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <winsock2.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+
+MetricsServer::MetricsServer()
+	: sockListen(INVALID_SOCKET)
+	, hEvent(NULL)
+	, bStarted(false)
+	, pCurrent(NULL)
+{
+	for (int i = 0; i < MaxClients; ++i) {
+		aClients[i].sock = INVALID_SOCKET;
+		aClients[i].pResponse = NULL;
+	}
+}
+
+
+MetricsServer::~MetricsServer()
+{
+	close();
+}
+
+
+bool MetricsServer::open(USHORT uPort)
+{
+	close();
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return false;
+	bStarted = true;
+	sockListen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (sockListen == INVALID_SOCKET) {
+		close();
+		return false;
+	}
+	sockaddr_in addr;
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(uPort);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	hEvent = WSACreateEvent();
+	if (bind(sockListen, (const sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+		|| listen(sockListen, SOMAXCONN) == SOCKET_ERROR
+		|| hEvent == WSA_INVALID_EVENT
+		|| WSAEventSelect(sockListen, hEvent, FD_ACCEPT) == SOCKET_ERROR) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+void MetricsServer::close()
+{
+	for (int i = 0; i < MaxClients; ++i)
+		drop(aClients[i]);
+	if (sockListen != INVALID_SOCKET)
+		closesocket(sockListen);
+	sockListen = INVALID_SOCKET;
+	if (hEvent)
+		WSACloseEvent(hEvent);
+	hEvent = NULL;
+	release(pCurrent);
+	pCurrent = NULL;
+	if (bStarted)
+		WSACleanup();
+	bStarted = false;
+}
+
+
+void MetricsServer::release(Response* pResponse)
+{
+	if (pResponse && --pResponse->nRefs == 0) {
+		free(pResponse->pData);
+		delete pResponse;
+	}
+}
+
+
+void MetricsServer::publish(const char* pBody, size_t cbBody)
+{
+	// build the complete HTTP response once; clients still sending the
+	// previous one keep it alive through their reference
+	static const char* Header =
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+		"Content-Length: %u\r\n"
+		"Connection: close\r\n"
+		"\r\n";
+	char szHeader[256];
+	const int cbHeader = _snprintf(szHeader, sizeof(szHeader), Header, (unsigned)cbBody);
+	Response* pResponse = new Response;
+	pResponse->pData = (char*)malloc(cbHeader + cbBody);
+	if (pResponse->pData == NULL) {
+		delete pResponse;
+		return;
+	}
+	memcpy(pResponse->pData, szHeader, cbHeader);
+	memcpy(pResponse->pData + cbHeader, pBody, cbBody);
+	pResponse->cbData = cbHeader + cbBody;
+	pResponse->nRefs = 1;
+	release(pCurrent);
+	pCurrent = pResponse;
+}
+
+
+void MetricsServer::accept()
+{
+	for (;;) {
+		const SOCKET sock = ::accept(sockListen, NULL, NULL);
+		if (sock == INVALID_SOCKET)
+			return;
+		Client* pClient = NULL;
+		for (int i = 0; i < MaxClients && pClient == NULL; ++i)
+			if (aClients[i].sock == INVALID_SOCKET)
+				pClient = &aClients[i];
+		if (pClient == NULL || WSAEventSelect(sock, hEvent, FD_READ | FD_WRITE | FD_CLOSE) == SOCKET_ERROR) {
+			closesocket(sock);
+			continue;
+		}
+		pClient->sock = sock;
+		pClient->cbRequest = 0;
+		pClient->pResponse = NULL;
+		pClient->cbSent = 0;
+	}
+}
+
+
+void MetricsServer::drop(Client& c)
+{
+	if (c.sock != INVALID_SOCKET) {
+		shutdown(c.sock, SD_BOTH);
+		closesocket(c.sock);
+	}
+	c.sock = INVALID_SOCKET;
+	release(c.pResponse);
+	c.pResponse = NULL;
+}
+
+
+void MetricsServer::receive(Client& c)
+{
+	// read until the end of the request header; its content is ignored
+	for (;;) {
+		if (c.cbRequest == sizeof(c.aRequest) - 1) {
+			drop(c);
+			return;
+		}
+		const int cb = recv(c.sock, c.aRequest + c.cbRequest, (int)(sizeof(c.aRequest) - 1 - c.cbRequest), 0);
+		if (cb == 0 || (cb == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK)) {
+			drop(c);
+			return;
+		}
+		if (cb == SOCKET_ERROR)
+			return;
+		c.cbRequest += cb;
+		c.aRequest[c.cbRequest] = 0;
+		if (strstr(c.aRequest, "\r\n\r\n") != NULL && pCurrent != NULL) {
+			c.pResponse = pCurrent;
+			++pCurrent->nRefs;
+			c.cbSent = 0;
+			transmit(c);
+			return;
+		}
+	}
+}
+
+
+void MetricsServer::transmit(Client& c)
+{
+	while (c.cbSent < c.pResponse->cbData) {
+		const int cb = send(c.sock, c.pResponse->pData + c.cbSent, (int)(c.pResponse->cbData - c.cbSent), 0);
+		if (cb == SOCKET_ERROR) {
+			if (WSAGetLastError() != WSAEWOULDBLOCK)
+				drop(c);
+			// otherwise FD_WRITE tells when to go on
+			return;
+		}
+		c.cbSent += cb;
+	}
+	drop(c);
+}
+
+
+void MetricsServer::process()
+{
+	WSANETWORKEVENTS ne;
+	// this call also resets the shared event
+	if (WSAEnumNetworkEvents(sockListen, hEvent, &ne) == 0 && (ne.lNetworkEvents & FD_ACCEPT))
+		accept();
+	for (int i = 0; i < MaxClients; ++i) {
+		Client& c = aClients[i];
+		if (c.sock == INVALID_SOCKET || WSAEnumNetworkEvents(c.sock, NULL, &ne) != 0)
+			continue;
+		if (c.pResponse != NULL) {
+			if (ne.lNetworkEvents & (FD_WRITE | FD_CLOSE))
+				transmit(c);
+		}
+		else if (ne.lNetworkEvents & (FD_READ | FD_CLOSE)) {
+			receive(c);
+		}
+	}
+}
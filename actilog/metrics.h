@@ -0,0 +1,61 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+
+/// Minimal single-threaded HTTP endpoint on 127.0.0.1 that answers every
+/// request with the response last handed to publish(). All sockets are
+/// non-blocking and signal one event, which the caller waits on in its
+/// message loop and then calls process(). A scrape therefore only costs
+/// a send() of a prepared buffer and never runs on the hook path.
+class MetricsServer {
+public:
+	static const int MaxClients = 8;
+	MetricsServer();
+	~MetricsServer();
+	bool open(USHORT uPort);
+	void close();
+	bool isOpen() const { return hEvent != NULL; }
+	HANDLE event() const { return hEvent; }
+	void process();
+	void publish(const char* pBody, size_t cbBody);
+
+private:
+	struct Response {
+		char* pData;
+		size_t cbData;
+		int nRefs;
+	};
+	struct Client {
+		UINT_PTR sock;
+		char aRequest[1024];
+		size_t cbRequest;
+		Response* pResponse;
+		size_t cbSent;
+	};
+	UINT_PTR sockListen;
+	HANDLE hEvent;
+	bool bStarted;
+	Client aClients[MaxClients];
+	Response* pCurrent;
+	void accept();
+	void receive(Client& c);
+	void transmit(Client& c);
+	void drop(Client& c);
+	static void release(Response* pResponse);
+};
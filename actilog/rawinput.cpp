@@ -0,0 +1,247 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "rawinput.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+static const TCHAR* WindowClass = TEXT("actilog raw input");
+
+RawInput* RawInput::pInstance = NULL;
+
+
+DeviceTable::DeviceTable()
+	: nDevices(0)
+	, nLast(0)
+	, bFullReported(false)
+{
+	for (int i = 0; i < MaxDevices; ++i) {
+		ahDevices[i] = NULL;
+		aState[i] = SlotFree;
+	}
+}
+
+
+int DeviceTable::indexOf(HANDLE hDevice)
+{
+	// a handful of devices at most, and consecutive events mostly come
+	// from the same one
+	if (nLast < nDevices && ahDevices[nLast] == hDevice)
+		return nLast;
+	int iFree = -1;
+	for (int i = 0; i < nDevices; ++i) {
+		if (ahDevices[i] == hDevice) {
+			nLast = i;
+			return i;
+		}
+		if (iFree < 0 && aState[i] == SlotFree)
+			iFree = i;
+	}
+	if (iFree < 0 && nDevices == MaxDevices) {
+		if (!bFullReported) {
+			fprintf(stderr, "Warning: more than %d input devices, the input of the others is not counted per device\n", MaxDevices);
+			bFullReported = true;
+		}
+		return -1;
+	}
+	const int i = iFree >= 0? iFree : nDevices++;
+	ahDevices[i] = hDevice;
+	aState[i] = SlotUsed;
+	UINT cchName = MAX_PATH;
+	if (GetRawInputDeviceInfo(hDevice, RIDI_DEVICENAME, aszNames[i], &cchName) == (UINT)-1)
+		aszNames[i][0] = 0;
+	alLastX[i] = 0;
+	alLastY[i] = 0;
+	abAbsolute[i] = false;
+	nLast = i;
+	return i;
+}
+
+
+void DeviceTable::remove(HANDLE hDevice)
+{
+	// the slot keeps its name until it is given to another device, since
+	// the interval it last counted in has not been written yet
+	for (int i = 0; i < nDevices; ++i) {
+		if (ahDevices[i] == hDevice && aState[i] == SlotUsed) {
+			ahDevices[i] = NULL;
+			aState[i] = SlotRemoved;
+			return;
+		}
+	}
+}
+
+
+void DeviceTable::closeInterval()
+{
+	for (int i = 0; i < nDevices; ++i)
+		if (aState[i] == SlotRemoved)
+			aState[i] = SlotRetired;
+}
+
+
+void DeviceTable::release(int i)
+{
+	if (aState[i] == SlotRetired)
+		aState[i] = SlotFree;
+}
+
+
+double DeviceTable::motion(int i, const RAWMOUSE& m)
+{
+	// tablets and remote sessions report absolute positions from 0 to
+	// 65535 across the primary monitor or the whole virtual desktop;
+	// their moves are measured in pixels, as there are no counts
+	if (m.usFlags & MOUSE_MOVE_ABSOLUTE) {
+		double fDist = 0;
+		if (abAbsolute[i]) {
+			const bool bVirtual = (m.usFlags & MOUSE_VIRTUAL_DESKTOP) != 0;
+			const double fScaleX = GetSystemMetrics(bVirtual? SM_CXVIRTUALSCREEN : SM_CXSCREEN) / 65535.0;
+			const double fScaleY = GetSystemMetrics(bVirtual? SM_CYVIRTUALSCREEN : SM_CYSCREEN) / 65535.0;
+			fDist = sqrt(squared(fScaleX * (m.lLastX - alLastX[i])) + squared(fScaleY * (m.lLastY - alLastY[i])));
+		}
+		alLastX[i] = m.lLastX;
+		alLastY[i] = m.lLastY;
+		abAbsolute[i] = true;
+		return fDist;
+	}
+	if (m.lLastX == 0 && m.lLastY == 0)
+		return 0;
+	return sqrt((double)squared(m.lLastX) + (double)squared(m.lLastY));
+}
+
+
+RawInput::RawInput()
+	: hWnd(NULL)
+	, pfnInput(NULL)
+{
+	// ...
+}
+
+
+RawInput::~RawInput()
+{
+	close();
+}
+
+
+bool RawInput::open(InputProc pfnInput)
+{
+	if (hWnd != NULL)
+		return true;
+	this->pfnInput = pfnInput;
+	// raw input needs a window; a message-only one is enough and
+	// RIDEV_INPUTSINK delivers input even though it never has the focus;
+	// RIDEV_DEVNOTIFY (0x2000) reports devices being plugged and unplugged
+	WNDCLASS wc;
+	ZeroMemory(&wc, sizeof(wc));
+	wc.lpfnWndProc = WndProc;
+	wc.hInstance = GetModuleHandle(NULL);
+	wc.lpszClassName = WindowClass;
+	RegisterClass(&wc);
+	hWnd = CreateWindow(WindowClass, NULL, 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, wc.hInstance, NULL);
+	if (hWnd == NULL)
+		return false;
+	pInstance = this;
+	RAWINPUTDEVICE aRid[2];
+	aRid[0].usUsagePage = 0x01;	// generic desktop
+	aRid[0].usUsage = 0x02;		// mouse
+	aRid[0].dwFlags = RIDEV_INPUTSINK | 0x2000 /* RIDEV_DEVNOTIFY */;
+	aRid[0].hwndTarget = hWnd;
+	aRid[1].usUsagePage = 0x01;
+	aRid[1].usUsage = 0x06;		// keyboard
+	aRid[1].dwFlags = RIDEV_INPUTSINK | 0x2000 /* RIDEV_DEVNOTIFY */;
+	aRid[1].hwndTarget = hWnd;
+	if (!RegisterRawInputDevices(aRid, 2, sizeof(RAWINPUTDEVICE))) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+void RawInput::close()
+{
+	if (hWnd == NULL)
+		return;
+	RAWINPUTDEVICE aRid[2];
+	for (int i = 0; i < 2; ++i) {
+		aRid[i].usUsagePage = 0x01;
+		aRid[i].usUsage = i == 0? 0x02 : 0x06;
+		aRid[i].dwFlags = RIDEV_REMOVE;
+		aRid[i].hwndTarget = NULL;
+	}
+	RegisterRawInputDevices(aRid, 2, sizeof(RAWINPUTDEVICE));
+	DestroyWindow(hWnd);
+	hWnd = NULL;
+	pInstance = NULL;
+}
+
+
+void RawInput::input(HRAWINPUT hInput)
+{
+	RAWINPUT ri;
+	UINT cbSize = sizeof(ri);
+	if (GetRawInputData(hInput, RID_INPUT, &ri, &cbSize, sizeof(RAWINPUTHEADER)) == (UINT)-1)
+		return;
+	if (ri.header.hDevice == NULL)
+		return;
+	const int nDevice = table.indexOf(ri.header.hDevice);
+	if (nDevice < 0)
+		return;
+	const double fMotion = ri.header.dwType == RIM_TYPEMOUSE? table.motion(nDevice, ri.data.mouse) : 0;
+	pfnInput(nDevice, ri, fMotion);
+}
+
+
+void RawInput::deviceChange(WPARAM wParam, HANDLE hDevice)
+{
+	// arrivals need nothing; a device gets its slot with its first input
+	if (wParam == 2 /* GIDC_REMOVAL */)
+		table.remove(hDevice);
+}
+
+
+LRESULT CALLBACK RawInput::WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
+{
+	if (uMsg == WM_INPUT && pInstance != NULL)
+		pInstance->input((HRAWINPUT)lParam);
+	else if (uMsg == 0x00FE /* WM_INPUT_DEVICE_CHANGE */ && pInstance != NULL)
+		pInstance->deviceChange(wParam, (HANDLE)lParam);
+	return DefWindowProc(hWnd, uMsg, wParam, lParam);
+}
+
+
+void RawInput::listDevices()
+{
+	UINT nCount = 0;
+	GetRawInputDeviceList(NULL, &nCount, sizeof(RAWINPUTDEVICELIST));
+	if (nCount == 0)
+		return;
+	RAWINPUTDEVICELIST* pList = (RAWINPUTDEVICELIST*)malloc(nCount * sizeof(RAWINPUTDEVICELIST));
+	nCount = GetRawInputDeviceList(pList, &nCount, sizeof(RAWINPUTDEVICELIST));
+	for (UINT i = 0; i < nCount && nCount != (UINT)-1; ++i) {
+		if (pList[i].dwType != RIM_TYPEMOUSE && pList[i].dwType != RIM_TYPEKEYBOARD)
+			continue;
+		TCHAR szName[MAX_PATH];
+		UINT cchName = MAX_PATH;
+		if (GetRawInputDeviceInfo(pList[i].hDevice, RIDI_DEVICENAME, szName, &cchName) != (UINT)-1)
+			printf("%-8s %s\n", pList[i].dwType == RIM_TYPEMOUSE? "mouse" : "keyboard", szName);
+	}
+	free(pList);
+}
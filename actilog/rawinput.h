@@ -0,0 +1,91 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// Input devices seen through Raw Input, numbered densely in the order in
+/// which they first send input, so that per-device state can be kept in
+/// plain arrays indexed by that number. The number of a device that has
+/// been unplugged is given to the next new device, but only after the
+/// interval in which it was unplugged has been written out: remove()
+/// marks the slot, closeInterval() retires it, and the owner of the
+/// per-device state resets it and calls release() once it is written.
+/// There is room for as many devices as there can be seats. motion() is
+/// in device counts for mice, but in screen pixels for devices that report
+/// absolute positions (tablets, remote desktop sessions); isAbsolute()
+/// tells which.
+class DeviceTable {
+public:
+	static const int MaxDevices = 256;
+	DeviceTable();
+	int indexOf(HANDLE hDevice);
+	void remove(HANDLE hDevice);
+	void closeInterval();
+	bool isRetired(int i) const { return aState[i] == SlotRetired; }
+	void release(int i);
+	int count() const { return nDevices; }
+	const TCHAR* name(int i) const { return aszNames[i]; }
+	bool isAbsolute(int i) const { return abAbsolute[i]; }
+	double motion(int i, const RAWMOUSE& m);
+
+private:
+	enum SlotState {
+		SlotFree,
+		SlotUsed,
+		SlotRemoved,
+		SlotRetired
+	};
+	HANDLE ahDevices[MaxDevices];
+	BYTE aState[MaxDevices];
+	TCHAR aszNames[MaxDevices][MAX_PATH];
+	LONG alLastX[MaxDevices];
+	LONG alLastY[MaxDevices];
+	bool abAbsolute[MaxDevices];
+	int nDevices;
+	int nLast;
+	bool bFullReported;
+};
+
+
+/// Receives the raw input of all mice and keyboards through a message-only
+/// window, even while another application has the focus. Unlike the
+/// low-level hooks, raw input tells which device an event came from, and
+/// mouse motion arrives as device counts before pointer acceleration.
+/// Input injected by software has no device and is dropped. Devices
+/// that are unplugged are taken out of the table.
+class RawInput {
+public:
+	typedef void (*InputProc)(int nDevice, const RAWINPUT& ri, double fMotion);
+	RawInput();
+	~RawInput();
+	bool open(InputProc pfnInput);
+	void close();
+	bool isOpen() const { return hWnd != NULL; }
+	DeviceTable& devices() { return table; }
+	static void listDevices();
+
+private:
+	HWND hWnd;
+	InputProc pfnInput;
+	DeviceTable table;
+	static RawInput* pInstance;
+	void input(HRAWINPUT hInput);
+	void deviceChange(WPARAM wParam, HANDLE hDevice);
+	static LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+};
@@ -0,0 +1,152 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "seats.h"
+#include "clock.h"
+#include "events.h"
+#include <stdio.h>
+#include <malloc.h>
+#include <Shlwapi.h>
+
+#pragma comment(lib, "shlwapi.lib")
+
+
+SeatTable::SeatTable()
+	: aSeats(NULL)
+	, nSeats(0)
+	, bKeyClasses(false)
+{
+	for (int i = 0; i < DeviceTable::MaxDevices; ++i)
+		anSeats[i] = Unresolved;
+}
+
+
+SeatTable::~SeatTable()
+{
+	close();
+}
+
+
+bool SeatTable::add(const TCHAR* pszSpec)
+{
+	// "match[,file]"; parsed in open()
+	if (nSeats >= MaxSeats || pszSpec[0] == 0 || pszSpec[0] == TEXT(','))
+		return false;
+	apszSpecs[nSeats++] = pszSpec;
+	return true;
+}
+
+
+bool SeatTable::open(bool bOverwrite, UINT nIndexEvery, bool bCompress, bool bKeyClasses)
+{
+	if (nSeats == 0)
+		return true;
+	this->bKeyClasses = bKeyClasses;
+	aSeats = (Seat*)_aligned_malloc(nSeats * sizeof(Seat), __alignof(Seat));
+	if (aSeats == NULL) {
+		fprintf(stderr, "Fatal error: out of memory\n");
+		return false;
+	}
+	ZeroMemory(aSeats, nSeats * sizeof(Seat));
+	for (int i = 0; i < nSeats; ++i) {
+		Seat& seat = aSeats[i];
+		// split "match,file" in place; the spec comes from the command line
+		TCHAR* pszComma = (TCHAR*)_tcschr(apszSpecs[i], TEXT(','));
+		if (pszComma)
+			*pszComma = 0;
+		seat.pszMatch = apszSpecs[i];
+		seat.window.pLogger = new Logger;
+		if (pszComma)
+			seat.window.pLogger->setFilename(pszComma + 1);
+		seat.window.pLogger->setIndex(nIndexEvery);
+		seat.window.pLogger->setCompression(bCompress);
+		if (!seat.window.pLogger->open(bOverwrite)) {
+			fprintf(stderr, "Fatal error: cannot create file '%s'\n", seat.window.pLogger->filename());
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void SeatTable::close()
+{
+	if (aSeats == NULL)
+		return;
+	for (int i = 0; i < nSeats; ++i) {
+		if (aSeats[i].window.pLogger) {
+			aSeats[i].window.pLogger->close();
+			delete aSeats[i].window.pLogger;
+		}
+	}
+	_aligned_free(aSeats);
+	aSeats = NULL;
+}
+
+
+void SeatTable::closeInterval()
+{
+	for (int i = 0; i < nSeats; ++i) {
+		aSeats[i].completed = aSeats[i].window.counters;
+		SecureZeroMemory(&aSeats[i].window.counters, sizeof(Counters));
+	}
+}
+
+
+int SeatTable::seatOf(const TCHAR* pszName) const
+{
+	for (int i = 0; i < nSeats; ++i)
+		if (StrStrI(pszName, aSeats[i].pszMatch) != NULL)
+			return i;
+	return -1;
+}
+
+
+void SeatTable::input(int nDevice, const TCHAR* pszName, const RAWINPUT& ri, double fMotion, double fMeters)
+{
+	if (aSeats == NULL)
+		return;
+	if (anSeats[nDevice] == Unresolved)
+		anSeats[nDevice] = seatOf(pszName);
+	if (anSeats[nDevice] < 0)
+		return;
+	Counters& c = aSeats[anSeats[nDevice]].window.counters;
+	const ULONGLONG ullNow = Clock::now();
+	if (c.ullFirstEventNs == 0)
+		c.ullFirstEventNs = ullNow;
+	c.ullLastEventNs = ullNow;
+	if (ri.header.dwType == RIM_TYPEMOUSE) {
+		const RAWMOUSE& m = ri.data.mouse;
+		c.fMouseDist += fMotion;
+		c.fMouseMeters += fMeters;
+		const USHORT usButtonsUp = RI_MOUSE_LEFT_BUTTON_UP | RI_MOUSE_RIGHT_BUTTON_UP | RI_MOUSE_MIDDLE_BUTTON_UP | RI_MOUSE_BUTTON_4_UP | RI_MOUSE_BUTTON_5_UP;
+		for (USHORT usFlags = m.usButtonFlags & usButtonsUp; usFlags != 0; usFlags &= usFlags - 1)
+			++c.nClicks;
+		if (m.usButtonFlags & (RI_MOUSE_WHEEL | 0x0800 /* RI_MOUSE_HWHEEL */))
+			++c.nWheel;
+	}
+	else if (ri.header.dwType == RIM_TYPEKEYBOARD) {
+		// counted by the same table as the keyboard hook, so that Alt and
+		// F10 (WM_SYSKEYUP) do not count here either
+		const RAWKEYBOARD& k = ri.data.keyboard;
+		if (EventTable::keyboard(k.Message).slot == SlotKeys && k.VKey < 256) {
+			if (bKeyClasses)
+				++c.aKeyClasses[KeyClassTable::classOf(k.VKey)];
+			else
+				++c.aHisto[k.VKey];
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include "counters.h"
+#include "rawinput.h"
+
+/// A group of input devices whose input is counted separately, with an
+/// output of its own. Seats are laid out back to back in one block and
+/// aligned to cache lines, so no two seats ever share one.
+__declspec(align(64)) struct Seat {
+	Window window;
+	Counters completed;
+	const TCHAR* pszMatch;
+};
+
+
+/// Per-seat counting based on Raw Input, which unlike the low-level hooks
+/// tells which device an event came from. A device is assigned to the
+/// first seat whose match string occurs in its device interface name
+/// (e.g. "VID_046D&PID_C52B") the first time it sends input; input from
+/// devices matching no seat is ignored here and only counted globally.
+/// All seats are closed on the same interval boundary as the base window.
+/// Mouse distances are in raw device counts, as Raw Input reports them
+/// before pointer acceleration, or in pixels for absolute devices.
+class SeatTable {
+public:
+	static const int MaxSeats = 256;
+	SeatTable();
+	~SeatTable();
+	bool add(const TCHAR* pszSpec);
+	int count() const { return nSeats; }
+	Seat& operator[](int i) { return aSeats[i]; }
+	bool open(bool bOverwrite, UINT nIndexEvery, bool bCompress, bool bKeyClasses);
+	void close();
+	void input(int nDevice, const TCHAR* pszName, const RAWINPUT& ri, double fMotion, double fMeters);
+	void closeInterval();
+	void resetDevice(int nDevice) { anSeats[nDevice] = Unresolved; }
+
+private:
+	static const int Unresolved = -2;
+	const TCHAR* apszSpecs[MaxSeats];
+	Seat* aSeats;
+	int nSeats;
+	int anSeats[DeviceTable::MaxDevices];
+	bool bKeyClasses;
+	int seatOf(const TCHAR* pszName) const;
+};
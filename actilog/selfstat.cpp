@@ -0,0 +1,165 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "selfstat.h"
+#include <intrin.h>
+
+
+void LatencyHistogram::clear()
+{
+	ZeroMemory(aCounts, sizeof(aCounts));
+	ullCount = 0;
+	ullMax = 0;
+}
+
+
+int LatencyHistogram::bucketOf(ULONGLONG ullValue)
+{
+	if (ullValue < SubBuckets)
+		return (int)ullValue;
+	// position of the highest set bit, from two 32-bit scans so that
+	// this also works in 32-bit builds
+	unsigned long nMsb;
+	if (ullValue >> 32) {
+		_BitScanReverse(&nMsb, (unsigned long)(ullValue >> 32));
+		nMsb += 32;
+	}
+	else {
+		_BitScanReverse(&nMsb, (unsigned long)ullValue);
+	}
+	const int nShift = (int)nMsb - SubBucketBits;
+	return ((nShift + 1) << SubBucketBits) + (int)((ullValue >> nShift) & (SubBuckets - 1));
+}
+
+
+ULONGLONG LatencyHistogram::highestValueOf(int nBucket)
+{
+	if (nBucket < SubBuckets)
+		return nBucket;
+	const int nShift = (nBucket >> SubBucketBits) - 1;
+	const ULONGLONG ullLowest = (ULONGLONG)(SubBuckets + (nBucket & (SubBuckets - 1))) << nShift;
+	return ullLowest + (1ULL << nShift) - 1;
+}
+
+
+void LatencyHistogram::record(ULONGLONG ullValue)
+{
+	++aCounts[bucketOf(ullValue)];
+	++ullCount;
+	if (ullValue > ullMax)
+		ullMax = ullValue;
+}
+
+
+ULONGLONG LatencyHistogram::percentile(double fPercent) const
+{
+	// upper bound of the bucket holding the requested rank, but never
+	// more than the largest value actually recorded
+	if (ullCount == 0)
+		return 0;
+	ULONGLONG ullRank = (ULONGLONG)(fPercent / 100 * (double)ullCount + 0.5);
+	if (ullRank < 1)
+		ullRank = 1;
+	ULONGLONG ullSeen = 0;
+	for (int i = 0; i < NumBuckets; ++i) {
+		ullSeen += aCounts[i];
+		if (ullSeen >= ullRank) {
+			const ULONGLONG ullValue = highestValueOf(i);
+			return ullValue < ullMax? ullValue : ullMax;
+		}
+	}
+	return ullMax;
+}
+
+
+void SelfStats::clear()
+{
+	mouseLatency.clear();
+	keyboardLatency.clear();
+	ZeroMemory(anEvents, sizeof(anEvents));
+	nSlow = 0;
+	nLate = 0;
+	nUnmatched = 0;
+	nMissed = 0;
+}
+
+
+SelfMonitor::SelfMonitor()
+	: dwLastEventTime(GetTickCount())
+	, dwLastMissedInput(0)
+{
+	current.clear();
+	ZeroMemory(adwPressed, sizeof(adwPressed));
+}
+
+
+void SelfMonitor::event(EventKind kind, DWORD dwEventTime)
+{
+	++current.anEvents[kind];
+	// the hook structures carry the tick count at which the input happened
+	if (GetTickCount() - dwEventTime > LateEventMs)
+		++current.nLate;
+	dwLastEventTime = dwEventTime;
+}
+
+
+void SelfMonitor::press(UINT uCode)
+{
+	adwPressed[uCode / 32] |= 1u << (uCode % 32);
+}
+
+
+void SelfMonitor::release(UINT uCode)
+{
+	// a release without a press means the press went missing (or
+	// happened before we were hooked in)
+	const DWORD dwBit = 1u << (uCode % 32);
+	if ((adwPressed[uCode / 32] & dwBit) == 0)
+		++current.nUnmatched;
+	adwPressed[uCode / 32] &= ~dwBit;
+}
+
+
+void SelfMonitor::mouseDone(ULONGLONG ullStartNs, ULONGLONG ullEndNs)
+{
+	current.mouseLatency.record(ullEndNs - ullStartNs);
+	if (ullEndNs - ullStartNs > SlowHookNs)
+		++current.nSlow;
+}
+
+
+void SelfMonitor::keyboardDone(ULONGLONG ullStartNs, ULONGLONG ullEndNs)
+{
+	current.keyboardLatency.record(ullEndNs - ullStartNs);
+	if (ullEndNs - ullStartNs > SlowHookNs)
+		++current.nSlow;
+}
+
+
+void SelfMonitor::checkMissed()
+{
+	// the system keeps track of the last input independently of hooks;
+	// if that is well ahead of the last event we have seen, input went
+	// past us, most likely because the hook has been removed
+	LASTINPUTINFO lii;
+	lii.cbSize = sizeof(lii);
+	if (!GetLastInputInfo(&lii))
+		return;
+	if ((LONG)(lii.dwTime - dwLastEventTime) > (LONG)MissedInputMs && lii.dwTime != dwLastMissedInput) {
+		++current.nMissed;
+		dwLastMissedInput = lii.dwTime;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include "events.h"
+
+/// Log-linear histogram in the spirit of HdrHistogram: values below
+/// 2^SubBucketBits are counted exactly, larger ones in 2^SubBucketBits
+/// sub-buckets per power of two, i.e. with a relative error of at most
+/// 1/2^SubBucketBits. Recording is a bit scan and an increment.
+class LatencyHistogram {
+public:
+	static const int SubBucketBits = 3;
+	static const int SubBuckets = 1 << SubBucketBits;
+	static const int NumBuckets = (64 - SubBucketBits + 1) * SubBuckets;
+	LatencyHistogram() { clear(); }
+	void clear();
+	void record(ULONGLONG ullValue);
+	ULONGLONG percentile(double fPercent) const;
+	ULONGLONG count() const { return ullCount; }
+	ULONGLONG maximum() const { return ullMax; }
+
+private:
+	UINT aCounts[NumBuckets];
+	ULONGLONG ullCount;
+	ULONGLONG ullMax;
+	static int bucketOf(ULONGLONG ullValue);
+	static ULONGLONG highestValueOf(int nBucket);
+};
+
+
+/// actilog's measurements of itself over one interval: how long the hook
+/// callbacks take, how many events of each type arrived, and signs of
+/// lost input. Windows silently unhooks low-level hooks that exceed
+/// LowLevelHooksTimeout, and drops events while a hook is slow, so the
+/// interesting numbers are the latency tail and the suspected losses.
+struct SelfStats {
+	LatencyHistogram mouseLatency;
+	LatencyHistogram keyboardLatency;
+	UINT anEvents[NumEventKinds];
+	UINT nSlow;			// callbacks slower than SlowHookNs
+	UINT nLate;			// events delivered more than LateEventMs after they happened
+	UINT nUnmatched;	// releases without a preceding press
+	UINT nMissed;		// input the system saw but the hooks did not
+	void clear();
+};
+
+
+/// Per-event bookkeeping for SelfStats that has to survive the end of an
+/// interval: pressed buttons and keys (by virtual key code, so VK_LBUTTON
+/// etc. for the mouse), and the time of the last event.
+class SelfMonitor {
+public:
+	static const ULONGLONG SlowHookNs = 10000000;	// 10 ms
+	static const DWORD LateEventMs = 100;
+	static const DWORD MissedInputMs = 1000;
+	SelfMonitor();
+	SelfStats& stats() { return current; }
+	void event(EventKind kind, DWORD dwEventTime);
+	void press(UINT uCode);
+	void release(UINT uCode);
+	void mouseDone(ULONGLONG ullStartNs, ULONGLONG ullEndNs);
+	void keyboardDone(ULONGLONG ullStartNs, ULONGLONG ullEndNs);
+	void checkMissed();
+
+private:
+	SelfStats current;
+	DWORD adwPressed[256 / 32];
+	DWORD dwLastEventTime;
+	DWORD dwLastMissedInput;
+};
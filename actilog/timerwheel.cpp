@@ -0,0 +1,74 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "timerwheel.h"
+
+
+TimerWheel::TimerWheel()
+	: nLevels(1)
+	, ullTick(0)
+{
+	aSlots[0] = 1;
+	aPos[0] = 0;
+}
+
+
+bool TimerWheel::addLevel(UINT nSlots)
+{
+	if (nLevels >= MaxLevels || nSlots == 0)
+		return false;
+	aSlots[nLevels] = nSlots;
+	aPos[nLevels] = 0;
+	++nLevels;
+	return true;
+}
+
+
+ULONGLONG TimerWheel::revolution() const
+{
+	// number of base ticks after which every level has expired at least once
+	ULONGLONG ullTicks = 1;
+	for (int i = 1; i < nLevels; ++i)
+		ullTicks *= aSlots[i];
+	return ullTicks;
+}
+
+
+void TimerWheel::align(ULONGLONG ullTick)
+{
+	// position every level as if the wheel had been running since tick 0
+	this->ullTick = ullTick;
+	ULONGLONG ullPeriod = 1;
+	for (int i = 1; i < nLevels; ++i) {
+		aPos[i] = (UINT)((ullTick / ullPeriod) % aSlots[i]);
+		ullPeriod *= aSlots[i];
+	}
+}
+
+
+int TimerWheel::tick()
+{
+	// returns the number of levels that expired, level 0 included
+	++ullTick;
+	int nExpired = 1;
+	for (int i = 1; i < nLevels; ++i) {
+		if (++aPos[i] < aSlots[i])
+			break;
+		aPos[i] = 0;
+		++nExpired;
+	}
+	return nExpired;
+}
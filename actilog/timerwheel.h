@@ -0,0 +1,42 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+
+/// Hierarchical timer wheel driven by one base tick. Level 0 expires on
+/// every tick; level k has as many slots as level k-1 ticks fit into one
+/// of its own ticks, and expires whenever its position wraps around.
+/// A tick therefore costs O(1) amortized, no matter how many levels there
+/// are.
+class TimerWheel {
+public:
+	static const int MaxLevels = 8;
+	TimerWheel();
+	bool addLevel(UINT nSlots);
+	int levels() const { return nLevels; }
+	ULONGLONG revolution() const;
+	void align(ULONGLONG ullTick);
+	int tick();
+	ULONGLONG position() const { return ullTick; }
+
+private:
+	int nLevels;
+	UINT aSlots[MaxLevels];
+	UINT aPos[MaxLevels];
+	ULONGLONG ullTick;
+};
@@ -0,0 +1,140 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "warp.h"
+#include "util.h"
+#include <math.h>
+
+// a fast flick covers a few hundred pixels per event, even with pointer
+// acceleration on a high resolution display
+const double WarpFilter::DefaultMaxSpeed = 25.0; // px per ms
+
+
+WarpFilter::WarpFilter()
+	: dwLastTime(0)
+	, bHasLast(false)
+	, fMaxSpeed(0)
+	, bMonitorAware(false)
+	, nMonitors(0)
+	, nLastMonitor(0)
+{
+	ptLast.x = 0;
+	ptLast.y = 0;
+	SetRectEmpty(&rcDesktop);
+}
+
+
+void WarpFilter::setMonitorAware(bool bAware)
+{
+	bMonitorAware = bAware;
+	if (bMonitorAware)
+		refreshMonitors();
+}
+
+
+BOOL CALLBACK WarpFilter::MonitorProc(HMONITOR hMonitor, HDC hdc, LPRECT prc, LPARAM lParam)
+{
+	WarpFilter* pThis = (WarpFilter*)lParam;
+	if (pThis->nMonitors == MaxMonitors)
+		return FALSE;
+	pThis->arcMonitors[pThis->nMonitors++] = *prc;
+	UnionRect(&pThis->rcDesktop, &pThis->rcDesktop, prc);
+	return TRUE;
+}
+
+
+void WarpFilter::refreshMonitors()
+{
+	nMonitors = 0;
+	nLastMonitor = 0;
+	SetRectEmpty(&rcDesktop);
+	EnumDisplayMonitors(NULL, NULL, MonitorProc, (LPARAM)this);
+}
+
+
+void WarpFilter::setMonitors(const RECT* arcMonitors, int nMonitors)
+{
+	this->nMonitors = 0;
+	nLastMonitor = 0;
+	SetRectEmpty(&rcDesktop);
+	for (int i = 0; i < nMonitors && i < MaxMonitors; ++i) {
+		this->arcMonitors[this->nMonitors++] = arcMonitors[i];
+		UnionRect(&rcDesktop, &rcDesktop, &arcMonitors[i]);
+	}
+}
+
+
+int WarpFilter::monitorOf(const POINT& pt)
+{
+	if (nLastMonitor < nMonitors && PtInRect(&arcMonitors[nLastMonitor], pt))
+		return nLastMonitor;
+	for (int i = 0; i < nMonitors; ++i) {
+		if (PtInRect(&arcMonitors[i], pt)) {
+			nLastMonitor = i;
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+bool WarpFilter::touch(int a, int b) const
+{
+	// rectangles are right/bottom exclusive, so neighbours share an edge value
+	const RECT& ra = arcMonitors[a];
+	const RECT& rb = arcMonitors[b];
+	const bool bOverlapX = ra.left <= rb.right && rb.left <= ra.right;
+	const bool bOverlapY = ra.top <= rb.bottom && rb.top <= ra.bottom;
+	return bOverlapX && bOverlapY;
+}
+
+
+bool WarpFilter::isEdgeWrap(const POINT& from, const POINT& to) const
+{
+	if (nMonitors == 0)
+		return false;
+	const bool bLeft = from.x < rcDesktop.left + EdgePx && to.x >= rcDesktop.right - EdgePx;
+	const bool bRight = from.x >= rcDesktop.right - EdgePx && to.x < rcDesktop.left + EdgePx;
+	const bool bTop = from.y < rcDesktop.top + EdgePx && to.y >= rcDesktop.bottom - EdgePx;
+	const bool bBottom = from.y >= rcDesktop.bottom - EdgePx && to.y < rcDesktop.top + EdgePx;
+	return bLeft || bRight || bTop || bBottom;
+}
+
+
+bool WarpFilter::move(const POINT& pt, DWORD dwTime, double* pfDist)
+{
+	if (!bHasLast) {
+		ptLast = pt;
+		dwLastTime = dwTime;
+		bHasLast = true;
+		*pfDist = 0;
+		return false;
+	}
+	*pfDist = sqrt((double)squared(pt.x - ptLast.x) + (double)squared(pt.y - ptLast.y));
+	// event times come from the tick count, so consecutive events often
+	// carry the same time; a pause starts the motion afresh
+	const DWORD dwElapsed = dwTime - dwLastTime;
+	const DWORD dwSpan = dwElapsed < TickMs || dwElapsed > GapMs? TickMs : dwElapsed;
+	bool bWarp = fMaxSpeed > 0 && *pfDist > fMaxSpeed * dwSpan;
+	if (!bWarp && bMonitorAware && *pfDist > 0) {
+		const int nFrom = monitorOf(ptLast);
+		const int nTo = monitorOf(pt);
+		bWarp = (nFrom >= 0 && nTo >= 0 && nFrom != nTo && !touch(nFrom, nTo)) || isEdgeWrap(ptLast, pt);
+	}
+	ptLast = pt;
+	dwLastTime = dwTime;
+	return bWarp;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+
+/// Tells real mouse movement from cursor warps: jumps caused by remote
+/// desktop sessions, screen edge wrapping or applications that set the
+/// cursor position. A move is a warp if it is faster than a human hand
+/// can move the mouse, given the time since the previous event; after a
+/// pause the first move may not be longer than a single step. In monitor
+/// aware mode, moves between two monitors that do not touch and wraps
+/// from one edge of the desktop to the opposite one are warps, too.
+/// Every move costs a constant amount of work; the monitor layout is
+/// cached and has to be refreshed by the caller now and then, or set
+/// explicitly, e.g. to replay a recorded trace.
+class WarpFilter {
+public:
+	static const double DefaultMaxSpeed;
+	static const DWORD TickMs = 16;
+	static const DWORD GapMs = 500;
+	static const LONG EdgePx = 2;
+	static const int MaxMonitors = 16;
+	WarpFilter();
+	void setMaxSpeed(double fPxPerMs) { fMaxSpeed = fPxPerMs; }
+	void setMonitorAware(bool bAware);
+	bool isMonitorAware() const { return bMonitorAware; }
+	void refreshMonitors();
+	void setMonitors(const RECT* arcMonitors, int nMonitors);
+	bool move(const POINT& pt, DWORD dwTime, double* pfDist);
+
+private:
+	POINT ptLast;
+	DWORD dwLastTime;
+	bool bHasLast;
+	double fMaxSpeed;
+	bool bMonitorAware;
+	RECT arcMonitors[MaxMonitors];
+	int nMonitors;
+	RECT rcDesktop;
+	int nLastMonitor;
+	int monitorOf(const POINT& pt);
+	bool touch(int a, int b) const;
+	bool isEdgeWrap(const POINT& from, const POINT& to) const;
+	static BOOL CALLBACK MonitorProc(HMONITOR hMonitor, HDC hdc, LPRECT prc, LPARAM lParam);
+};
@@ -0,0 +1,198 @@
+/// actitail - follows a log written by actilog and prints every new
+///            record as soon as it has been written.
+///
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "follow.h"
+#include "logparse.h"
+#include "rrd.h"
+
+static const TCHAR* AppInfo = TEXT("actitail 1.0.4");
+
+enum _long_options {
+	SELECT_HELP = 0x1,
+	SELECT_ALL,
+	SELECT_RAW,
+	SELECT_RRD
+};
+
+static struct option long_options[] = {
+	{ "all",           no_argument, 0, SELECT_ALL },
+	{ "raw",           no_argument, 0, SELECT_RAW },
+	{ "rrd",           no_argument, 0, SELECT_RRD },
+	{ "help",          no_argument, 0, SELECT_HELP },
+	{ NULL,            0, 0, 0 }
+};
+
+
+HANDLE hStopEvent = NULL;
+bool bRaw = false;
+
+
+BOOL WINAPI CtlHandlerRoutine(DWORD dwCtrlType)
+{
+	SetEvent(hStopEvent);
+	return TRUE;
+}
+
+
+void printRecord(const char* pLine, size_t cbLine, void* pContext)
+{
+	// "YYYY-MM-DD hh:mm:ss TYPE args" -> "YYYY-MM-DDThh:mm:ss<TAB>TYPE<TAB>args"
+	LogRecord rec;
+	if (bRaw || !LogParser::parse(pLine, cbLine, &rec)) {
+		fwrite(pLine, 1, cbLine, stdout);
+	}
+	else {
+		fwrite(pLine, 1, 10, stdout);
+		fputc('T', stdout);
+		fwrite(pLine + 11, 1, 8, stdout);
+		fputc('\t', stdout);
+		fwrite(rec.name.p, 1, rec.name.cb, stdout);
+		if (rec.args.p > rec.name.p + rec.name.cb) {
+			fputc('\t', stdout);
+			fwrite(rec.args.p, 1, rec.args.cb, stdout);
+		}
+	}
+	fputc('\n', stdout);
+	fflush(stdout);
+}
+
+
+bool dumpArchive(const TCHAR* pszFilename)
+{
+	// one line per row still held: local start time, then the sums
+	RoundRobinArchive archive;
+	if (!archive.open(pszFilename)) {
+		fprintf(stderr, "Fatal error: cannot read archive '%s'\n", pszFilename);
+		return false;
+	}
+	if (archive.lastUtc() == 0)
+		return true;
+	const ULONGLONG ullStep = 10000000ULL * archive.step();
+	const ULONGLONG ullSpan = (archive.rows() - 1) * ullStep;
+	const ULONGLONG ullFrom = archive.lastUtc() > ullSpan? archive.lastUtc() - ullSpan : 0;
+	RrdRecord* aRows = (RrdRecord*)malloc(archive.rows() * sizeof(RrdRecord));
+	if (aRows == NULL)
+		return false;
+	const UINT nRows = archive.query(ullFrom, archive.lastUtc() + ullStep, aRows, archive.rows());
+	for (UINT i = 0; i < nRows; ++i) {
+		ULARGE_INTEGER u;
+		u.QuadPart = aRows[i].ullSlot * ullStep;
+		FILETIME ft, ftLocal;
+		ft.dwLowDateTime = u.LowPart;
+		ft.dwHighDateTime = u.HighPart;
+		SYSTEMTIME t;
+		FileTimeToLocalFileTime(&ft, &ftLocal);
+		FileTimeToSystemTime(&ftLocal, &t);
+		printf("%4d-%02d-%02dT%02d:%02d:%02d\t%.3lf\t%lu\t%lu\t%lu\t%lu\n",
+			t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond,
+			aRows[i].fMouseDist, aRows[i].nClicks, aRows[i].nDoubleClicks, aRows[i].nWheel, aRows[i].nKeys);
+	}
+	free(aRows);
+	return true;
+}
+
+
+void usage()
+{
+	printf("%s - follows a log file written by actilog.\n"
+		"\n"
+		"Usage: actitail [options] file\n"
+		"       actitail --rrd file\n"
+		"\n"
+		"  -a\n"
+		"  --all\n"
+		"     print the records already in the file, too\n"
+		"  -r\n"
+		"  --raw\n"
+		"     print lines as they are instead of tab-separated\n"
+		"     time, type and arguments\n"
+		"  --rrd\n"
+		"     print the rows of a round-robin archive written by actilog\n"
+		"     --rrd (e.g. 'prefix.3600.rrd') and exit; one line per row\n"
+		"     with start time, mouse_px, clicks, double_clicks, wheel\n"
+		"     and keys, separated by tabs\n"
+		"  -h\n"
+		"  -?\n"
+		"  --help\n"
+		"     show this help\n"
+		"\n",
+		AppInfo);
+}
+
+
+int main(int argc, TCHAR* argv[])
+{
+	bool bFromStart = false;
+	bool bArchive = false;
+	for (;;) {
+		int option_index = 0;
+		int c = getopt_long(argc, argv, "h?ar", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+		case 'a':
+			// fall-through
+		case SELECT_ALL:
+			bFromStart = true;
+			break;
+		case 'r':
+			// fall-through
+		case SELECT_RAW:
+			bRaw = true;
+			break;
+		case SELECT_RRD:
+			bArchive = true;
+			break;
+		case '?':
+			// fall-through
+		case 'h':
+			// fall-through
+		case SELECT_HELP:
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind >= argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+	if (bArchive)
+		return dumpArchive(argv[optind])? EXIT_SUCCESS : EXIT_FAILURE;
+	LogFollower follower;
+	if (!follower.open(argv[optind], bFromStart)) {
+		fprintf(stderr, "Fatal error: cannot watch '%s'\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+	hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	SetConsoleCtrlHandler(CtlHandlerRoutine, TRUE);
+	const bool bOk = follower.run(printRecord, NULL, hStopEvent);
+	if (follower.isCompressed())
+		fprintf(stderr, "Fatal error: '%s' is compressed (actilog --gzip) and cannot be followed\n", argv[optind]);
+	follower.close();
+	return bOk? EXIT_SUCCESS : EXIT_FAILURE;
+}
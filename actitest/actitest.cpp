@@ -0,0 +1,190 @@
+/// actitest - runs the tests and benchmarks of actilog and its tools.
+///
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "clock.h"
+#include "harness.h"
+#include "tests.h"
+
+static const TCHAR* AppInfo = TEXT("actitest 1.0.4");
+
+enum _long_options {
+	SELECT_HELP = 0x1,
+	SELECT_BENCH,
+	SELECT_LIST,
+	SELECT_KEEP
+};
+
+static struct option long_options[] = {
+	{ "bench",         no_argument, 0, SELECT_BENCH },
+	{ "list",          no_argument, 0, SELECT_LIST },
+	{ "keep",          no_argument, 0, SELECT_KEEP },
+	{ "help",          no_argument, 0, SELECT_HELP },
+	{ NULL,            0, 0, 0 }
+};
+
+static const TestCase Tests[] = {
+	{ "journal-kill",          testJournalKill, false },
+	{ "shutdown-break",        testShutdownBreak, false },
+	{ "rrd-reader",            testRrdReader, false },
+	{ "index-seek",            testIndexSeek, false },
+	{ "index-live",            testIndexLive, false },
+	{ "metrics-scrape",        testMetricsScrape, false },
+	{ "metrics-scrape-bench",  benchMetricsScrape, true },
+	{ "format-csv",            testFormatCsv, false },
+	{ "format-ndjson",         testFormatNdjson, false },
+	{ "format-bench",          benchFormatRecords, true },
+	{ "device-slots",          testDeviceSlots, false },
+	{ "device-motion",         testDeviceMotion, false },
+	{ "warp-trace",            testWarpTrace, false },
+	{ "anomaly-replay",        testAnomalyReplay, false },
+	{ "parse-mutations",       testParseMutations, false },
+	{ "parse-bench",           benchParseLog, true },
+	{ "arena-reader",          testArenaReader, false },
+	{ "arena-bench",           benchArenaReader, true },
+	{ "logger-writes",         testLoggerWrites, false },
+	{ "logger-writes-bench",   benchLoggerWrites, true },
+	{ "reader-direct-bench",   benchReaderDirect, true },
+	{ "gzip-members",          testGzipMembers, false },
+	{ "gzip-roundtrip",        testGzipRoundTrip, false },
+	{ "gzip-append",           testGzipAppend, false },
+	{ "compact-merge",         testCompactMerge, false },
+	{ "compact-edges",         testCompactEdges, false },
+};
+static const int NumTests = sizeof(Tests) / sizeof(Tests[0]);
+
+
+bool bBench = false;
+bool bKeep = false;
+
+
+void usage()
+{
+	printf("%s - runs the tests and benchmarks of actilog and its tools.\n"
+		"\n"
+		"Usage: actitest [options] [name ...]\n"
+		"\n"
+		"Runs all tests whose name contains one of the given names (default:\n"
+		"all tests). The tools are started from the directory of actitest.exe\n"
+		"and work in a temporary directory. Tests of actilog itself inject\n"
+		"key presses (F24) and mouse moves, so they need an interactive\n"
+		"desktop and should not run while someone is working on it.\n"
+		"\n"
+		"  -b\n"
+		"  --bench\n"
+		"     run the benchmarks, too\n"
+		"  -l\n"
+		"  --list\n"
+		"     list the tests and benchmarks and exit\n"
+		"  -k\n"
+		"  --keep\n"
+		"     keep the temporary directory (it is always kept on failure)\n"
+		"  -h\n"
+		"  -?\n"
+		"  --help\n"
+		"     show this help\n"
+		"\n",
+		AppInfo);
+}
+
+
+bool isSelected(const TestCase& test, int argc, TCHAR* argv[])
+{
+	if (test.bBench && !bBench)
+		return false;
+	if (optind >= argc)
+		return true;
+	for (int i = optind; i < argc; ++i)
+		if (strstr(test.pszName, argv[i]) != NULL)
+			return true;
+	return false;
+}
+
+
+int main(int argc, TCHAR* argv[])
+{
+	bool bList = false;
+	for (;;) {
+		int option_index = 0;
+		int c = getopt_long(argc, argv, "h?blk", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c)
+		{
+		case 'b':
+			// fall-through
+		case SELECT_BENCH:
+			bBench = true;
+			break;
+		case 'l':
+			// fall-through
+		case SELECT_LIST:
+			bList = true;
+			break;
+		case 'k':
+			// fall-through
+		case SELECT_KEEP:
+			bKeep = true;
+			break;
+		case '?':
+			// fall-through
+		case 'h':
+			// fall-through
+		case SELECT_HELP:
+			usage();
+			return EXIT_SUCCESS;
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+	if (bList) {
+		for (int i = 0; i < NumTests; ++i)
+			printf("%s%s\n", Tests[i].pszName, Tests[i].bBench? " (benchmark)" : "");
+		return EXIT_SUCCESS;
+	}
+	Clock::init();
+	if (!setupTestDir()) {
+		fprintf(stderr, "Fatal error: cannot create a temporary directory\n");
+		return EXIT_FAILURE;
+	}
+	int nRun = 0;
+	int nFailed = 0;
+	for (int i = 0; i < NumTests; ++i) {
+		if (!isSelected(Tests[i], argc, argv))
+			continue;
+		printf("%s\n", Tests[i].pszName);
+		const ULONGLONG ullStartNs = Clock::now();
+		const bool bOk = Tests[i].proc();
+		printf("  %s (%.1lf secs)\n", bOk? "ok" : "FAILED", secondsSince(ullStartNs));
+		++nRun;
+		if (!bOk)
+			++nFailed;
+	}
+	printf("%d of %d passed\n", nRun - nFailed, nRun);
+	if (nFailed > 0 || bKeep)
+		printf("files kept in '%s'\n", testDir());
+	else
+		removeTestDir();
+	return nFailed == 0? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,174 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "arena.h"
+#include "recordreader.h"
+#include "anomaly.h"
+#include "tests.h"
+#include <stdlib.h>
+
+static const int MaxIntervals = 8192;
+// where the faults go, in active intervals from the start of the log;
+// the detector is long warmed up by then
+static const int StuckKeyAt = 1000;
+static const int StuckKey = 'A';
+static const int StuckKeyPresses = 3000;
+static const int ConstantClicksAt = 2000;
+static const int ConstantClicks = 120;
+static const int SpikeAt = 3000;
+static const double SpikeFactor = 50;
+
+
+/// What the detector reported for every interval of a replayed log: a bit
+/// per AnomalyKind, and the key of a stuck key.
+struct Replay {
+	BYTE aKinds[MaxIntervals];
+	int anStuckKeys[MaxIntervals];
+	int nIntervals;
+};
+
+
+static void injectFault(Counters& c, int i)
+{
+	if (i == StuckKeyAt)
+		c.aHisto[StuckKey] += StuckKeyPresses;
+	if (i >= ConstantClicksAt && i < ConstantClicksAt + AnomalyDetector::ConstantClicksRun + 4)
+		c.nClicks = ConstantClicks;
+	if (i == SpikeAt)
+		c.fMouseDist *= SpikeFactor;
+}
+
+
+static void checkInterval(AnomalyDetector& detector, Counters& c, bool bFaults, Replay& replay)
+{
+	const int i = replay.nIntervals;
+	if (i >= MaxIntervals)
+		return;
+	if (bFaults)
+		injectFault(c, i);
+	Anomaly aAnomalies[AnomalyDetector::MaxAnomalies];
+	const int n = detector.check(c, aAnomalies);
+	replay.aKinds[i] = 0;
+	replay.anStuckKeys[i] = -1;
+	for (int j = 0; j < n; ++j) {
+		replay.aKinds[i] |= 1 << aAnomalies[j].kind;
+		if (aAnomalies[j].kind == AnomalyStuckKey)
+			replay.anStuckKeys[i] = aAnomalies[j].nKey;
+	}
+	++replay.nIntervals;
+}
+
+
+static bool replayLog(const TCHAR* pszLog, bool bFaults, Replay& replay)
+{
+	// the lines from one INTERVAL up to the next line of another kind
+	// make up the counters of that interval, as actilog wrote them
+	Arena arena;
+	RecordReader reader(arena);
+	CHECK(reader.open(pszLog));
+	AnomalyDetector detector;
+	Counters c;
+	bool bOpen = false;
+	replay.nIntervals = 0;
+	UINT n;
+	while ((n = reader.next()) > 0) {
+		for (UINT i = 0; i < n; ++i) {
+			const ParsedRecord& parsed = reader.record(i);
+			const LogRecord& r = parsed.rec;
+			switch (r.type)
+			{
+			case RecordInterval:
+				if (bOpen)
+					checkInterval(detector, c, bFaults, replay);
+				SecureZeroMemory(&c, sizeof(c));
+				bOpen = true;
+				break;
+			case RecordMove:
+				c.fMouseDist = r.fValue;
+				break;
+			case RecordWheel:
+				c.nWheel = r.nCount;
+				break;
+			case RecordClick:
+				c.nClicks = r.nCount;
+				break;
+			case RecordDoubleClick:
+				c.nDoubleClicks = r.nCount;
+				break;
+			case RecordWarp:
+				c.nWarps = r.nCount;
+				c.fWarpDist = r.fValue;
+				break;
+			case RecordKeyStat:
+				for (int k = 0; k < r.nCount; ++k)
+					c.aHisto[k] = parsed.anKeys[k];
+				break;
+			default:
+				if (bOpen)
+					checkInterval(detector, c, bFaults, replay);
+				bOpen = false;
+				break;
+			}
+		}
+	}
+	if (bOpen)
+		checkInterval(detector, c, bFaults, replay);
+	CHECK(!reader.failed());
+	return true;
+}
+
+
+static bool reported(const Replay& replay, int i, AnomalyKind kind)
+{
+	return (replay.aKinds[i] & (1 << kind)) != 0;
+}
+
+
+bool testAnomalyReplay()
+{
+	// two weeks of a simulated user, replayed once as generated and once
+	// with a stuck key, a clicking bot and a burst of mouse movement
+	// injected: every fault is reported where it was injected, and the
+	// clean replay has neither stuck keys nor constant clicks
+	CHECK(generateLogs(TEXT("anomaly"), 1, 14));
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("anomaly\\host0000.log"));
+	Replay* pClean = (Replay*)malloc(sizeof(Replay));
+	Replay* pFaults = (Replay*)malloc(sizeof(Replay));
+	const bool bReplayed = pClean != NULL && pFaults != NULL && replayLog(szLog, false, *pClean) && replayLog(szLog, true, *pFaults);
+	bool bOk = bReplayed && pClean->nIntervals > SpikeAt && pFaults->nIntervals == pClean->nIntervals;
+	if (bOk) {
+		const Replay& clean = *pClean;
+		const Replay& faults = *pFaults;
+		for (int i = 0; i < clean.nIntervals && bOk; ++i)
+			bOk = !reported(clean, i, AnomalyStuckKey) && !reported(clean, i, AnomalyConstantClicks);
+		if (!bOk)
+			testNote("stuck key or constant clicks in the clean log");
+		bOk = bOk && reported(faults, StuckKeyAt, AnomalyStuckKey) && faults.anStuckKeys[StuckKeyAt] == StuckKey;
+		// the bot is told from a human after ConstantClicksRun intervals
+		const int iBot = ConstantClicksAt + AnomalyDetector::ConstantClicksRun;
+		for (int i = ConstantClicksAt; i < iBot && bOk; ++i)
+			bOk = !reported(faults, i, AnomalyConstantClicks);
+		bOk = bOk && reported(faults, iBot, AnomalyConstantClicks);
+		bOk = bOk && reported(faults, SpikeAt, AnomalySpike) && !reported(clean, SpikeAt, AnomalySpike);
+	}
+	free(pClean);
+	free(pFaults);
+	CHECK(bReplayed);
+	CHECK(bOk);
+	return true;
+}
@@ -0,0 +1,133 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "clock.h"
+#include "arena.h"
+#include "recordreader.h"
+#include "tests.h"
+#include <stdlib.h>
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
+
+static const int ArenaHosts = 3;
+static const int ArenaDays = 7;
+static const ULONGLONG BenchBytes = 2ULL * 1024 * 1024 * 1024;
+
+static long nCrtAllocations = 0;
+
+
+#ifdef _DEBUG
+static int __cdecl countAllocation(int nType, void*, size_t, int, long, const unsigned char*, int)
+{
+	if (nType == _HOOK_ALLOC || nType == _HOOK_REALLOC)
+		++nCrtAllocations;
+	return TRUE;
+}
+#endif
+
+
+static void startCounting()
+{
+	// only the debug CRT can tell; a release build checks the arena alone
+	nCrtAllocations = 0;
+#ifdef _DEBUG
+	_CrtSetAllocHook(countAllocation);
+#endif
+}
+
+
+static long stopCounting()
+{
+#ifdef _DEBUG
+	_CrtSetAllocHook(NULL);
+#endif
+	return nCrtAllocations;
+}
+
+
+static bool readLog(Arena& arena, RecordReader& reader, const TCHAR* pszLog, double* pfRecords)
+{
+	// as the tools read a list of files: one arena, reset for every file
+	arena.reset();
+	if (!reader.open(pszLog))
+		return false;
+	UINT n;
+	while ((n = reader.next()) > 0)
+		*pfRecords += n;
+	const bool bOk = !reader.failed();
+	reader.close();
+	return bOk;
+}
+
+
+bool testArenaReader()
+{
+	// once the first log has been read, the reader runs on the blocks
+	// the arena already has: reading more logs takes nothing from the
+	// heap, neither through the arena nor past it
+	CHECK(generateLogs(TEXT("arena"), ArenaHosts, ArenaDays));
+	Arena arena;
+	RecordReader reader(arena);
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("arena\\host0000.log"));
+	double fRecords = 0;
+	CHECK(readLog(arena, reader, szLog, &fRecords));
+	CHECK(fRecords > 0);
+	const UINT nBlocks = arena.heapAllocations();
+	CHECK(nBlocks > 0);
+	bool bRead = true;
+	startCounting();
+	for (int i = 1; i < ArenaHosts && bRead; ++i) {
+		TCHAR szName[MAX_PATH];
+		_sntprintf(szName, MAX_PATH, TEXT("arena\\host%04d.log"), i);
+		testFile(szLog, szName);
+		bRead = readLog(arena, reader, szLog, &fRecords);
+	}
+	const long nAllocations = stopCounting();
+	CHECK(bRead);
+	CHECK(arena.heapAllocations() == nBlocks);
+	CHECK(nAllocations == 0);
+	return true;
+}
+
+
+bool benchArenaReader()
+{
+	// a few GB of one host's log repeated, read the way actiexport and
+	// acticompact read; the file was just written, so it mostly comes
+	// from the file cache and parsing is what is measured
+	CHECK(generateLogs(TEXT("arena-bench"), 1, 14));
+	TCHAR szLog[MAX_PATH];
+	TCHAR szBig[MAX_PATH];
+	testFile(szLog, TEXT("arena-bench\\host0000.log"));
+	testFile(szBig, TEXT("arena-bench\\big.log"));
+	ULONGLONG cbBig;
+	CHECK(repeatFile(szLog, szBig, BenchBytes, &cbBig));
+	Arena arena;
+	RecordReader reader(arena);
+	double fRecords = 0;
+	const ULONGLONG ullStartNs = Clock::now();
+	const bool bRead = readLog(arena, reader, szBig, &fRecords);
+	const double fSecs = secondsSince(ullStartNs);
+	DeleteFile(szBig);
+	CHECK(bRead);
+	benchResult("arena reader", fRecords / fSecs, "records/sec");
+	benchResult("arena reader", (double)cbBig / fSecs / (1024 * 1024), "MB/sec");
+	benchResult("arena reader heap blocks", arena.heapAllocations(), "blocks");
+	return true;
+}
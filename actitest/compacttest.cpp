@@ -0,0 +1,208 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "tests.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int MergeDays = 2;
+static const int MaxSameSecond = 4096;
+static const DWORD CompactTimeout = 60000;
+
+
+static int splitLines(const char* p, size_t cb, const char*** papLines)
+{
+	// the start of every line and, as the last entry, the end of the text
+	const char* const pEnd = p + cb;
+	int nLines = 0;
+	for (const char* q = p; q < pEnd; ++q)
+		if (*q == '\n')
+			++nLines;
+	const char** apLines = (const char**)malloc((nLines + 2) * sizeof(const char*));
+	if (apLines == NULL)
+		return -1;
+	int n = 0;
+	while (p < pEnd) {
+		apLines[n++] = p;
+		const char* pEol = (const char*)memchr(p, '\n', pEnd - p);
+		p = pEol? pEol + 1 : pEnd;
+	}
+	apLines[n] = pEnd;
+	*papLines = apLines;
+	return n;
+}
+
+
+static bool isSegmentBound(const char* p, size_t cb)
+{
+	return (cb >= 25 && memcmp(p + 20, "START", 5) == 0) || (cb >= 24 && memcmp(p + 20, "STOP", 4) == 0);
+}
+
+
+static bool writeInput(const TCHAR* pszFile, const char* const* apLines, int iFirst, int iEnd)
+{
+	// lines iFirst to iEnd, with every START and STOP line written twice,
+	// as when a stopped logger is started again within the same second
+	const size_t cbMax = 2 * (apLines[iEnd] - apLines[iFirst]);
+	char* pText = (char*)malloc(cbMax + 1);
+	if (pText == NULL)
+		return false;
+	size_t cb = 0;
+	for (int i = iFirst; i < iEnd; ++i) {
+		const size_t cbLine = apLines[i + 1] - apLines[i];
+		for (int n = isSegmentBound(apLines[i], cbLine)? 2 : 1; n > 0; --n) {
+			memcpy(pText + cb, apLines[i], cbLine);
+			cb += cbLine;
+		}
+	}
+	const bool bOk = writeFile(pszFile, pText, cb);
+	free(pText);
+	return bOk;
+}
+
+
+static bool sameLines(const TCHAR* pszFile, const char* pExpected, size_t cbExpected)
+{
+	// line for line, naming the first one that differs
+	size_t cb;
+	char* pData = readFile(pszFile, &cb);
+	if (pData == NULL) {
+		testNote("cannot read '%s'", pszFile);
+		return false;
+	}
+	int nLine = 1;
+	size_t i = 0;
+	while (i < cb && i < cbExpected && pData[i] == pExpected[i]) {
+		if (pData[i] == '\n')
+			++nLine;
+		++i;
+	}
+	free(pData);
+	if (i < cb || i < cbExpected) {
+		testNote("'%s' differs in line %d", pszFile, nLine);
+		return false;
+	}
+	return true;
+}
+
+
+static bool compact(const TCHAR* pszOutputDir, const TCHAR* pszInputs)
+{
+	TCHAR szArgs[4 * MAX_PATH];
+	_sntprintf(szArgs, 4 * MAX_PATH, TEXT("-o \"%s\" %s"), pszOutputDir, pszInputs);
+	return runTool(TEXT("acticompact"), szArgs, CompactTimeout) == EXIT_SUCCESS;
+}
+
+
+bool testCompactMerge()
+{
+	// two logs of one host that overlap by a third of their lines, with
+	// doubled START and STOP lines, merge back into the actigen log, one
+	// file per day
+	CHECK(generateLogs(TEXT("compact"), 1, MergeDays));
+	TCHAR szPlain[MAX_PATH];
+	TCHAR szFirst[MAX_PATH];
+	TCHAR szSecond[MAX_PATH];
+	TCHAR szOutputDir[MAX_PATH];
+	testFile(szPlain, TEXT("compact\\host0000.log"));
+	testFile(szFirst, TEXT("compact\\host0000.1.log"));
+	testFile(szSecond, TEXT("compact\\host0000.2.log"));
+	testFile(szOutputDir, TEXT("compact\\out"));
+	size_t cbPlain;
+	char* pPlain = readFile(szPlain, &cbPlain);
+	CHECK(pPlain != NULL);
+	const char** apLines = NULL;
+	const int nLines = splitLines(pPlain, cbPlain, &apLines);
+	CHECK(nLines > 0);
+	CHECK(writeInput(szFirst, apLines, 0, 2 * nLines / 3));
+	CHECK(writeInput(szSecond, apLines, nLines / 3, nLines));
+	TCHAR szInputs[3 * MAX_PATH];
+	// in order: a second cut in two by the overlap is then completed by
+	// the second log rather than written before its first lines
+	_sntprintf(szInputs, 3 * MAX_PATH, TEXT("\"%s\" \"%s\""), szFirst, szSecond);
+	CHECK(compact(szOutputDir, szInputs));
+	// actigen writes CRLF like actilog, so every day is a run of its lines
+	int nDays = 0;
+	for (int i = 0; i < nLines; ) {
+		int n = 1;
+		while (i + n < nLines && memcmp(apLines[i + n], apLines[i], 10) == 0)
+			++n;
+		TCHAR szDay[MAX_PATH];
+		_sntprintf(szDay, MAX_PATH, TEXT("%s\\host0000-%.10s.log"), szOutputDir, apLines[i]);
+		CHECK(sameLines(szDay, apLines[i], apLines[i + n] - apLines[i]));
+		++nDays;
+		i += n;
+	}
+	CHECK(nDays == MergeDays);
+	free(apLines);
+	free(pPlain);
+	return true;
+}
+
+
+bool testCompactEdges()
+{
+	// more distinct lines in one second than acticompact remembers are
+	// all written, and duplicates of the ones it no longer remembers
+	// are kept rather than anything lost; local time stepping back over
+	// midnight and forward again (end of daylight saving time, or the
+	// clock set back) appends to the days written before
+	static const int SameSecond = MaxSameSecond + 2;
+	static const char StepBack[] =
+		"2013-01-07 23:59:58 WHEEL 1\r\n"
+		"2013-01-08 00:00:02 WHEEL 2\r\n"
+		"2013-01-07 23:59:59 WHEEL 3\r\n"
+		"2013-01-08 00:00:03 WHEEL 4\r\n";
+	static const char FirstDay[] =
+		"2013-01-07 23:59:58 WHEEL 1\r\n"
+		"2013-01-07 23:59:59 WHEEL 3\r\n";
+	static const char SecondDay[] =
+		"2013-01-08 00:00:02 WHEEL 2\r\n"
+		"2013-01-08 00:00:03 WHEEL 4\r\n";
+	TCHAR szFirst[MAX_PATH];
+	TCHAR szSecond[MAX_PATH];
+	TCHAR szClock[MAX_PATH];
+	TCHAR szOutputDir[MAX_PATH];
+	TCHAR szOutput[MAX_PATH];
+	testFile(szFirst, TEXT("burst.1.log"));
+	testFile(szSecond, TEXT("burst.2.log"));
+	testFile(szClock, TEXT("clock.log"));
+	testFile(szOutputDir, TEXT("compact-edges"));
+	const size_t cbLine = sizeof("2013-01-07 10:00:00 WHEEL 0000\r\n") - 1;
+	char* pBurst = (char*)malloc((SameSecond + 2) * cbLine + 1);
+	CHECK(pBurst != NULL);
+	for (int i = 0; i < SameSecond; ++i)
+		_snprintf(pBurst + i * cbLine, cbLine + 1, "2013-01-07 10:00:00 WHEEL %04d\r\n", i);
+	CHECK(writeFile(szFirst, pBurst, SameSecond * cbLine));
+	CHECK(writeFile(szSecond, pBurst, SameSecond * cbLine));
+	CHECK(writeFile(szClock, StepBack, sizeof(StepBack) - 1));
+	TCHAR szInputs[3 * MAX_PATH];
+	_sntprintf(szInputs, 3 * MAX_PATH, TEXT("\"%s\" \"%s\" \"%s\""), szFirst, szSecond, szClock);
+	CHECK(compact(szOutputDir, szInputs));
+	// all of the first file, then the lines of the second one past those
+	// that were remembered
+	memcpy(pBurst + SameSecond * cbLine, pBurst + MaxSameSecond * cbLine, 2 * cbLine);
+	_sntprintf(szOutput, MAX_PATH, TEXT("%s\\burst-2013-01-07.log"), szOutputDir);
+	const bool bBurst = sameLines(szOutput, pBurst, (SameSecond + 2) * cbLine);
+	free(pBurst);
+	CHECK(bBurst);
+	_sntprintf(szOutput, MAX_PATH, TEXT("%s\\clock-2013-01-07.log"), szOutputDir);
+	CHECK(sameLines(szOutput, FirstDay, sizeof(FirstDay) - 1));
+	_sntprintf(szOutput, MAX_PATH, TEXT("%s\\clock-2013-01-08.log"), szOutputDir);
+	CHECK(sameLines(szOutput, SecondDay, sizeof(SecondDay) - 1));
+	return true;
+}
@@ -0,0 +1,77 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "rawinput.h"
+#include "tests.h"
+#include <math.h>
+
+
+static HANDLE fakeDevice(int i)
+{
+	// never a real device, so the table finds no name for it
+	return (HANDLE)(ULONG_PTR)(0x10000 + 16 * i);
+}
+
+
+bool testDeviceSlots()
+{
+	// an unplugged device's number is given to the next new device once
+	// the interval it was unplugged in has been written
+	DeviceTable table;
+	for (int i = 0; i < DeviceTable::MaxDevices; ++i)
+		CHECK(table.indexOf(fakeDevice(i)) == i);
+	CHECK(table.count() == DeviceTable::MaxDevices);
+	CHECK(table.indexOf(fakeDevice(DeviceTable::MaxDevices)) == -1);
+	CHECK(table.indexOf(fakeDevice(7)) == 7);
+	table.remove(fakeDevice(7));
+	CHECK(!table.isRetired(7));
+	CHECK(table.indexOf(fakeDevice(DeviceTable::MaxDevices)) == -1);
+	table.closeInterval();
+	CHECK(table.isRetired(7));
+	CHECK(table.indexOf(fakeDevice(DeviceTable::MaxDevices)) == -1);
+	table.release(7);
+	CHECK(table.indexOf(fakeDevice(DeviceTable::MaxDevices)) == 7);
+	CHECK(table.indexOf(fakeDevice(DeviceTable::MaxDevices + 1)) == -1);
+	CHECK(table.count() == DeviceTable::MaxDevices);
+	return true;
+}
+
+
+bool testDeviceMotion()
+{
+	// mice move in counts; absolute devices move in pixels, here once
+	// across the whole virtual desktop
+	DeviceTable table;
+	const int nMouse = table.indexOf(fakeDevice(0));
+	const int nTablet = table.indexOf(fakeDevice(1));
+	RAWMOUSE m;
+	ZeroMemory(&m, sizeof(m));
+	m.lLastX = 3;
+	m.lLastY = -4;
+	CHECK(table.motion(nMouse, m) == 5);
+	CHECK(!table.isAbsolute(nMouse));
+	m.usFlags = MOUSE_MOVE_ABSOLUTE | MOUSE_VIRTUAL_DESKTOP;
+	m.lLastX = 0;
+	m.lLastY = 32768;
+	CHECK(table.motion(nTablet, m) == 0);
+	CHECK(table.isAbsolute(nTablet));
+	m.lLastX = 65535;
+	const double fWidth = GetSystemMetrics(SM_CXVIRTUALSCREEN);
+	CHECK(fabs(table.motion(nTablet, m) - fWidth) < 0.5);
+	CHECK(table.motion(nTablet, m) == 0);
+	return true;
+}
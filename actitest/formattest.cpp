@@ -0,0 +1,147 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "clock.h"
+#include "format.h"
+#include "tests.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const ULONGLONG StartUtc = 130000000000000000ULL;
+static const ULONGLONG IntervalUtc = 10000000ULL * 600;
+static const int BenchRecords = 200000;
+
+
+static void fillCounters(Counters& c, int i)
+{
+	ZeroMemory(&c, sizeof(c));
+	c.fMouseDist = 1000 + i;
+	c.nClicks = 12;
+	c.nWheel = 3;
+	c.nWarps = 2;
+	c.fWarpDist = 12.5;
+	for (int vk = 0x30; vk <= 0x5a; ++vk)
+		c.aHisto[vk] = vk + i % 7;
+	c.ullFirstEventNs = 1000000000ULL * i;
+	c.ullLastEventNs = c.ullFirstEventNs + 599000000000ULL;
+}
+
+
+static const char* lineEnd(const char* pLine)
+{
+	const char* pEnd = strchr(pLine, '\n');
+	return pEnd? pEnd : pLine + strlen(pLine);
+}
+
+
+static bool lineEndsWith(const char* pLine, const char* pszSuffix)
+{
+	const char* pEnd = lineEnd(pLine);
+	if (pEnd > pLine && pEnd[-1] == '\r')
+		--pEnd;
+	const size_t cch = strlen(pszSuffix);
+	return (size_t)(pEnd - pLine) >= cch && strncmp(pEnd - cch, pszSuffix, cch) == 0;
+}
+
+
+bool testFormatCsv()
+{
+	// warps and warp_px come after the key columns, and a file is only
+	// appended to under the header it already has
+	TCHAR szCsv[MAX_PATH];
+	testFile(szCsv, TEXT("format.csv"));
+	Counters c;
+	fillCounters(c, 0);
+	Logger out;
+	CHECK(out.open(true, szCsv));
+	CHECK(writeCsvHeader(out, false));
+	writeRecord(out, FormatCsv, "interval", StartUtc, StartUtc + IntervalUtc, c, 0.25, NULL);
+	out.close();
+	CHECK(out.open(false, szCsv));
+	CHECK(writeCsvHeader(out, false));
+	writeRecord(out, FormatCsv, "interval", StartUtc + IntervalUtc, StartUtc + 2 * IntervalUtc, c, 0.25, NULL);
+	CHECK(!writeCsvHeader(out, true));
+	out.close();
+	size_t cb;
+	char* pData = readFile(szCsv, &cb);
+	CHECK(pData != NULL);
+	const char* pRow = lineEnd(pData);
+	const bool bHeader = strncmp(pData, "kind,start,end,secs,", 20) == 0 && lineEndsWith(pData, ",key_255,warps,warp_px");
+	int nLines = 0;
+	for (const char* p = pData; p < pData + cb; p = lineEnd(p) + 1)
+		++nLines;
+	const bool bRows = *pRow == '\n' && strncmp(pRow + 1, "interval,", 9) == 0 && lineEndsWith(pRow + 1, ",2,12.500");
+	free(pData);
+	CHECK(bHeader);
+	CHECK(bRows);
+	CHECK(nLines == 3);
+	return true;
+}
+
+
+bool testFormatNdjson()
+{
+	// the fields added later close the object, after the keys
+	TCHAR szJson[MAX_PATH];
+	testFile(szJson, TEXT("format.ndjson"));
+	Counters c;
+	fillCounters(c, 0);
+	Logger out;
+	CHECK(out.open(true, szJson));
+	writeRecord(out, FormatNdjson, "interval", StartUtc, StartUtc + IntervalUtc, c, 0.25, NULL);
+	writeRecord(out, FormatNdjson, "interval", StartUtc, StartUtc + IntervalUtc, c, 0.25, c.aKeyClasses);
+	out.close();
+	size_t cb;
+	char* pData = readFile(szJson, &cb);
+	CHECK(pData != NULL);
+	const char* pSecond = lineEnd(pData) + 1;
+	const bool bKeys = strncmp(pData, "{\"kind\":\"interval\",", 19) == 0 && lineEndsWith(pData, "],\"warps\":2,\"warp_px\":12.500}");
+	const bool bClasses = pSecond < pData + cb && lineEndsWith(pSecond, "},\"warps\":2,\"warp_px\":12.500}");
+	free(pData);
+	CHECK(bKeys);
+	CHECK(bClasses);
+	return true;
+}
+
+
+static bool benchFormat(OutputFormat format, const TCHAR* pszName, const char* pszWhat)
+{
+	TCHAR szFile[MAX_PATH];
+	testFile(szFile, pszName);
+	Counters c;
+	fillCounters(c, 0);
+	Logger out;
+	CHECK(out.open(true, szFile));
+	const ULONGLONG ullStartNs = Clock::now();
+	for (int i = 0; i < BenchRecords; ++i)
+		writeRecord(out, format, "interval", StartUtc + i * IntervalUtc, StartUtc + (i + 1) * IntervalUtc, c, 0.25, NULL);
+	const double fBytes = (double)out.offset();
+	out.close();
+	const double fSecs = secondsSince(ullStartNs);
+	benchResult(pszWhat, BenchRecords / fSecs, "records/sec");
+	benchResult(pszWhat, fBytes / fSecs / (1024 * 1024), "MB/sec");
+	return true;
+}
+
+
+bool benchFormatRecords()
+{
+	// records with the full key histogram, as actilog writes them
+	CHECK(benchFormat(FormatCsv, TEXT("format-bench.csv"), "csv"));
+	CHECK(benchFormat(FormatNdjson, TEXT("format-bench.ndjson"), "ndjson"));
+	return true;
+}
@@ -0,0 +1,43 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "parsecheck.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// libFuzzer target for LogParser::parse. It is not part of actitest.vcxproj;
+// build it with clang from the solution directory, e.g.
+//   clang-cl /Zi /O1 -fsanitize=fuzzer,address /I logger actitest\fuzzlogparse.cpp
+//       actitest\parsecheck.cpp logger\logparse.cpp /Fe:fuzzlogparse.exe
+// and seed it with a few lines of every type, e.g. from actigen output:
+//   fuzzlogparse.exe -max_len=4096 corpus
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* pData, size_t cb)
+{
+	// the input is split into lines as RecordReader splits a log
+	const char* p = (const char*)pData;
+	const char* const pEnd = p + cb;
+	while (p < pEnd) {
+		const char* pNewline = (const char*)memchr(p, '\n', pEnd - p);
+		const char* pLineEnd = pNewline? pNewline : pEnd;
+		if (!checkParse(p, pLineEnd - p))
+			abort();
+		p = pLineEnd + 1;
+	}
+	return 0;
+}
@@ -0,0 +1,245 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "log.h"
+#include "logindex.h"
+#include "gzipreader.h"
+#include "arena.h"
+#include "recordreader.h"
+#include "tests.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int RoundTripDays = 7;
+
+
+static char* inflateFile(const TCHAR* pszFilename, size_t cbMax, size_t* pcb, bool* pbFailed)
+{
+	// at most cbMax bytes of text, which is all of it when it matches
+	HANDLE h = CreateFile(pszFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return NULL;
+	BYTE* pBuffers = (BYTE*)malloc(GzipReader::InputSize + GzipReader::WindowSize);
+	char* pText = (char*)malloc(cbMax + 1);
+	GzipReader* pGzip = new GzipReader;
+	*pcb = 0;
+	if (pBuffers != NULL && pText != NULL) {
+		pGzip->attach(h, pBuffers, pBuffers + GzipReader::InputSize);
+		DWORD cbChunk;
+		while (*pcb <= cbMax && (cbChunk = pGzip->read((BYTE*)pText + *pcb, (DWORD)(cbMax + 1 - *pcb))) > 0)
+			*pcb += cbChunk;
+		*pbFailed = pGzip->failed();
+	}
+	else {
+		free(pText);
+		pText = NULL;
+	}
+	delete pGzip;
+	free(pBuffers);
+	CloseHandle(h);
+	return pText;
+}
+
+
+static void writeLines(Logger& out, const char* p, size_t cb)
+{
+	// one record per line, as actilog writes them
+	const char* const pEnd = p + cb;
+	while (p < pEnd) {
+		const char* pEol = (const char*)memchr(p, '\n', pEnd - p);
+		const char* pNext = pEol? pEol + 1 : pEnd;
+		out.writeRecord(p, pNext - p);
+		p = pNext;
+	}
+}
+
+
+static bool sameRecord(const LogRecord& a, const LogRecord& b)
+{
+	return a.type == b.type && a.wDay == b.wDay && a.wHour == b.wHour && a.wMinute == b.wMinute && a.wSecond == b.wSecond
+		&& a.args.cb == b.args.cb && memcmp(a.args.p, b.args.p, a.args.cb) == 0;
+}
+
+
+static int tailRecords(const TCHAR* pszCompressed, const LogFile& plain, ULONGLONG ullOffset)
+{
+	// how many records are read from the offset on, or -1 unless they
+	// are the last ones of the plain log; the second pass compares them
+	Arena arena;
+	RecordReader reader(arena);
+	int nRecords = 0;
+	for (int nPass = 0; nPass < 2; ++nPass) {
+		arena.reset();
+		if (!reader.open(pszCompressed) || !reader.isCompressed() || !reader.seek(ullOffset))
+			return -1;
+		const int iFirst = plain.size() - nRecords;
+		int i = 0;
+		bool bSame = true;
+		UINT n;
+		while ((n = reader.next()) > 0) {
+			for (UINT j = 0; j < n; ++j, ++i)
+				if (nPass == 1)
+					bSame = bSame && iFirst + i >= 0 && iFirst + i < plain.size() && sameRecord(reader.record(j).rec, plain[iFirst + i]);
+		}
+		const bool bFailed = reader.failed();
+		reader.close();
+		if (bFailed || !bSame)
+			return -1;
+		nRecords = i;
+	}
+	return nRecords;
+}
+
+
+bool testGzipMembers()
+{
+	// sample.log.gz holds sample.log in three members, one of each block
+	// type: dynamic codes under a file name, as gzip writes, stored, and
+	// fixed codes; a flipped bit in a CRC is found
+	TCHAR szPlain[MAX_PATH];
+	TCHAR szCompressed[MAX_PATH];
+	TCHAR szCorrupt[MAX_PATH];
+	dataFile(szPlain, TEXT("sample.log"));
+	dataFile(szCompressed, TEXT("sample.log.gz"));
+	testFile(szCorrupt, TEXT("corrupt.log.gz"));
+	LogFile plain;
+	CHECK(plain.load(szPlain));
+	CHECK(GzipReader::isGzipFile(szCompressed));
+	CHECK(!GzipReader::isGzipFile(szPlain));
+	size_t cbText;
+	bool bFailed = true;
+	char* pText = inflateFile(szCompressed, plain.bytes(), &cbText, &bFailed);
+	const bool bSame = pText != NULL && cbText == plain.bytes() && memcmp(pText, plain.data(), cbText) == 0;
+	free(pText);
+	CHECK(bSame);
+	CHECK(!bFailed);
+	CHECK(tailRecords(szCompressed, plain, 0) == plain.size());
+	size_t cbCompressed;
+	char* pCompressed = readFile(szCompressed, &cbCompressed);
+	CHECK(pCompressed != NULL);
+	pCompressed[cbCompressed - 8] ^= 1;
+	const bool bWritten = writeFile(szCorrupt, pCompressed, cbCompressed);
+	free(pCompressed);
+	CHECK(bWritten);
+	pText = inflateFile(szCorrupt, plain.bytes(), &cbText, &bFailed);
+	free(pText);
+	CHECK(bFailed);
+	return true;
+}
+
+
+bool testGzipRoundTrip()
+{
+	// a week of actigen output written through Logger --gzip --index: it
+	// inflates to the same text, reading from an indexed member gives
+	// the rest of the log, and the index of a compressed log is neither
+	// rebuilt nor scanned for when it is missing
+	CHECK(generateLogs(TEXT("gzip"), 1, RoundTripDays));
+	TCHAR szPlain[MAX_PATH];
+	TCHAR szCompressed[MAX_PATH];
+	TCHAR szIndex[MAX_PATH];
+	testFile(szPlain, TEXT("gzip\\host0000.log"));
+	testFile(szCompressed, TEXT("gzip\\host0000.log.gz"));
+	_sntprintf(szIndex, MAX_PATH, TEXT("%s%s"), szCompressed, LogIndex::Extension);
+	LogFile plain;
+	CHECK(plain.load(szPlain));
+	Logger out;
+	out.setCompression(true);
+	out.setIndex(1);
+	CHECK(out.open(true, szCompressed));
+	writeLines(out, plain.data(), plain.bytes());
+	out.close();
+	size_t cbText;
+	bool bFailed = true;
+	char* pText = inflateFile(szCompressed, plain.bytes(), &cbText, &bFailed);
+	const bool bSame = pText != NULL && cbText == plain.bytes() && memcmp(pText, plain.data(), cbText) == 0;
+	free(pText);
+	CHECK(bSame);
+	CHECK(!bFailed);
+	// the last entry points at the last member, well into the file
+	ULONGLONG ullOffset;
+	CHECK(LogIndex::lookup(szCompressed, ~0ULL, &ullOffset));
+	CHECK(ullOffset > 0);
+	size_t cbCompressed;
+	char* pCompressed = readFile(szCompressed, &cbCompressed);
+	CHECK(pCompressed != NULL);
+	const bool bMember = ullOffset < cbCompressed && GzipReader::isGzip(pCompressed + ullOffset, cbCompressed - (size_t)ullOffset);
+	free(pCompressed);
+	CHECK(bMember);
+	CHECK(tailRecords(szCompressed, plain, 0) == plain.size());
+	const int nTail = tailRecords(szCompressed, plain, ullOffset);
+	CHECK(nTail > 0);
+	CHECK(nTail < plain.size());
+	CHECK(DeleteFile(szIndex));
+	LogIndex index;
+	CHECK(!index.open(szCompressed, 1, false, cbCompressed));
+	CHECK(!LogIndex::rebuild(szCompressed, 1));
+	CHECK(GetFileAttributes(szIndex) == INVALID_FILE_ATTRIBUTES);
+	return true;
+}
+
+
+bool testGzipAppend()
+{
+	// Logger appends gzip members only to a compressed log and text only
+	// to a plain one, and overwriting a longer compressed log leaves none
+	// of its members behind
+	TCHAR szSample[MAX_PATH];
+	TCHAR szPlain[MAX_PATH];
+	TCHAR szCompressed[MAX_PATH];
+	dataFile(szSample, TEXT("sample.log"));
+	testFile(szPlain, TEXT("append.log"));
+	testFile(szCompressed, TEXT("append.log.gz"));
+	LogFile sample;
+	CHECK(sample.load(szSample));
+	// the first two lines, one per run
+	const char* pSecond = (const char*)memchr(sample.data(), '\n', sample.bytes());
+	CHECK(pSecond != NULL);
+	++pSecond;
+	const char* pThird = (const char*)memchr(pSecond, '\n', sample.data() + sample.bytes() - pSecond);
+	CHECK(pThird != NULL);
+	++pThird;
+	const size_t cbFirst = pSecond - sample.data();
+	const size_t cbTwo = pThird - sample.data();
+	Logger out;
+	CHECK(out.open(true, szPlain));
+	writeLines(out, sample.data(), sample.bytes());
+	out.close();
+	out.setCompression(true);
+	CHECK(!out.open(false, szPlain));
+	CHECK(!GzipReader::isGzipFile(szPlain));
+	CHECK(out.open(true, szCompressed));
+	writeLines(out, sample.data(), sample.bytes());
+	out.close();
+	out.setCompression(false);
+	CHECK(!out.open(false, szCompressed));
+	out.setCompression(true);
+	CHECK(out.open(true, szCompressed));
+	writeLines(out, sample.data(), cbFirst);
+	out.close();
+	CHECK(out.open(false, szCompressed));
+	writeLines(out, pSecond, cbTwo - cbFirst);
+	out.close();
+	size_t cbText;
+	bool bFailed = true;
+	char* pText = inflateFile(szCompressed, sample.bytes(), &cbText, &bFailed);
+	const bool bSame = pText != NULL && cbText == cbTwo && memcmp(pText, sample.data(), cbText) == 0;
+	free(pText);
+	CHECK(bSame);
+	CHECK(!bFailed);
+	return true;
+}
@@ -0,0 +1,408 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "clock.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+static TCHAR szTestDir[MAX_PATH] = { 0 };
+static TCHAR szToolDir[MAX_PATH] = { 0 };
+
+
+void testFailed(const char* pszFile, int nLine, const char* pszExpr)
+{
+	printf("    %s(%d): check failed: %s\n", pszFile, nLine, pszExpr);
+}
+
+
+void testNote(const char* pszFormat, ...)
+{
+	va_list argp;
+	va_start(argp, pszFormat);
+	printf("    ");
+	vprintf(pszFormat, argp);
+	printf("\n");
+	va_end(argp);
+}
+
+
+void benchResult(const char* pszWhat, double fValue, const char* pszUnit)
+{
+	printf("    %-44s %12.1lf %s\n", pszWhat, fValue, pszUnit);
+}
+
+
+double secondsSince(ULONGLONG ullStartNs)
+{
+	return 1e-9 * (double)(Clock::now() - ullStartNs);
+}
+
+
+bool setupTestDir()
+{
+	// the tools are expected next to actitest.exe, as the solution builds them
+	GetModuleFileName(NULL, szToolDir, MAX_PATH);
+	TCHAR* pSlash = _tcsrchr(szToolDir, TEXT('\\'));
+	if (pSlash)
+		*pSlash = 0;
+	TCHAR szTemp[MAX_PATH];
+	if (GetTempPath(MAX_PATH, szTemp) == 0)
+		return false;
+	_sntprintf(szTestDir, MAX_PATH, TEXT("%sactitest-%lu"), szTemp, GetCurrentProcessId());
+	return CreateDirectory(szTestDir, NULL) != FALSE;
+}
+
+
+static void removeTree(const TCHAR* pszDir)
+{
+	TCHAR szPattern[MAX_PATH];
+	_sntprintf(szPattern, MAX_PATH, TEXT("%s\\*"), pszDir);
+	WIN32_FIND_DATA fd;
+	HANDLE hFind = FindFirstFile(szPattern, &fd);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if (_tcscmp(fd.cFileName, TEXT(".")) == 0 || _tcscmp(fd.cFileName, TEXT("..")) == 0)
+				continue;
+			TCHAR szPath[MAX_PATH];
+			_sntprintf(szPath, MAX_PATH, TEXT("%s\\%s"), pszDir, fd.cFileName);
+			if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				removeTree(szPath);
+			else
+				DeleteFile(szPath);
+		}
+		while (FindNextFile(hFind, &fd));
+		FindClose(hFind);
+	}
+	RemoveDirectory(pszDir);
+}
+
+
+void removeTestDir()
+{
+	if (szTestDir[0] != 0)
+		removeTree(szTestDir);
+}
+
+
+const TCHAR* testDir()
+{
+	return szTestDir;
+}
+
+
+void testFile(TCHAR* pszDest, const TCHAR* pszName)
+{
+	_sntprintf(pszDest, MAX_PATH, TEXT("%s\\%s"), szTestDir, pszName);
+}
+
+
+void dataFile(TCHAR* pszDest, const TCHAR* pszName)
+{
+	// checked in next to the sources; actitest.exe is built into
+	// the configuration directory beside them
+	_sntprintf(pszDest, MAX_PATH, TEXT("%s\\..\\actitest\\data\\%s"), szToolDir, pszName);
+}
+
+
+char* readFile(const TCHAR* pszFilename, size_t* pcb)
+{
+	// shares everything: the tool under test may still be writing to it
+	HANDLE h = CreateFile(pszFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return NULL;
+	char* pData = NULL;
+	LARGE_INTEGER liSize;
+	if (GetFileSizeEx(h, &liSize) && liSize.QuadPart < 0x40000000) {
+		pData = (char*)malloc((size_t)liSize.QuadPart + 1);
+		DWORD cbRead = 0;
+		if (pData != NULL && ReadFile(h, pData, (DWORD)liSize.QuadPart, &cbRead, NULL)) {
+			pData[cbRead] = 0;
+			*pcb = cbRead;
+		}
+		else {
+			free(pData);
+			pData = NULL;
+		}
+	}
+	CloseHandle(h);
+	return pData;
+}
+
+
+bool writeFile(const TCHAR* pszFilename, const void* pData, size_t cb)
+{
+	HANDLE h = CreateFile(pszFilename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+	DWORD cbWritten = 0;
+	const BOOL bOk = WriteFile(h, pData, (DWORD)cb, &cbWritten, NULL);
+	CloseHandle(h);
+	return bOk && cbWritten == cb;
+}
+
+
+int runTool(const TCHAR* pszTool, const TCHAR* pszArgs, DWORD dwTimeout)
+{
+	// the exit code, or -1 if the tool did not start or did not finish in time
+	Child child;
+	if (!child.start(pszTool, pszArgs))
+		return -1;
+	DWORD dwExitCode;
+	if (!child.wait(dwTimeout, &dwExitCode)) {
+		child.kill();
+		return -1;
+	}
+	return (int)dwExitCode;
+}
+
+
+bool generateLogs(const TCHAR* pszName, int nHosts, int nDays)
+{
+	// actigen output is the same for the same arguments on every machine
+	TCHAR szDir[MAX_PATH];
+	testFile(szDir, pszName);
+	TCHAR szArgs[MAX_PATH + 64];
+	_sntprintf(szArgs, MAX_PATH + 64, TEXT("-o \"%s\" -n %d -d %d"), szDir, nHosts, nDays);
+	return runTool(TEXT("actigen"), szArgs, 600000) == EXIT_SUCCESS;
+}
+
+
+bool repeatFile(const TCHAR* pszSource, const TCHAR* pszDest, ULONGLONG cbMin, ULONGLONG* pcbDest)
+{
+	// the source over and over, for inputs that would take actigen far
+	// too long to generate; a log of whole lines stays one
+	size_t cb;
+	char* pData = readFile(pszSource, &cb);
+	if (pData == NULL)
+		return false;
+	HANDLE h = CreateFile(pszDest, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	bool bOk = h != INVALID_HANDLE_VALUE && cb > 0;
+	ULONGLONG cbWritten = 0;
+	while (bOk && cbWritten < cbMin) {
+		DWORD cbChunk = 0;
+		bOk = WriteFile(h, pData, (DWORD)cb, &cbChunk, NULL) && cbChunk == cb;
+		cbWritten += cbChunk;
+	}
+	if (h != INVALID_HANDLE_VALUE)
+		CloseHandle(h);
+	free(pData);
+	if (pcbDest != NULL)
+		*pcbDest = cbWritten;
+	return bOk;
+}
+
+
+void injectKeys(WORD wVk, int nTimes)
+{
+	// paced, so that the low-level hooks see them as separate presses
+	for (int i = 0; i < nTimes; ++i) {
+		INPUT aInput[2];
+		ZeroMemory(aInput, sizeof(aInput));
+		aInput[0].type = INPUT_KEYBOARD;
+		aInput[0].ki.wVk = wVk;
+		aInput[1] = aInput[0];
+		aInput[1].ki.dwFlags = KEYEVENTF_KEYUP;
+		SendInput(2, aInput, sizeof(INPUT));
+		Sleep(10);
+	}
+}
+
+
+void injectMoves(int nPixels, int nTimes)
+{
+	// back and forth, which leaves the cursor where it was
+	for (int i = 0; i < nTimes; ++i) {
+		INPUT input;
+		ZeroMemory(&input, sizeof(input));
+		input.type = INPUT_MOUSE;
+		input.mi.dx = (i % 2 == 0)? nPixels : -nPixels;
+		input.mi.dwFlags = MOUSEEVENTF_MOVE;
+		SendInput(1, &input, sizeof(INPUT));
+		Sleep(10);
+	}
+}
+
+
+void waitForQuietInterval(int nInterval, int nSecs)
+{
+	// intervals end on UTC multiples of the interval; a test that needs
+	// its counters to stay pending must not run into the end of one
+	SYSTEMTIME t;
+	GetSystemTime(&t);
+	const int nInto = ((t.wHour * 60 + t.wMinute) * 60 + t.wSecond) % nInterval;
+	if (nInterval - nInto < nSecs)
+		Sleep(1000 * (nInterval - nInto + 1));
+}
+
+
+LogFile::LogFile()
+	: pData(NULL)
+	, cbData(0)
+	, aRecords(NULL)
+	, nRecords(0)
+{
+	ZeroMemory(anKeys, sizeof(anKeys));
+}
+
+
+LogFile::~LogFile()
+{
+	clear();
+}
+
+
+void LogFile::clear()
+{
+	free(aRecords);
+	aRecords = NULL;
+	free(pData);
+	pData = NULL;
+	cbData = 0;
+	nRecords = 0;
+	ZeroMemory(anKeys, sizeof(anKeys));
+}
+
+
+bool LogFile::load(const TCHAR* pszFilename)
+{
+	// lines that do not parse, e.g. a half-written last one, are skipped
+	clear();
+	pData = readFile(pszFilename, &cbData);
+	if (pData == NULL)
+		return false;
+	int nLines = 1;
+	for (size_t i = 0; i < cbData; ++i)
+		if (pData[i] == '\n')
+			++nLines;
+	aRecords = (LogRecord*)malloc(nLines * sizeof(LogRecord));
+	if (aRecords == NULL)
+		return false;
+	const char* p = pData;
+	const char* const pEnd = pData + cbData;
+	int anLineKeys[256];
+	while (p < pEnd) {
+		const char* pEol = (const char*)memchr(p, '\n', pEnd - p);
+		const size_t cbLine = (pEol? pEol : pEnd) - p;
+		LogRecord& r = aRecords[nRecords];
+		if (LogParser::parse(p, cbLine, &r, anLineKeys)) {
+			if (r.type == RecordKeyStat)
+				for (int i = 0; i < r.nCount; ++i)
+					anKeys[i] += anLineKeys[i];
+			++nRecords;
+		}
+		p += cbLine + 1;
+	}
+	return true;
+}
+
+
+int LogFile::find(RecordType type, int nFrom) const
+{
+	for (int i = nFrom; i < nRecords; ++i)
+		if (aRecords[i].type == type)
+			return i;
+	return -1;
+}
+
+
+int LogFile::count(RecordType type) const
+{
+	int n = 0;
+	for (int i = 0; i < nRecords; ++i)
+		if (aRecords[i].type == type)
+			++n;
+	return n;
+}
+
+
+Child::Child()
+{
+	ZeroMemory(&pi, sizeof(pi));
+}
+
+
+Child::~Child()
+{
+	if (isRunning())
+		kill();
+	if (pi.hProcess)
+		CloseHandle(pi.hProcess);
+}
+
+
+bool Child::start(const TCHAR* pszTool, const TCHAR* pszArgs)
+{
+	TCHAR szCmdLine[4096];
+	_sntprintf(szCmdLine, 4096, TEXT("\"%s\\%s.exe\" %s"), szToolDir, pszTool, pszArgs);
+	szCmdLine[4095] = 0;
+	STARTUPINFO si;
+	ZeroMemory(&si, sizeof(si));
+	si.cb = sizeof(si);
+	if (!CreateProcess(NULL, szCmdLine, NULL, NULL, FALSE, CREATE_NEW_PROCESS_GROUP, NULL, NULL, &si, &pi)) {
+		ZeroMemory(&pi, sizeof(pi));
+		return false;
+	}
+	CloseHandle(pi.hThread);
+	pi.hThread = NULL;
+	return true;
+}
+
+
+bool Child::wait(DWORD dwTimeout, DWORD* pdwExitCode)
+{
+	if (pi.hProcess == NULL || WaitForSingleObject(pi.hProcess, dwTimeout) != WAIT_OBJECT_0)
+		return false;
+	if (pdwExitCode)
+		GetExitCodeProcess(pi.hProcess, pdwExitCode);
+	return true;
+}
+
+
+bool Child::interrupt()
+{
+	// what Ctrl-C is to a console program in a process group of its own
+	return GenerateConsoleCtrlEvent(CTRL_BREAK_EVENT, pi.dwProcessId) != FALSE;
+}
+
+
+void Child::kill()
+{
+	// as if it had crashed: no handler runs, nothing is flushed
+	TerminateProcess(pi.hProcess, EXIT_FAILURE);
+	WaitForSingleObject(pi.hProcess, INFINITE);
+}
+
+
+bool Child::isRunning() const
+{
+	return pi.hProcess != NULL && WaitForSingleObject(pi.hProcess, 0) == WAIT_TIMEOUT;
+}
+
+
+bool waitForRecord(const TCHAR* pszFilename, RecordType type, DWORD dwTimeout)
+{
+	const DWORD dwStart = GetTickCount();
+	for (;;) {
+		LogFile log;
+		if (log.load(pszFilename) && log.find(type) >= 0)
+			return true;
+		if (GetTickCount() - dwStart > dwTimeout)
+			return false;
+		Sleep(100);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include "logparse.h"
+
+/// Checks a condition inside a test; a failed check reports the
+/// expression and where it is and fails the test right away.
+#define CHECK(x) \
+	do { if (!(x)) { testFailed(__FILE__, __LINE__, #x); return false; } } while (0)
+
+typedef bool (*TestProc)();
+
+struct TestCase {
+	const char* pszName;
+	TestProc proc;
+	bool bBench;
+};
+
+
+void testFailed(const char* pszFile, int nLine, const char* pszExpr);
+void testNote(const char* pszFormat, ...);
+void benchResult(const char* pszWhat, double fValue, const char* pszUnit);
+double secondsSince(ULONGLONG ullStartNs);
+
+bool setupTestDir();
+void removeTestDir();
+const TCHAR* testDir();
+void testFile(TCHAR* pszDest, const TCHAR* pszName);
+void dataFile(TCHAR* pszDest, const TCHAR* pszName);
+char* readFile(const TCHAR* pszFilename, size_t* pcb);
+bool writeFile(const TCHAR* pszFilename, const void* pData, size_t cb);
+int runTool(const TCHAR* pszTool, const TCHAR* pszArgs, DWORD dwTimeout);
+bool generateLogs(const TCHAR* pszName, int nHosts, int nDays);
+bool repeatFile(const TCHAR* pszSource, const TCHAR* pszDest, ULONGLONG cbMin, ULONGLONG* pcbDest = NULL);
+void injectKeys(WORD wVk, int nTimes);
+void injectMoves(int nPixels, int nTimes);
+void waitForQuietInterval(int nInterval, int nSecs);
+
+
+/// A text log read in full and parsed line by line, for checking what
+/// the tools wrote. The records point into the loaded data.
+class LogFile {
+public:
+	LogFile();
+	~LogFile();
+	bool load(const TCHAR* pszFilename);
+	int size() const { return nRecords; }
+	const LogRecord& operator[](int i) const { return aRecords[i]; }
+	int find(RecordType type, int nFrom = 0) const;
+	int count(RecordType type) const;
+	int keys(int vk) const { return anKeys[vk]; }
+	const char* data() const { return pData; }
+	size_t bytes() const { return cbData; }
+
+private:
+	char* pData;
+	size_t cbData;
+	LogRecord* aRecords;
+	int nRecords;
+	int anKeys[256];
+	void clear();
+};
+
+
+/// One of the tools started by a test. It runs in a process group of its
+/// own, so that a Ctrl-Break reaches it and nothing else, and shares the
+/// console of actitest.
+class Child {
+public:
+	Child();
+	~Child();
+	bool start(const TCHAR* pszTool, const TCHAR* pszArgs);
+	bool wait(DWORD dwTimeout, DWORD* pdwExitCode = NULL);
+	bool interrupt();
+	void kill();
+	bool isRunning() const;
+
+private:
+	PROCESS_INFORMATION pi;
+};
+
+
+bool waitForRecord(const TCHAR* pszFilename, RecordType type, DWORD dwTimeout);
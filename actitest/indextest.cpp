@@ -0,0 +1,124 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "arena.h"
+#include "log.h"
+#include "logindex.h"
+#include "recordreader.h"
+#include "tests.h"
+
+static const UINT IndexEvery = 64;
+static const int LiveLines = 40;
+static const DWORD LiveLineDelay = 75;
+
+
+static size_t lineLength(const LogRecord& r)
+{
+	return r.args.p + r.args.cb - (r.name.p - 20);
+}
+
+
+static bool checkSeek(const TCHAR* pszLog, const LogFile& log, int iTarget, bool bDirect)
+{
+	// reading from the offset found for the time of line iTarget must get
+	// to that very line after less than one index step
+	ULONGLONG ullTarget;
+	CHECK(LogParser::toUtc(log[iTarget], &ullTarget));
+	ULONGLONG ullOffset;
+	CHECK(LogIndex::lookup(pszLog, ullTarget - 1, &ullOffset));
+	Arena arena;
+	RecordReader reader(arena);
+	CHECK(reader.open(pszLog, 256, bDirect));
+	CHECK(reader.seek(ullOffset));
+	UINT nSkipped = 0;
+	for (;;) {
+		const UINT n = reader.next();
+		CHECK(n > 0);
+		for (UINT i = 0; i < n; ++i) {
+			const LogRecord& r = reader.record(i).rec;
+			ULONGLONG ullUtc;
+			CHECK(LogParser::toUtc(r, &ullUtc));
+			if (ullUtc < ullTarget) {
+				++nSkipped;
+				continue;
+			}
+			CHECK(nSkipped <= IndexEvery);
+			CHECK(lineLength(r) == lineLength(log[iTarget]));
+			CHECK(memcmp(r.name.p - 20, log[iTarget].name.p - 20, lineLength(r)) == 0);
+			return true;
+		}
+	}
+}
+
+
+bool testIndexSeek()
+{
+	// the time index of an actigen log takes RecordReader straight to the
+	// first line of a given second, buffered and unbuffered
+	CHECK(generateLogs(TEXT("index"), 1, 3));
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("index\\host0000.log"));
+	CHECK(LogIndex::rebuild(szLog, IndexEvery));
+	LogFile log;
+	CHECK(log.load(szLog));
+	CHECK(log.size() > 10 * (int)IndexEvery);
+	const int aTargets[] = { 0, log.size() / 3, log.size() / 2, log.size() - 1 };
+	for (int i = 0; i < sizeof(aTargets) / sizeof(aTargets[0]); ++i) {
+		// the first line of its second
+		int iTarget = aTargets[i];
+		ULONGLONG ullUtc, ullPrevious;
+		while (iTarget > 0 && LogParser::toUtc(log[iTarget], &ullUtc) && LogParser::toUtc(log[iTarget - 1], &ullPrevious) && ullPrevious == ullUtc)
+			--iTarget;
+		CHECK(checkSeek(szLog, log, iTarget, false));
+		CHECK(checkSeek(szLog, log, iTarget, true));
+	}
+	return true;
+}
+
+
+bool testIndexLive()
+{
+	// the entries Logger records while writing are true UTC, not converted
+	// from the local time stamps; the stamps must convert to the same
+	// scale, or seeking to a second would land after its first line
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("live.log"));
+	Logger out;
+	out.setIndex(1);
+	CHECK(out.open(true, szLog));
+	for (int i = 0; i < LiveLines; ++i) {
+		out.logWithTimestamp(TEXT("CLICK %d"), i + 1);
+		Sleep(LiveLineDelay);
+	}
+	out.close();
+	LogFile log;
+	CHECK(log.load(szLog));
+	CHECK(log.size() == LiveLines);
+	int nSeconds = 0;
+	ULONGLONG ullPrevious = 0;
+	for (int i = 0; i < log.size(); ++i) {
+		ULONGLONG ullUtc;
+		CHECK(LogParser::toUtc(log[i], &ullUtc));
+		if (i > 0 && ullUtc == ullPrevious)
+			continue;
+		ullPrevious = ullUtc;
+		++nSeconds;
+		CHECK(checkSeek(szLog, log, i, false));
+	}
+	CHECK(nSeconds > 1);
+	return true;
+}
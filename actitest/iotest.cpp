@@ -0,0 +1,138 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "clock.h"
+#include "log.h"
+#include "arena.h"
+#include "recordreader.h"
+#include "tests.h"
+
+// every line is flushed to disk, as actilog flushes it
+static const int KeyStatLines = 200;
+static const int BenchLines = 2000;
+static const ULONGLONG BenchBytes = 2ULL * 1024 * 1024 * 1024;
+
+
+static IO_COUNTERS ioCounters()
+{
+	IO_COUNTERS io;
+	ZeroMemory(&io, sizeof(io));
+	GetProcessIoCounters(GetCurrentProcess(), &io);
+	return io;
+}
+
+
+static void logKeyStat(Logger& log, int i)
+{
+	// as actilog writes it: a fragment per count
+	log.logWithTimestampNoLF(TEXT("KEYSTAT "));
+	for (int vk = 0; vk < 256; ++vk)
+		log.log(vk < 255? TEXT("%d,") : TEXT("%d"), (vk + i) % 10);
+	log.flush();
+}
+
+
+bool testLoggerWrites()
+{
+	// each line reaches the file with a single WriteFile, however many
+	// fragments it was logged in
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("writes.log"));
+	Logger log;
+	CHECK(log.open(true, szLog));
+	const IO_COUNTERS ioBefore = ioCounters();
+	for (int i = 0; i < KeyStatLines; ++i)
+		logKeyStat(log, i);
+	const IO_COUNTERS ioAfter = ioCounters();
+	log.close();
+	const ULONGLONG nWrites = ioAfter.WriteOperationCount - ioBefore.WriteOperationCount;
+	CHECK(nWrites == KeyStatLines);
+	LogFile written;
+	CHECK(written.load(szLog));
+	CHECK(written.count(RecordKeyStat) == KeyStatLines);
+	return true;
+}
+
+
+bool benchLoggerWrites()
+{
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("writes-bench.log"));
+	Logger log;
+	CHECK(log.open(true, szLog));
+	const IO_COUNTERS ioBefore = ioCounters();
+	const ULONGLONG ullStartNs = Clock::now();
+	for (int i = 0; i < BenchLines; ++i)
+		logKeyStat(log, i);
+	const double fSecs = secondsSince(ullStartNs);
+	const IO_COUNTERS ioAfter = ioCounters();
+	log.close();
+	const double fLines = BenchLines;
+	benchResult("logger KEYSTAT lines", fLines / fSecs, "lines/sec");
+	benchResult("logger writes per line", (double)(ioAfter.WriteOperationCount - ioBefore.WriteOperationCount) / fLines, "writes");
+	benchResult("logger other I/O per line", (double)(ioAfter.OtherOperationCount - ioBefore.OtherOperationCount) / fLines, "ops");
+	return true;
+}
+
+
+static bool benchRead(const TCHAR* pszLog, bool bDirect, ULONGLONG cbLog, const char* pszWhat, double* pfRecords)
+{
+	Arena arena;
+	RecordReader reader(arena);
+	CHECK(reader.open(pszLog, RecordReader::DefaultBatchSize, bDirect));
+	if (reader.isDirect() != bDirect)
+		testNote("cannot read '%s' unbuffered, reading it buffered", pszLog);
+	const IO_COUNTERS ioBefore = ioCounters();
+	const ULONGLONG ullStartNs = Clock::now();
+	double fRecords = 0;
+	UINT n;
+	while ((n = reader.next()) > 0)
+		fRecords += n;
+	const double fSecs = secondsSince(ullStartNs);
+	const IO_COUNTERS ioAfter = ioCounters();
+	CHECK(!reader.failed());
+	reader.close();
+	*pfRecords = fRecords;
+	benchResult(pszWhat, (double)cbLog / fSecs / (1024 * 1024), "MB/sec");
+	benchResult(pszWhat, fRecords / fSecs, "records/sec");
+	benchResult(pszWhat, (double)(ioAfter.ReadOperationCount - ioBefore.ReadOperationCount), "reads");
+	return true;
+}
+
+
+bool benchReaderDirect()
+{
+	// the same 2 GB read through the file cache and past it. Right after
+	// writing, much of the file is still cached, which only the buffered
+	// read profits from; the read counts compare the calls either way
+	CHECK(generateLogs(TEXT("direct-bench"), 1, 14));
+	TCHAR szLog[MAX_PATH];
+	TCHAR szBig[MAX_PATH];
+	testFile(szLog, TEXT("direct-bench\\host0000.log"));
+	testFile(szBig, TEXT("direct-bench\\big.log"));
+	ULONGLONG cbBig;
+	CHECK(repeatFile(szLog, szBig, BenchBytes, &cbBig));
+	double fBuffered = 0;
+	double fDirect = 0;
+	const bool bBuffered = benchRead(szBig, false, cbBig, "reader buffered", &fBuffered);
+	const bool bDirect = bBuffered && benchRead(szBig, true, cbBig, "reader --direct", &fDirect);
+	DeleteFile(szBig);
+	CHECK(bBuffered);
+	CHECK(bDirect);
+	CHECK(fDirect == fBuffered);
+	return true;
+}
@@ -0,0 +1,65 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "tests.h"
+
+static const int TestInterval = 3600;
+static const int KeyPresses = 20;
+static const int Moves = 10;
+static const DWORD StartTimeout = 10000;
+static const DWORD CheckpointWait = 7000;
+static const DWORD StopTimeout = 5000;
+
+
+bool testJournalKill()
+{
+	// counters that only made it into the journal before the process was
+	// killed come back as a RECOVER record on the next start
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("kill.log"));
+	TCHAR szArgs[MAX_PATH + 64];
+	_sntprintf(szArgs, MAX_PATH + 64, TEXT("-o \"%s\" -i %d -v"), szLog, TestInterval);
+	waitForQuietInterval(TestInterval, 60);
+	Child first;
+	CHECK(first.start(TEXT("actilog"), szArgs));
+	CHECK(waitForRecord(szLog, RecordClock, StartTimeout));
+	// the hooks are set right after the CLOCK anchor
+	Sleep(1000);
+	injectKeys(VK_F24, KeyPresses);
+	injectMoves(20, Moves);
+	Sleep(CheckpointWait);
+	first.kill();
+	Child second;
+	CHECK(second.start(TEXT("actilog"), szArgs));
+	CHECK(waitForRecord(szLog, RecordRecover, StartTimeout));
+	CHECK(second.interrupt());
+	DWORD dwExitCode;
+	CHECK(second.wait(StopTimeout, &dwExitCode));
+	CHECK(dwExitCode == EXIT_SUCCESS);
+	LogFile log;
+	CHECK(log.load(szLog));
+	const int iRecover = log.find(RecordRecover);
+	const int iBreak = log.find(RecordBreak, iRecover);
+	CHECK(iRecover >= 0 && iBreak > iRecover);
+	// the killed run never got to write an interval of its own
+	CHECK(log.find(RecordInterval) < 0 || log.find(RecordInterval) > iRecover);
+	CHECK(log.find(RecordPartial) > iRecover);
+	CHECK(log.keys(VK_F24) == KeyPresses);
+	const int iMove = log.find(RecordMove, iRecover);
+	CHECK(iMove > iRecover && iMove < iBreak && log[iMove].fValue > 0);
+	return true;
+}
@@ -0,0 +1,143 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <winsock2.h>
+#include <string.h>
+#include "harness.h"
+#include "clock.h"
+#include "tests.h"
+
+#pragma comment(lib, "ws2_32.lib")
+
+static const USHORT TestPort = 39091;
+static const int TestInterval = 2;
+static const int KeyPresses = 5;
+static const int Scrapes = 1000;
+static const DWORD StartTimeout = 10000;
+static const DWORD StopTimeout = 5000;
+static const int MaxResponse = 64 * 1024;
+
+
+static int scrape(char* pBuf, int cbBuf)
+{
+	// what curl http://127.0.0.1:port/metrics does: one GET on a fresh
+	// connection, read until the server closes it; the length or -1
+	SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (sock == INVALID_SOCKET)
+		return -1;
+	DWORD dwTimeout = 5000;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&dwTimeout, sizeof(dwTimeout));
+	sockaddr_in addr;
+	ZeroMemory(&addr, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(TestPort);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int cb = -1;
+	static const char Request[] = "GET /metrics HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept: */*\r\n\r\n";
+	if (connect(sock, (const sockaddr*)&addr, sizeof(addr)) == 0 && send(sock, Request, sizeof(Request) - 1, 0) == sizeof(Request) - 1) {
+		cb = 0;
+		int n;
+		while (cb < cbBuf - 1 && (n = recv(sock, pBuf + cb, cbBuf - 1 - cb, 0)) > 0)
+			cb += n;
+		pBuf[cb] = 0;
+	}
+	closesocket(sock);
+	return cb;
+}
+
+
+static bool startLogger(Child& child, const TCHAR* pszName)
+{
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, pszName);
+	TCHAR szArgs[MAX_PATH + 64];
+	_sntprintf(szArgs, MAX_PATH + 64, TEXT("-o \"%s\" -i %d --metrics-port %u"), szLog, TestInterval, TestPort);
+	CHECK(child.start(TEXT("actilog"), szArgs));
+	CHECK(waitForRecord(szLog, RecordClock, StartTimeout));
+	return true;
+}
+
+
+static bool stopLogger(Child& child)
+{
+	CHECK(child.interrupt());
+	DWORD dwExitCode;
+	CHECK(child.wait(StopTimeout, &dwExitCode));
+	CHECK(dwExitCode == EXIT_SUCCESS);
+	return true;
+}
+
+
+bool testMetricsScrape()
+{
+	// after an interval with key presses the endpoint serves them as an
+	// OpenMetrics counter, and the exposition ends with '# EOF'
+	WSADATA wsaData;
+	CHECK(WSAStartup(MAKEWORD(2, 2), &wsaData) == 0);
+	Child child;
+	CHECK(startLogger(child, TEXT("metrics.log")));
+	Sleep(1000);
+	injectKeys(VK_F24, KeyPresses);
+	Sleep(1000 * (2 * TestInterval + 1));
+	char* pResponse = (char*)malloc(MaxResponse);
+	CHECK(pResponse != NULL);
+	const int cb = scrape(pResponse, MaxResponse);
+	const bool bStopped = stopLogger(child);
+	char szKeys[64];
+	_snprintf(szKeys, sizeof(szKeys), "\nactilog_key_presses_total{vk=\"%d\"} %d\n", VK_F24, KeyPresses);
+	const char* pBody = cb > 0? strstr(pResponse, "\r\n\r\n") : NULL;
+	const bool bOk = cb > 0
+		&& strncmp(pResponse, "HTTP/1.1 200 OK\r\n", 17) == 0
+		&& strstr(pResponse, "\r\nContent-Type: application/openmetrics-text") != NULL
+		&& pBody != NULL
+		&& strstr(pBody, "\n# TYPE actilog_key_presses counter\n") != NULL
+		&& strstr(pBody, szKeys) != NULL
+		&& strstr(pBody, "\nactilog_interval_seconds 2\n") != NULL
+		&& cb >= 6 && strcmp(pResponse + cb - 6, "# EOF\n") == 0;
+	if (!bOk && cb > 0)
+		testNote("%s", pResponse);
+	free(pResponse);
+	WSACleanup();
+	CHECK(bStopped);
+	CHECK(bOk);
+	return true;
+}
+
+
+bool benchMetricsScrape()
+{
+	// scrapes are served from the prepared response on actilog's message
+	// loop, one after the other
+	WSADATA wsaData;
+	CHECK(WSAStartup(MAKEWORD(2, 2), &wsaData) == 0);
+	Child child;
+	CHECK(startLogger(child, TEXT("metrics-bench.log")));
+	char* pResponse = (char*)malloc(MaxResponse);
+	CHECK(pResponse != NULL);
+	int nOk = 0;
+	const ULONGLONG ullStartNs = Clock::now();
+	for (int i = 0; i < Scrapes; ++i)
+		if (scrape(pResponse, MaxResponse) > 0)
+			++nOk;
+	const double fSecs = secondsSince(ullStartNs);
+	free(pResponse);
+	WSACleanup();
+	CHECK(stopLogger(child));
+	CHECK(nOk == Scrapes);
+	benchResult("scrapes", Scrapes / fSecs, "per sec");
+	benchResult("latency", 1e6 * fSecs / Scrapes, "usecs");
+	return true;
+}
@@ -0,0 +1,63 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "parsecheck.h"
+#include "logparse.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int KeyGuard = 0x5a5a5a5a;
+
+
+static bool within(const TextSpan& s, const char* p, size_t cb)
+{
+	return s.p >= p && s.cb <= cb && s.p + s.cb <= p + cb;
+}
+
+
+static bool isSane(const char* p, size_t cb)
+{
+	int anKeys[257];
+	anKeys[256] = KeyGuard;
+	LogRecord r;
+	if (!LogParser::parse(p, cb, &r, anKeys))
+		return anKeys[256] == KeyGuard;
+	if (anKeys[256] != KeyGuard || cb < 20 || p[19] != ' ')
+		return false;
+	if (r.name.p != p + 20 || !within(r.name, p, cb) || !within(r.args, p, cb))
+		return false;
+	if ((r.type == RecordKeyStat || r.type == RecordKeyClass) && (r.nCount < 0 || r.nCount > 256))
+		return false;
+	const char* pszName = LogParser::name(r.type);
+	if (r.type != RecordUnknown && (strlen(pszName) != r.name.cb || memcmp(pszName, r.name.p, r.name.cb) != 0))
+		return false;
+	// without an array the counts are skipped, not stored
+	LogRecord rNoKeys;
+	return LogParser::parse(p, cb, &rNoKeys, NULL) && rNoKeys.type == r.type
+		&& (r.type != RecordKeyStat || rNoKeys.nCount == 0);
+}
+
+
+bool checkParse(const char* pLine, size_t cb)
+{
+	char* p = (char*)malloc(cb > 0? cb : 1);
+	if (p == NULL)
+		return false;
+	memcpy(p, pLine, cb);
+	const bool bOk = isSane(p, cb);
+	free(p);
+	return bOk;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+
+/// Parses a line the way RecordReader does and checks what has to hold
+/// for any input whatsoever: the name and the arguments lie within the
+/// line, only a whole time stamp is accepted, no more than 256 counts
+/// are stored, and the name of a known type is the one it was given.
+/// The line is copied to a buffer of exactly its length first, so that
+/// a read past its end is caught by the address sanitizer or the page
+/// heap. Shared by the parse-mutations test and the libFuzzer target.
+bool checkParse(const char* pLine, size_t cb);
@@ -0,0 +1,130 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "clock.h"
+#include "parsecheck.h"
+#include "tests.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const int MutationsPerLine = 16;
+static const int BenchPasses = 20;
+static const char Replacements[] = " ,:-.()0123456789eE\r";
+
+
+static const char* lineEnd(const char* p, const char* pEnd)
+{
+	const char* pNewline = (const char*)memchr(p, '\n', pEnd - p);
+	return pNewline? pNewline : pEnd;
+}
+
+
+static DWORD nextRandom(DWORD& dwSeed)
+{
+	dwSeed = dwSeed * 1103515245 + 12345;
+	return dwSeed >> 8;
+}
+
+
+static bool mutateLine(const char* p, size_t cb, char* pCopy, DWORD& dwSeed)
+{
+	// every prefix, then a few bytes overwritten at a time by separators,
+	// digits or anything at all, some of them cut short at random
+	for (size_t cbCut = 0; cbCut <= cb; ++cbCut)
+		if (!checkParse(p, cbCut))
+			return false;
+	for (int i = 0; i < MutationsPerLine; ++i) {
+		memcpy(pCopy, p, cb);
+		const int nBytes = 1 + nextRandom(dwSeed) % 3;
+		for (int j = 0; j < nBytes && cb > 0; ++j) {
+			const DWORD dwPick = nextRandom(dwSeed);
+			pCopy[dwPick % cb] = (dwPick & 0x100)
+				? Replacements[(dwPick >> 9) % (sizeof(Replacements) - 1)]
+				: (char)(dwPick >> 9);
+		}
+		const size_t cbMutated = (i & 3) == 3 && cb > 0? nextRandom(dwSeed) % cb : cb;
+		if (!checkParse(pCopy, cbMutated))
+			return false;
+	}
+	return true;
+}
+
+
+bool testParseMutations()
+{
+	// a day of actigen output parses completely, and no line of it, cut
+	// or mangled, takes the parser outside the line or the key array
+	CHECK(generateLogs(TEXT("parse"), 1, 1));
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("parse\\host0000.log"));
+	size_t cb;
+	char* pData = readFile(szLog, &cb);
+	CHECK(pData != NULL);
+	char* pCopy = (char*)malloc(cb > 0? cb : 1);
+	const char* const pDataEnd = pData + cb;
+	DWORD dwSeed = 1;
+	int nLines = 0;
+	bool bParsed = true;
+	bool bSane = pCopy != NULL;
+	for (const char* p = pData; p < pDataEnd && bParsed && bSane; ++nLines) {
+		const char* pEnd = lineEnd(p, pDataEnd);
+		LogRecord r;
+		int anKeys[256];
+		bParsed = LogParser::parse(p, pEnd - p, &r, anKeys) && r.type != RecordUnknown;
+		bSane = mutateLine(p, pEnd - p, pCopy, dwSeed);
+		if (!bParsed || !bSane)
+			testNote("line %d: %.60s", nLines + 1, p);
+		p = pEnd + 1;
+	}
+	free(pCopy);
+	free(pData);
+	CHECK(bParsed);
+	CHECK(bSane);
+	CHECK(nLines > 0);
+	return true;
+}
+
+
+bool benchParseLog()
+{
+	// two weeks of one host, parsed from memory so that only the parser
+	// is measured, with the KEYSTAT counts stored as RecordReader does
+	CHECK(generateLogs(TEXT("parse-bench"), 1, 14));
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("parse-bench\\host0000.log"));
+	size_t cb;
+	char* pData = readFile(szLog, &cb);
+	CHECK(pData != NULL);
+	const char* const pDataEnd = pData + cb;
+	LogRecord r;
+	int anKeys[256];
+	double fRecords = 0;
+	const ULONGLONG ullStartNs = Clock::now();
+	for (int i = 0; i < BenchPasses; ++i) {
+		for (const char* p = pData; p < pDataEnd; ) {
+			const char* pEnd = lineEnd(p, pDataEnd);
+			if (LogParser::parse(p, pEnd - p, &r, anKeys))
+				++fRecords;
+			p = pEnd + 1;
+		}
+	}
+	const double fSecs = secondsSince(ullStartNs);
+	free(pData);
+	benchResult("parse", fRecords / fSecs, "records/sec");
+	benchResult("parse", BenchPasses * (double)cb / fSecs / (1024 * 1024), "MB/sec");
+	return true;
+}
@@ -0,0 +1,62 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "rrd.h"
+#include "tests.h"
+
+static const UINT Step = 3600;
+static const UINT Rows = 24;
+static const ULONGLONG StepUtc = 10000000ULL * Step;
+
+
+bool testRrdReader()
+{
+	// what the writer consolidated reads back through a read-only mapping
+	// while the writer still has the archive open
+	TCHAR szFile[MAX_PATH];
+	testFile(szFile, TEXT("test.3600.rrd"));
+	RoundRobinArchive writer;
+	CHECK(writer.open(szFile, Step, Rows));
+	const ULONGLONG ullStart = 130000000000000000ULL / StepUtc * StepUtc;
+	RrdRecord r;
+	ZeroMemory(&r, sizeof(r));
+	r.fMouseDist = 100;
+	r.nClicks = 2;
+	r.nKeys = 10;
+	// six 10-minute intervals per row, for 30 hours: the first 6 rows are gone
+	for (int i = 0; i < 6 * 30; ++i)
+		writer.update(ullStart + i * (StepUtc / 6), r);
+	writer.sync();
+	RoundRobinArchive reader;
+	CHECK(reader.open(szFile));
+	CHECK(reader.step() == Step && reader.rows() == Rows);
+	CHECK(reader.lastUtc() == ullStart + 29 * StepUtc);
+	RrdRecord aRows[Rows + 1];
+	const UINT n = reader.query(ullStart, reader.lastUtc() + StepUtc, aRows, Rows + 1);
+	CHECK(n == Rows);
+	CHECK(aRows[0].ullSlot * StepUtc == ullStart + 6 * StepUtc);
+	for (UINT i = 0; i < n; ++i)
+		CHECK(aRows[i].nClicks == 12 && aRows[i].nKeys == 60 && aRows[i].fMouseDist == 600);
+	// updates are ignored on a read-only archive
+	reader.update(reader.lastUtc(), r);
+	CHECK(reader.query(reader.lastUtc(), reader.lastUtc() + StepUtc, aRows, 1) == 1 && aRows[0].nKeys == 60);
+	RoundRobinArchive missing;
+	TCHAR szMissing[MAX_PATH];
+	testFile(szMissing, TEXT("missing.rrd"));
+	CHECK(!missing.open(szMissing));
+	return true;
+}
@@ -0,0 +1,58 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "clock.h"
+#include "tests.h"
+
+static const int TestInterval = 3600;
+static const int KeyPresses = 5;
+static const DWORD StartTimeout = 10000;
+// actilog's ShutdownTimeout plus time to start up the exit
+static const DWORD StopTimeout = 2000 + 3000;
+
+
+bool testShutdownBreak()
+{
+	// Ctrl-Break (the SIGINT of a console program) must end actilog within
+	// the shutdown timeout after the pending interval has been written
+	TCHAR szLog[MAX_PATH];
+	testFile(szLog, TEXT("break.log"));
+	TCHAR szArgs[MAX_PATH + 64];
+	_sntprintf(szArgs, MAX_PATH + 64, TEXT("-o \"%s\" -i %d -v"), szLog, TestInterval);
+	waitForQuietInterval(TestInterval, 30);
+	Child child;
+	CHECK(child.start(TEXT("actilog"), szArgs));
+	CHECK(waitForRecord(szLog, RecordClock, StartTimeout));
+	Sleep(1000);
+	injectKeys(VK_F24, KeyPresses);
+	const ULONGLONG ullStartNs = Clock::now();
+	CHECK(child.interrupt());
+	DWORD dwExitCode;
+	CHECK(child.wait(StopTimeout, &dwExitCode));
+	testNote("exited %.0lf ms after Ctrl-Break", 1e3 * secondsSince(ullStartNs));
+	CHECK(dwExitCode == EXIT_SUCCESS);
+	LogFile log;
+	CHECK(log.load(szLog));
+	const int iBreak = log.find(RecordBreak);
+	const int iPartial = log.find(RecordPartial, iBreak + 1);
+	const int iInterval = log.find(RecordInterval, iPartial + 1);
+	const int iStop = log.find(RecordStop, iInterval + 1);
+	CHECK(iBreak >= 0 && iPartial > iBreak && iInterval > iPartial && iStop > iInterval);
+	CHECK(iStop == log.size() - 1);
+	CHECK(log.keys(VK_F24) == KeyPresses);
+	return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+// journaltest.cpp
+bool testJournalKill();
+
+// shutdowntest.cpp
+bool testShutdownBreak();
+
+// rrdtest.cpp
+bool testRrdReader();
+
+// indextest.cpp
+bool testIndexSeek();
+bool testIndexLive();
+
+// metricstest.cpp
+bool testMetricsScrape();
+bool benchMetricsScrape();
+
+// formattest.cpp
+bool testFormatCsv();
+bool testFormatNdjson();
+bool benchFormatRecords();
+
+// devicetest.cpp
+bool testDeviceSlots();
+bool testDeviceMotion();
+
+// warptest.cpp
+bool testWarpTrace();
+
+// anomalytest.cpp
+bool testAnomalyReplay();
+
+// parsetest.cpp
+bool testParseMutations();
+bool benchParseLog();
+
+// arenatest.cpp
+bool testArenaReader();
+bool benchArenaReader();
+
+// iotest.cpp
+bool testLoggerWrites();
+bool benchLoggerWrites();
+bool benchReaderDirect();
+
+// gziptest.cpp
+bool testGzipMembers();
+bool testGzipRoundTrip();
+bool testGzipAppend();
+
+// compacttest.cpp
+bool testCompactMerge();
+bool testCompactEdges();
@@ -0,0 +1,120 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "harness.h"
+#include "warp.h"
+#include "tests.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const int MaxEvents = 4096;
+
+struct TraceEvent {
+	DWORD dwTime;
+	POINT pt;
+	bool abWarp[2];
+};
+
+
+/// The synthetic trace in data\warp.trace: the monitor layout, then one
+/// cursor event per line with whether it is a warp by speed alone and
+/// with the monitor layout taken into account.
+struct Trace {
+	RECT arcMonitors[WarpFilter::MaxMonitors];
+	int nMonitors;
+	TraceEvent aEvents[MaxEvents];
+	int nEvents;
+};
+
+
+static bool loadTrace(const TCHAR* pszName, Trace& trace)
+{
+	TCHAR szTrace[MAX_PATH];
+	dataFile(szTrace, pszName);
+	size_t cb;
+	char* pData = readFile(szTrace, &cb);
+	CHECK(pData != NULL);
+	trace.nMonitors = 0;
+	trace.nEvents = 0;
+	bool bOk = true;
+	for (char* pLine = strtok(pData, "\r\n"); pLine != NULL && bOk; pLine = strtok(NULL, "\r\n")) {
+		if (pLine[0] == '#')
+			continue;
+		RECT rc;
+		unsigned long ulTime;
+		POINT pt;
+		int nWarp, nWarpAware;
+		if (sscanf(pLine, "monitor %ld %ld %ld %ld", &rc.left, &rc.top, &rc.right, &rc.bottom) == 4 && trace.nMonitors < WarpFilter::MaxMonitors) {
+			trace.arcMonitors[trace.nMonitors++] = rc;
+		}
+		else if (sscanf(pLine, "%lu %ld %ld %d %d", &ulTime, &pt.x, &pt.y, &nWarp, &nWarpAware) == 5 && trace.nEvents < MaxEvents) {
+			TraceEvent& e = trace.aEvents[trace.nEvents++];
+			e.dwTime = ulTime;
+			e.pt = pt;
+			e.abWarp[0] = nWarp != 0;
+			e.abWarp[1] = nWarpAware != 0;
+		}
+		else {
+			bOk = false;
+		}
+	}
+	free(pData);
+	CHECK(bOk);
+	return true;
+}
+
+
+static bool replay(const Trace& trace, bool bMonitorAware)
+{
+	WarpFilter warp;
+	warp.setMaxSpeed(WarpFilter::DefaultMaxSpeed);
+	// setMonitorAware() reads the layout of this machine; the trace's
+	// own layout replaces it
+	warp.setMonitorAware(bMonitorAware);
+	warp.setMonitors(trace.arcMonitors, trace.nMonitors);
+	int nWrong = 0;
+	for (int i = 0; i < trace.nEvents; ++i) {
+		const TraceEvent& e = trace.aEvents[i];
+		double fDist;
+		const bool bWarp = warp.move(e.pt, e.dwTime, &fDist);
+		if (bWarp != e.abWarp[bMonitorAware? 1 : 0]) {
+			testNote("event %d at %lu ms (%ld, %ld): warp %d, expected %d", i, e.dwTime, e.pt.x, e.pt.y, bWarp, !bWarp);
+			++nWrong;
+		}
+	}
+	return nWrong == 0;
+}
+
+
+bool testWarpTrace()
+{
+	// every warp in the trace is found and nothing else, with and
+	// without the monitor layout
+	Trace* pTrace = (Trace*)malloc(sizeof(Trace));
+	CHECK(pTrace != NULL);
+	const bool bLoaded = loadTrace(TEXT("warp.trace"), *pTrace);
+	const bool bSpeed = bLoaded && replay(*pTrace, false);
+	const bool bMonitors = bLoaded && replay(*pTrace, true);
+	const int nEvents = pTrace->nEvents;
+	const int nMonitors = pTrace->nMonitors;
+	free(pTrace);
+	CHECK(bLoaded);
+	CHECK(nMonitors == 3 && nEvents > 200);
+	CHECK(bSpeed);
+	CHECK(bMonitors);
+	return true;
+}
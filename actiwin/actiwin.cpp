@@ -64,45 +64,21 @@ inline bool hasHistoChanged()
 }
 
 
+// moves land in nUncounted, cleared after each increment so it cannot overflow
+int nUncounted = 0;
+int* const apSlots[NumCounterSlots] = { &nUncounted, &nClicks, &nDoubleClicks, &nWheel, &nUncounted };
+
+
 LRESULT CALLBACK LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam)
 {
 	MSLLHOOKSTRUCT* pMouse = (MSLLHOOKSTRUCT*)lParam;
-	switch (wParam)
-	{
-	case WM_MOUSEMOVE:
+	const EventClass& ec = EventTable::mouse(wParam);
+	++*apSlots[ec.slot];
+	nUncounted = 0;
+	if (ec.kind == EventMove) {
 		if (ptLastMousePos.x < LONG_MAX && ptLastMousePos.y < LONG_MAX)
 			fMouseDist += sqrt((double)squared(ptLastMousePos.x - pMouse->pt.x) + (double)squared(ptLastMousePos.y - pMouse->pt.y));
 		ptLastMousePos = pMouse->pt;
-		break;
-#if (_WIN32_WINNT >= 0x0600)
-	case WM_MOUSEHWHEEL:
-		// fall-through
-#endif
-	case WM_MOUSEWHEEL:
-		++nWheel;
-		break;
-#if (_WIN32_WINNT >= 0x0500)
-	case WM_XBUTTONDBLCLK:
-		// fall-through
-#endif
-	case WM_LBUTTONDBLCLK:
-		// fall-through
-	case WM_MBUTTONDBLCLK:
-		// fall-through
-	case WM_RBUTTONDBLCLK:
-		++nDoubleClicks;
-		break;
-#if (_WIN32_WINNT >= 0x0500)
-	case WM_XBUTTONUP:
-		// fall-through
-#endif
-	case WM_LBUTTONUP:
-		// fall-through
-	case WM_MBUTTONUP:
-		// fall-through
-	case WM_RBUTTONUP:
-		++nClicks;
-		break;
 	}
 	return 0;
 }
@@ -111,19 +87,11 @@ LRESULT CALLBACK LowLevelMouseProc(int nCode, WPARAM wParam, LPARAM lParam)
 LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
 {
 	KBDLLHOOKSTRUCT* pKeyBoard = (KBDLLHOOKSTRUCT*)lParam;
-	switch (wParam)
-	{
-	case WM_KEYUP:
-		{
-			const DWORD dwKeyCode = pKeyBoard->vkCode;
-			if (dwKeyCode >= 0 && dwKeyCode < 256)
-				++aHisto[dwKeyCode];
-			break;
-		}
-	default:
-		return CallNextHookEx(NULL, nCode, wParam, lParam);
+	if (EventTable::keyboard(wParam).slot == SlotKeys) {
+		++aHisto[pKeyBoard->vkCode & 0xff];
+		return 0;
 	}
-	return 0;
+	return CallNextHookEx(NULL, nCode, wParam, lParam);
 }
 
 
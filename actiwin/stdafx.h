@@ -23,5 +23,6 @@
 // TODO: reference additional headers your program requires here
 #include "getopt.h"
 #include "log.h"
+#include "events.h"
 #include "util.h"
 #include "CommandLineToArgvA.h"
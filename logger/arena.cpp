@@ -0,0 +1,94 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "arena.h"
+#include <stdlib.h>
+
+
+Arena::Arena(size_t cbBlock)
+	: pFirst(NULL)
+	, pCurrent(NULL)
+	, cbBlock(cbBlock)
+	, cbReserved(0)
+	, nHeapAllocations(0)
+{
+	// ...
+}
+
+
+Arena::~Arena()
+{
+	release();
+}
+
+
+void Arena::release()
+{
+	while (pFirst) {
+		Block* pNext = pFirst->pNext;
+		free(pFirst);
+		pFirst = pNext;
+	}
+	pCurrent = NULL;
+	cbReserved = 0;
+}
+
+
+void Arena::reset()
+{
+	for (Block* p = pFirst; p; p = p->pNext)
+		p->cbUsed = 0;
+	pCurrent = pFirst;
+}
+
+
+void* Arena::alloc(size_t cb, size_t cbAlign)
+{
+	// first fit from the current block on; earlier blocks are full
+	for (Block* p = pCurrent; p; p = p->pNext) {
+		const size_t uBase = (size_t)data(p);
+		const size_t uStart = (uBase + p->cbUsed + cbAlign - 1) & ~(cbAlign - 1);
+		if (uStart + cb <= uBase + p->cb) {
+			p->cbUsed = uStart + cb - uBase;
+			pCurrent = p;
+			return (void*)uStart;
+		}
+	}
+	// leave room for aligning the start, as the heap only guarantees
+	// 8 bytes on 32-bit Windows
+	const size_t cbData = (cb + cbAlign > cbBlock)? cb + cbAlign : cbBlock;
+	Block* pBlock = (Block*)malloc(sizeof(Block) + cbData);
+	if (pBlock == NULL)
+		return NULL;
+	++nHeapAllocations;
+	cbReserved += cbData;
+	pBlock->pNext = NULL;
+	pBlock->cb = cbData;
+	pBlock->cbUsed = 0;
+	if (pFirst == NULL) {
+		pFirst = pBlock;
+	}
+	else {
+		Block* pLast = pCurrent? pCurrent : pFirst;
+		while (pLast->pNext)
+			pLast = pLast->pNext;
+		pLast->pNext = pBlock;
+	}
+	pCurrent = pBlock;
+	const size_t uStart = ((size_t)data(pBlock) + cbAlign - 1) & ~(cbAlign - 1);
+	pBlock->cbUsed = uStart - (size_t)data(pBlock) + cb;
+	return (void*)uStart;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// Monotonic allocator for the log-reading tools. Memory is carved from
+/// a chain of large heap blocks and is never freed individually; reset()
+/// rewinds all blocks at once and keeps them, so a reader that resets the
+/// arena between files or batches reaches a steady state in which it does
+/// not touch the heap at all. heapAllocations() counts the blocks taken
+/// from the heap so far, which makes that easy to check.
+class Arena {
+public:
+	static const size_t DefaultBlockSize = 1024 * 1024;
+
+	Arena(size_t cbBlock = DefaultBlockSize);
+	~Arena();
+	void* alloc(size_t cb, size_t cbAlign = 16);
+	void reset();
+	void release();
+	UINT heapAllocations() const { return nHeapAllocations; }
+	size_t bytesReserved() const { return cbReserved; }
+
+private:
+	struct Block {
+		Block* pNext;
+		size_t cb;
+		size_t cbUsed;
+	};
+	Block* pFirst;
+	Block* pCurrent;
+	size_t cbBlock;
+	size_t cbReserved;
+	UINT nHeapAllocations;
+	static BYTE* data(Block* pBlock) { return (BYTE*)(pBlock + 1); }
+};
@@ -0,0 +1,106 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "clock.h"
+#include <strsafe.h>
+
+ULONGLONG Clock::ullFrequency = 1;
+ULONGLONG Clock::ullAnchorNs = 0;
+ULONGLONG Clock::ullAnchorUtc = 0;
+
+
+void Clock::init()
+{
+	LARGE_INTEGER li;
+	QueryPerformanceFrequency(&li);
+	ullFrequency = (ULONGLONG)li.QuadPart;
+	anchor();
+}
+
+
+ULONGLONG Clock::utcNow()
+{
+	FILETIME ft;
+	GetSystemTimeAsFileTime(&ft);
+	ULARGE_INTEGER u;
+	u.LowPart = ft.dwLowDateTime;
+	u.HighPart = ft.dwHighDateTime;
+	return u.QuadPart;
+}
+
+
+void Clock::anchor()
+{
+	// bracket the system time with two monotonic readings and use the
+	// midpoint; retry a few times if we got preempted in between
+	ULONGLONG ullBest = ~0ULL;
+	for (int i = 0; i < 3; ++i) {
+		const ULONGLONG ullBefore = now();
+		const ULONGLONG ullUtc = utcNow();
+		const ULONGLONG ullAfter = now();
+		if (ullAfter - ullBefore < ullBest) {
+			ullBest = ullAfter - ullBefore;
+			ullAnchorNs = ullBefore + (ullAfter - ullBefore) / 2;
+			ullAnchorUtc = ullUtc;
+		}
+	}
+}
+
+
+LONGLONG Clock::drift()
+{
+	// difference between the system time and the anchored mapping,
+	// in 100 ns units (positive: system clock is ahead)
+	const ULONGLONG ullMapped = toUtc(now());
+	return (LONGLONG)(utcNow() - ullMapped);
+}
+
+
+ULONGLONG Clock::toUtc(ULONGLONG ullNs)
+{
+	if (ullNs >= ullAnchorNs)
+		return ullAnchorUtc + (ullNs - ullAnchorNs) / 100;
+	return ullAnchorUtc - (ullAnchorNs - ullNs) / 100;
+}
+
+
+ULONGLONG Clock::toMonotonic(ULONGLONG ullUtc)
+{
+	if (ullUtc >= ullAnchorUtc)
+		return ullAnchorNs + (ullUtc - ullAnchorUtc) * 100;
+	const ULONGLONG ullBack = (ullAnchorUtc - ullUtc) * 100;
+	return ullBack < ullAnchorNs? ullAnchorNs - ullBack : 0;
+}
+
+
+void Clock::toFileTime(ULONGLONG ullUtc, FILETIME* pft)
+{
+	ULARGE_INTEGER u;
+	u.QuadPart = ullUtc;
+	pft->dwLowDateTime = u.LowPart;
+	pft->dwHighDateTime = u.HighPart;
+}
+
+
+void Clock::formatUtc(ULONGLONG ullUtc, TCHAR* pszDest, size_t cchDest)
+{
+	FILETIME ft;
+	SYSTEMTIME t;
+	toFileTime(ullUtc, &ft);
+	FileTimeToSystemTime(&ft, &t);
+	StringCchPrintf(pszDest, cchDest, TEXT("%4d-%02d-%02dT%02d:%02d:%02d.%07uZ"),
+		t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond, (UINT)(ullUtc % 10000000));
+}
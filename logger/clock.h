@@ -0,0 +1,51 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// Monotonic nanosecond clock based on QueryPerformanceCounter, which on
+/// invariant-TSC machines is read in user mode without a kernel transition.
+/// An anchor pairs a monotonic reading with the UTC system time so that
+/// monotonic timestamps can be mapped to wall-clock time (in 100 ns units
+/// since 1601-01-01, i.e. FILETIME resolution).
+class Clock {
+public:
+	static void init();
+	static ULONGLONG now()
+	{
+		LARGE_INTEGER li;
+		QueryPerformanceCounter(&li);
+		const ULONGLONG ullTicks = (ULONGLONG)li.QuadPart;
+		return (ullTicks / ullFrequency) * 1000000000ULL + (ullTicks % ullFrequency) * 1000000000ULL / ullFrequency;
+	}
+	static void anchor();
+	static LONGLONG drift();
+	static ULONGLONG toUtc(ULONGLONG ullNs);
+	static ULONGLONG toMonotonic(ULONGLONG ullUtc);
+	static ULONGLONG utcNow();
+	static ULONGLONG anchorNs() { return ullAnchorNs; }
+	static ULONGLONG anchorUtc() { return ullAnchorUtc; }
+	static void formatUtc(ULONGLONG ullUtc, TCHAR* pszDest, size_t cchDest);
+	static void toFileTime(ULONGLONG ullUtc, FILETIME* pft);
+
+private:
+	static ULONGLONG ullFrequency;
+	static ULONGLONG ullAnchorNs;
+	static ULONGLONG ullAnchorUtc;
+};
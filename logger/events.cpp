@@ -0,0 +1,50 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "events.h"
+
+// Message numbers are spelled out in the comments rather than used as
+// designators, so the tables are plain aggregates that the compiler lays
+// out at build time and that do not depend on _WIN32_WINNT.
+
+const EventClass EventTable::aMouse[MouseLast - MouseFirst + 1] = {
+	{ EventMove,        SlotNone,         0 },				// 0x0200 WM_MOUSEMOVE
+	{ EventButtonDown,  SlotNone,         VK_LBUTTON },		// 0x0201 WM_LBUTTONDOWN
+	{ EventButtonUp,    SlotClicks,       VK_LBUTTON },		// 0x0202 WM_LBUTTONUP
+	{ EventDoubleClick, SlotDoubleClicks, VK_LBUTTON },		// 0x0203 WM_LBUTTONDBLCLK
+	{ EventButtonDown,  SlotNone,         VK_RBUTTON },		// 0x0204 WM_RBUTTONDOWN
+	{ EventButtonUp,    SlotClicks,       VK_RBUTTON },		// 0x0205 WM_RBUTTONUP
+	{ EventDoubleClick, SlotDoubleClicks, VK_RBUTTON },		// 0x0206 WM_RBUTTONDBLCLK
+	{ EventButtonDown,  SlotNone,         VK_MBUTTON },		// 0x0207 WM_MBUTTONDOWN
+	{ EventButtonUp,    SlotClicks,       VK_MBUTTON },		// 0x0208 WM_MBUTTONUP
+	{ EventDoubleClick, SlotDoubleClicks, VK_MBUTTON },		// 0x0209 WM_MBUTTONDBLCLK
+	{ EventWheel,       SlotWheel,        0 },				// 0x020A WM_MOUSEWHEEL
+	{ EventButtonDown,  SlotNone,         VK_XBUTTON1 },	// 0x020B WM_XBUTTONDOWN
+	{ EventButtonUp,    SlotClicks,       VK_XBUTTON1 },	// 0x020C WM_XBUTTONUP
+	{ EventDoubleClick, SlotDoubleClicks, VK_XBUTTON1 },	// 0x020D WM_XBUTTONDBLCLK
+	{ EventWheel,       SlotWheel,        0 }				// 0x020E WM_MOUSEHWHEEL
+};
+
+const EventClass EventTable::aKeyboard[KeyLast - KeyFirst + 1] = {
+	{ EventKeyDown,     SlotNone,         0 },				// 0x0100 WM_KEYDOWN
+	{ EventKeyUp,       SlotKeys,         0 },				// 0x0101 WM_KEYUP
+	{ EventOther,       SlotNone,         0 },				// 0x0102 WM_CHAR
+	{ EventOther,       SlotNone,         0 },				// 0x0103 WM_DEADCHAR
+	{ EventKeyDown,     SlotNone,         0 },				// 0x0104 WM_SYSKEYDOWN
+	{ EventKeyUp,       SlotNone,         0 }				// 0x0105 WM_SYSKEYUP
+};
+
+const EventClass EventTable::Other = { EventOther, SlotNone, 0 };
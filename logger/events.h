@@ -0,0 +1,87 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+
+/// What a hooked input message is, independent of how it is counted.
+enum EventKind {
+	EventOther,
+	EventMove,
+	EventWheel,
+	EventButtonDown,
+	EventButtonUp,
+	EventDoubleClick,
+	EventKeyDown,
+	EventKeyUp,
+	NumEventKinds
+};
+
+/// Which counter a message increments. SlotKeys means the key
+/// histogram entry of the virtual key code.
+enum CounterSlot {
+	SlotNone,
+	SlotClicks,
+	SlotDoubleClicks,
+	SlotWheel,
+	SlotKeys,
+	NumCounterSlots
+};
+
+/// Classification of one message. 'button' is the virtual key code of
+/// the mouse button involved, VK_XBUTTON1 standing for either X button
+/// (see mouseButton()).
+struct EventClass {
+	BYTE kind;
+	BYTE slot;
+	BYTE button;
+};
+
+/// Lookup tables for the messages passed to the low-level mouse and
+/// keyboard hooks, shared by actilog and actiwin. Both message ranges
+/// are dense, so classifying a message is one bounds check and one
+/// indexed load; anything outside them maps to an uncounted EventOther.
+/// Counting a new kind of message means editing a table entry in
+/// events.cpp rather than another switch in every application.
+class EventTable {
+public:
+	static const UINT MouseFirst = 0x0200;	// WM_MOUSEMOVE
+	static const UINT MouseLast = 0x020E;	// WM_MOUSEHWHEEL
+	static const UINT KeyFirst = 0x0100;	// WM_KEYDOWN
+	static const UINT KeyLast = 0x0105;		// WM_SYSKEYUP
+
+	static const EventClass& mouse(WPARAM wParam)
+	{
+		return wParam - MouseFirst <= (WPARAM)(MouseLast - MouseFirst)? aMouse[wParam - MouseFirst] : Other;
+	}
+	static const EventClass& keyboard(WPARAM wParam)
+	{
+		return wParam - KeyFirst <= (WPARAM)(KeyLast - KeyFirst)? aKeyboard[wParam - KeyFirst] : Other;
+	}
+	static UINT mouseButton(const EventClass& ec, DWORD dwMouseData)
+	{
+		// WM_XBUTTON* tell which X button in the high word of mouseData
+		if (ec.button != VK_XBUTTON1)
+			return ec.button;
+		return HIWORD(dwMouseData) == 2? VK_XBUTTON2 : VK_XBUTTON1;
+	}
+
+private:
+	static const EventClass aMouse[MouseLast - MouseFirst + 1];
+	static const EventClass aKeyboard[KeyLast - KeyFirst + 1];
+	static const EventClass Other;
+};
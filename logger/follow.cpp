@@ -0,0 +1,237 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "follow.h"
+#include "gzipreader.h"
+#include <stdlib.h>
+
+
+LogFollower::LogFollower()
+	: hFile(INVALID_HANDLE_VALUE)
+	, hDir(INVALID_HANDLE_VALUE)
+	, ullOffset(0)
+	, pBuf(NULL)
+	, cbPending(0)
+	, bSkipPartial(false)
+	, bCompressed(false)
+{
+	ZeroMemory(&ov, sizeof(ov));
+	szPath[0] = 0;
+	wszName[0] = 0;
+}
+
+
+LogFollower::~LogFollower()
+{
+	close();
+}
+
+
+void LogFollower::close()
+{
+	if (hDir != INVALID_HANDLE_VALUE) {
+		CancelIo(hDir);
+		CloseHandle(hDir);
+	}
+	hDir = INVALID_HANDLE_VALUE;
+	if (ov.hEvent)
+		CloseHandle(ov.hEvent);
+	ov.hEvent = NULL;
+	if (hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(hFile);
+	hFile = INVALID_HANDLE_VALUE;
+	free(pBuf);
+	pBuf = NULL;
+	cbPending = 0;
+}
+
+
+bool LogFollower::openFile(bool bFromStart)
+{
+	// share everything so that the writer may truncate, rename or delete
+	hFile = CreateFile(szPath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	GetFileInformationByHandle(hFile, &identity);
+	bCompressed = GzipReader::isGzipFile(szPath);
+	LARGE_INTEGER liSize;
+	ullOffset = (!bFromStart && GetFileSizeEx(hFile, &liSize))? liSize.QuadPart : 0;
+	cbPending = 0;
+	bSkipPartial = false;
+	if (ullOffset > 0) {
+		// starting in the middle of a line: drop its tail
+		LARGE_INTEGER liPos;
+		liPos.QuadPart = ullOffset - 1;
+		char c = '\n';
+		DWORD dwRead;
+		if (SetFilePointerEx(hFile, liPos, NULL, FILE_BEGIN) && ReadFile(hFile, &c, 1, &dwRead, NULL) && dwRead == 1)
+			bSkipPartial = c != '\n';
+	}
+	return true;
+}
+
+
+bool LogFollower::open(const TCHAR* pszFilename, bool bFromStart)
+{
+	close();
+	TCHAR* pszName = NULL;
+	if (GetFullPathName(pszFilename, MAX_PATH, szPath, &pszName) == 0 || pszName == NULL)
+		return false;
+	MultiByteToWideChar(CP_ACP, 0, pszName, -1, wszName, MAX_PATH);
+	TCHAR szDir[MAX_PATH];
+	_tcsncpy(szDir, szPath, pszName - szPath);
+	szDir[pszName - szPath] = 0;
+	pBuf = (char*)malloc(ReadBufSize);
+	ov.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	hDir = CreateFile(szDir, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if (pBuf == NULL || ov.hEvent == NULL || hDir == INVALID_HANDLE_VALUE) {
+		close();
+		return false;
+	}
+	// the file itself may not exist yet; it is picked up once created
+	openFile(bFromStart);
+	return true;
+}
+
+
+bool LogFollower::armWatch()
+{
+	return ReadDirectoryChangesW(hDir, aNotify, sizeof(aNotify), FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+		NULL, &ov, NULL) != FALSE;
+}
+
+
+bool LogFollower::isRelevant(DWORD cbNotify) const
+{
+	// an overflowed notification buffer tells nothing, so look anyway
+	if (cbNotify == 0)
+		return true;
+	const BYTE* p = (const BYTE*)aNotify;
+	for (;;) {
+		const FILE_NOTIFY_INFORMATION* pInfo = (const FILE_NOTIFY_INFORMATION*)p;
+		WCHAR wszChanged[MAX_PATH];
+		const DWORD cch = pInfo->FileNameLength / sizeof(WCHAR) < MAX_PATH - 1? pInfo->FileNameLength / sizeof(WCHAR) : MAX_PATH - 1;
+		CopyMemory(wszChanged, pInfo->FileName, cch * sizeof(WCHAR));
+		wszChanged[cch] = 0;
+		if (lstrcmpiW(wszChanged, wszName) == 0)
+			return true;
+		if (pInfo->NextEntryOffset == 0)
+			return false;
+		p += pInfo->NextEntryOffset;
+	}
+}
+
+
+bool LogFollower::isRotated() const
+{
+	HANDLE h = CreateFile(szPath, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return true;
+	BY_HANDLE_FILE_INFORMATION info;
+	const BOOL bOk = GetFileInformationByHandle(h, &info);
+	CloseHandle(h);
+	return bOk && (info.nFileIndexLow != identity.nFileIndexLow || info.nFileIndexHigh != identity.nFileIndexHigh || info.dwVolumeSerialNumber != identity.dwVolumeSerialNumber);
+}
+
+
+void LogFollower::readNew(LineProc proc, void* pContext)
+{
+	if (bCompressed)
+		return;
+	LARGE_INTEGER liSize;
+	if (!GetFileSizeEx(hFile, &liSize))
+		return;
+	if ((ULONGLONG)liSize.QuadPart < ullOffset) {
+		// truncated: start over
+		ullOffset = 0;
+		cbPending = 0;
+		bSkipPartial = false;
+	}
+	LARGE_INTEGER liPos;
+	liPos.QuadPart = ullOffset;
+	if (!SetFilePointerEx(hFile, liPos, NULL, FILE_BEGIN))
+		return;
+	DWORD dwRead;
+	while (ReadFile(hFile, pBuf + cbPending, (DWORD)(ReadBufSize - cbPending), &dwRead, NULL) && dwRead > 0) {
+		// a file that was empty when it was opened may turn out compressed
+		if (ullOffset == 0 && GzipReader::isGzip(pBuf, dwRead)) {
+			bCompressed = true;
+			return;
+		}
+		ullOffset += dwRead;
+		const size_t cbData = cbPending + dwRead;
+		size_t cbLineStart = 0;
+		for (size_t i = cbPending; i < cbData; ++i) {
+			if (pBuf[i] != '\n')
+				continue;
+			size_t cbLine = i - cbLineStart;
+			if (cbLine > 0 && pBuf[cbLineStart + cbLine - 1] == '\r')
+				--cbLine;
+			if (bSkipPartial)
+				bSkipPartial = false;
+			else
+				proc(pBuf + cbLineStart, cbLine, pContext);
+			cbLineStart = i + 1;
+		}
+		cbPending = cbData - cbLineStart;
+		if (cbPending == ReadBufSize) {
+			// a line longer than the buffer: hand it out in pieces
+			proc(pBuf, cbPending, pContext);
+			cbPending = 0;
+		}
+		else if (cbLineStart > 0) {
+			MoveMemory(pBuf, pBuf + cbLineStart, cbPending);
+		}
+	}
+}
+
+
+void LogFollower::poll(LineProc proc, void* pContext)
+{
+	if (hFile != INVALID_HANDLE_VALUE && isRotated()) {
+		// drain what was appended to the old file before it went away
+		readNew(proc, pContext);
+		CloseHandle(hFile);
+		hFile = INVALID_HANDLE_VALUE;
+	}
+	if (hFile == INVALID_HANDLE_VALUE && !openFile(true))
+		return;
+	readNew(proc, pContext);
+}
+
+
+bool LogFollower::run(LineProc proc, void* pContext, HANDLE hStopEvent)
+{
+	if (hDir == INVALID_HANDLE_VALUE || !armWatch())
+		return false;
+	poll(proc, pContext);
+	HANDLE aHandles[2] = { hStopEvent, ov.hEvent };
+	while (!bCompressed) {
+		const DWORD dwResult = WaitForMultipleObjects(2, aHandles, FALSE, INFINITE);
+		if (dwResult != WAIT_OBJECT_0 + 1)
+			break;
+		DWORD cbNotify = 0;
+		if (!GetOverlappedResult(hDir, &ov, &cbNotify, FALSE))
+			cbNotify = 0;
+		const bool bRelevant = isRelevant(cbNotify);
+		if (!armWatch())
+			return false;
+		if (bRelevant)
+			poll(proc, pContext);
+	}
+	return !bCompressed;
+}
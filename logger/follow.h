@@ -0,0 +1,60 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// Follows a log file as Logger appends to it and hands every newly
+/// completed line to a callback. Changes are picked up through
+/// ReadDirectoryChangesW on the file's directory, so waiting costs no CPU
+/// at all. Truncation restarts reading from the top; if the file is
+/// rotated (renamed or deleted and created anew) the rest of the old
+/// file is read first and then the new one is followed from its start.
+/// A compressed log (Logger --gzip) has no lines to hand out as they are
+/// appended; following it stops, and isCompressed() tells why.
+class LogFollower {
+public:
+	typedef void (*LineProc)(const char* pLine, size_t cbLine, void* pContext);
+	LogFollower();
+	~LogFollower();
+	bool open(const TCHAR* pszFilename, bool bFromStart);
+	void close();
+	bool run(LineProc proc, void* pContext, HANDLE hStopEvent);
+	void poll(LineProc proc, void* pContext);
+	bool isCompressed() const { return bCompressed; }
+
+private:
+	static const DWORD ReadBufSize = 64 * 1024;
+	TCHAR szPath[MAX_PATH];
+	WCHAR wszName[MAX_PATH];
+	HANDLE hFile;
+	HANDLE hDir;
+	OVERLAPPED ov;
+	DWORD aNotify[1024];
+	BY_HANDLE_FILE_INFORMATION identity;
+	ULONGLONG ullOffset;
+	char* pBuf;
+	size_t cbPending;
+	bool bSkipPartial;
+	bool bCompressed;
+	bool openFile(bool bFromStart);
+	bool armWatch();
+	bool isRotated() const;
+	bool isRelevant(DWORD cbNotify) const;
+	void readNew(LineProc proc, void* pContext);
+};
@@ -0,0 +1,417 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "gzipreader.h"
+#include <string.h>
+
+// RFC 1951 length and distance codes
+static const WORD LengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const BYTE LengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const WORD DistanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const BYTE DistanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// order in which a dynamic block lists the lengths of the code length code
+static const BYTE CodeLengthOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+// RFC 1952 header flags
+static const BYTE FlagText = 0x01;
+static const BYTE FlagHeaderCrc = 0x02;
+static const BYTE FlagExtra = 0x04;
+static const BYTE FlagName = 0x08;
+static const BYTE FlagComment = 0x10;
+
+
+GzipReader::GzipReader()
+	: hFile(INVALID_HANDLE_VALUE)
+	, pInput(NULL)
+	, pWindow(NULL)
+{
+	for (DWORD n = 0; n < 256; ++n) {
+		DWORD c = n;
+		for (int k = 0; k < 8; ++k)
+			c = (c & 1)? 0xedb88320u ^ (c >> 1) : c >> 1;
+		aCrcTable[n] = c;
+	}
+	restart();
+}
+
+
+void GzipReader::attach(HANDLE hFile, BYTE* pInput, BYTE* pWindow)
+{
+	this->hFile = hFile;
+	this->pInput = pInput;
+	this->pWindow = pWindow;
+	restart();
+}
+
+
+void GzipReader::restart()
+{
+	cbInput = 0;
+	iInput = 0;
+	cbPastEnd = 0;
+	iWindow = 0;
+	ullBits = 0;
+	nBits = 0;
+	bInMember = false;
+	bInBlock = false;
+	bLastBlock = false;
+	bEnd = false;
+	bFailed = false;
+	nStored = 0;
+	nCopy = 0;
+	nDistance = 0;
+	dwCrc = 0xffffffffu;
+	cbMember = 0;
+}
+
+
+bool GzipReader::isGzip(const void* pData, size_t cb)
+{
+	const BYTE* p = (const BYTE*)pData;
+	return cb >= 3 && p[0] == 0x1f && p[1] == 0x8b && p[2] == 8;
+}
+
+
+bool GzipReader::isGzipFile(const TCHAR* pszFilename)
+{
+	HANDLE h = CreateFile(pszFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+	BYTE aMagic[3];
+	DWORD cbRead = 0;
+	const bool bGzip = ReadFile(h, aMagic, sizeof(aMagic), &cbRead, NULL) && isGzip(aMagic, cbRead);
+	CloseHandle(h);
+	return bGzip;
+}
+
+
+void GzipReader::need(int n)
+{
+	// past the end of the file the stream reads as zeros; bits() tells
+	// whether any of them were used
+	while (nBits < n) {
+		if (iInput == cbInput) {
+			iInput = 0;
+			cbInput = 0;
+			if (cbPastEnd == 0 && !ReadFile(hFile, pInput, InputSize, &cbInput, NULL))
+				cbInput = 0;
+			if (cbInput == 0) {
+				++cbPastEnd;
+				nBits += 8;
+				continue;
+			}
+		}
+		ullBits |= (ULONGLONG)pInput[iInput++] << nBits;
+		nBits += 8;
+	}
+}
+
+
+DWORD GzipReader::bits(int n)
+{
+	need(n);
+	const DWORD dw = (DWORD)(ullBits & ((1ULL << n) - 1));
+	ullBits >>= n;
+	nBits -= n;
+	if (cbPastEnd * 8 > (DWORD)nBits)
+		bFailed = true;
+	return dw;
+}
+
+
+int GzipReader::decode(const Huffman& h)
+{
+	need(15);
+	const WORD wFast = h.anFast[ullBits & ((1 << FastBits) - 1)];
+	if (wFast != 0) {
+		bits(wFast & 15);
+		return wFast >> 4;
+	}
+	// longer codes bit by bit, as in zlib's puff.c
+	int nCode = 0;
+	int nFirst = 0;
+	int nIndex = 0;
+	for (int nLength = 1; nLength < 16; ++nLength) {
+		nCode |= bits(1);
+		const int nCount = h.anCount[nLength];
+		if (nCode - nCount < nFirst)
+			return h.anSymbol[nIndex + nCode - nFirst];
+		nIndex += nCount;
+		nFirst = (nFirst + nCount) << 1;
+		nCode <<= 1;
+	}
+	bFailed = true;
+	return -1;
+}
+
+
+bool GzipReader::build(Huffman& h, const BYTE* anLengths, int n)
+{
+	// incomplete codes are allowed, as a block may not use them all;
+	// an oversubscribed one is not a prefix code
+	memset(h.anCount, 0, sizeof(h.anCount));
+	memset(h.anFast, 0, sizeof(h.anFast));
+	for (int i = 0; i < n; ++i)
+		++h.anCount[anLengths[i]];
+	h.anCount[0] = 0;
+	int nLeft = 1;
+	WORD anOffset[16];
+	anOffset[1] = 0;
+	for (int nLength = 1; nLength < 16; ++nLength) {
+		nLeft = (nLeft << 1) - h.anCount[nLength];
+		if (nLeft < 0)
+			return false;
+		if (nLength < 15)
+			anOffset[nLength + 1] = anOffset[nLength] + h.anCount[nLength];
+	}
+	int anNextCode[16];
+	int nCode = 0;
+	for (int nLength = 1; nLength < 16; ++nLength) {
+		nCode = (nCode + h.anCount[nLength - 1]) << 1;
+		anNextCode[nLength] = nCode;
+	}
+	for (int i = 0; i < n; ++i) {
+		const int nLength = anLengths[i];
+		if (nLength == 0)
+			continue;
+		h.anSymbol[anOffset[nLength]++] = (WORD)i;
+		const int nThisCode = anNextCode[nLength]++;
+		if (nLength > FastBits)
+			continue;
+		// codes go into the stream most significant bit first
+		int nReversed = 0;
+		for (int k = 0; k < nLength; ++k)
+			nReversed |= ((nThisCode >> k) & 1) << (nLength - 1 - k);
+		for (int k = nReversed; k < (1 << FastBits); k += 1 << nLength)
+			h.anFast[k] = (WORD)((i << 4) | nLength);
+	}
+	return true;
+}
+
+
+bool GzipReader::startMember()
+{
+	// the end of the file between two members is the end of the stream
+	need(8);
+	if (cbPastEnd * 8 >= (DWORD)nBits) {
+		bEnd = true;
+		return false;
+	}
+	const DWORD dwMagic = bits(16);
+	const DWORD dwMethod = bits(8);
+	const DWORD dwFlags = bits(8);
+	if (dwMagic != 0x8b1f || dwMethod != 8 || (dwFlags & ~(FlagText | FlagHeaderCrc | FlagExtra | FlagName | FlagComment)) != 0) {
+		bFailed = true;
+		return false;
+	}
+	// time stamp, extra flags, operating system
+	bits(16);
+	bits(16);
+	bits(16);
+	if (dwFlags & FlagExtra)
+		for (DWORD cbExtra = bits(16); cbExtra > 0 && !bFailed; --cbExtra)
+			bits(8);
+	if (dwFlags & FlagName)
+		while (bits(8) != 0 && !bFailed)
+			;
+	if (dwFlags & FlagComment)
+		while (bits(8) != 0 && !bFailed)
+			;
+	if (dwFlags & FlagHeaderCrc)
+		bits(16);
+	bInMember = !bFailed;
+	bInBlock = false;
+	bLastBlock = false;
+	dwCrc = 0xffffffffu;
+	cbMember = 0;
+	return bInMember;
+}
+
+
+void GzipReader::endMember()
+{
+	// the trailer starts at the next byte: CRC-32 and length of the text
+	bits(nBits & 7);
+	DWORD dwExpectedCrc = bits(16);
+	dwExpectedCrc |= bits(16) << 16;
+	DWORD cbExpected = bits(16);
+	cbExpected |= bits(16) << 16;
+	if (dwExpectedCrc != (dwCrc ^ 0xffffffffu) || cbExpected != cbMember)
+		bFailed = true;
+	bInMember = false;
+}
+
+
+void GzipReader::startBlock()
+{
+	bLastBlock = bits(1) != 0;
+	const DWORD dwType = bits(2);
+	if (dwType == 0) {
+		bits(nBits & 7);
+		const DWORD dwLength = bits(16);
+		const DWORD dwComplement = bits(16);
+		if ((dwLength ^ 0xffff) != dwComplement)
+			bFailed = true;
+		nStored = dwLength;
+		// an empty stored block ends at once
+		bInBlock = false;
+		return;
+	}
+	if (dwType == 1) {
+		BYTE anLengths[288];
+		memset(anLengths, 8, 144);
+		memset(anLengths + 144, 9, 112);
+		memset(anLengths + 256, 7, 24);
+		memset(anLengths + 280, 8, 8);
+		build(lengths, anLengths, 288);
+		memset(anLengths, 5, 30);
+		build(distances, anLengths, 30);
+	}
+	else if (dwType != 2 || !readCodes()) {
+		bFailed = true;
+		return;
+	}
+	bInBlock = true;
+}
+
+
+bool GzipReader::readCodes()
+{
+	// the literal/length and distance code lengths, themselves coded
+	// with a code whose lengths come first
+	const int nLengths = bits(5) + 257;
+	const int nDistances = bits(5) + 1;
+	const int nCodeLengths = bits(4) + 4;
+	if (nLengths > 286 || nDistances > 30)
+		return false;
+	BYTE anLengths[288 + 32];
+	memset(anLengths, 0, 19);
+	for (int i = 0; i < nCodeLengths; ++i)
+		anLengths[CodeLengthOrder[i]] = (BYTE)bits(3);
+	Huffman& codeLengths = distances;
+	if (!build(codeLengths, anLengths, 19))
+		return false;
+	int i = 0;
+	while (i < nLengths + nDistances && !bFailed) {
+		const int nSymbol = decode(codeLengths);
+		if (nSymbol < 0)
+			return false;
+		if (nSymbol < 16) {
+			anLengths[i++] = (BYTE)nSymbol;
+			continue;
+		}
+		BYTE nRepeat = 0;
+		int nTimes;
+		if (nSymbol == 16) {
+			if (i == 0)
+				return false;
+			nRepeat = anLengths[i - 1];
+			nTimes = 3 + bits(2);
+		}
+		else if (nSymbol == 17) {
+			nTimes = 3 + bits(3);
+		}
+		else {
+			nTimes = 11 + bits(7);
+		}
+		if (i + nTimes > nLengths + nDistances)
+			return false;
+		while (nTimes-- > 0)
+			anLengths[i++] = nRepeat;
+	}
+	// a block without an end-of-block code could never end
+	if (bFailed || anLengths[256] == 0)
+		return false;
+	return build(lengths, anLengths, nLengths) && build(distances, anLengths + nLengths, nDistances);
+}
+
+
+BYTE GzipReader::emit(BYTE b)
+{
+	pWindow[iWindow++ & (WindowSize - 1)] = b;
+	dwCrc = aCrcTable[(dwCrc ^ b) & 0xff] ^ (dwCrc >> 8);
+	++cbMember;
+	return b;
+}
+
+
+DWORD GzipReader::read(BYTE* pDest, DWORD cbMax)
+{
+	DWORD cb = 0;
+	while (cb < cbMax && !bEnd && !bFailed) {
+		if (nCopy > 0) {
+			// a match may overlap what it produces, so byte by byte
+			for (; nCopy > 0 && cb < cbMax; --nCopy)
+				pDest[cb++] = emit(pWindow[(iWindow - nDistance) & (WindowSize - 1)]);
+			continue;
+		}
+		if (nStored > 0) {
+			pDest[cb++] = emit((BYTE)bits(8));
+			--nStored;
+			continue;
+		}
+		if (!bInMember) {
+			startMember();
+			continue;
+		}
+		if (!bInBlock) {
+			if (bLastBlock)
+				endMember();
+			else
+				startBlock();
+			continue;
+		}
+		const int nSymbol = decode(lengths);
+		if (nSymbol < 256) {
+			if (nSymbol >= 0)
+				pDest[cb++] = emit((BYTE)nSymbol);
+			continue;
+		}
+		if (nSymbol == 256) {
+			bInBlock = false;
+			continue;
+		}
+		const int c = nSymbol - 257;
+		if (c >= 29) {
+			bFailed = true;
+			break;
+		}
+		nCopy = LengthBase[c] + bits(LengthExtra[c]);
+		const int d = decode(distances);
+		if (d < 0 || d >= 30) {
+			bFailed = true;
+			break;
+		}
+		nDistance = DistanceBase[d] + bits(DistanceExtra[d]);
+		// a member refers to nothing before its own start
+		if (nDistance > cbMember)
+			bFailed = true;
+	}
+	return cb;
+}
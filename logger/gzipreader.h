@@ -0,0 +1,88 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// Streaming decoder for gzip files: the ones GzipWriter writes, and
+/// those compressed by any other tool. A file is a sequence of members,
+/// each a deflate stream of stored, fixed or dynamic Huffman blocks
+/// (RFC 1951, 1952). read() works like ReadFile on the uncompressed
+/// text. The input buffer and the window of the last 32 KB of output are
+/// the caller's, so a reader taking them from an arena does not allocate.
+///
+/// restart() continues at the file pointer, which must then be at the
+/// start of a member, e.g. one whose offset LogIndex::lookup() has found
+/// in the index of a compressed log. Corrupt or truncated data, or a
+/// CRC or length that does not match a member, ends the stream and sets
+/// failed().
+class GzipReader {
+public:
+	static const DWORD InputSize = 64 * 1024;
+	static const DWORD WindowSize = 32768;
+
+	GzipReader();
+	void attach(HANDLE hFile, BYTE* pInput, BYTE* pWindow);
+	void restart();
+	DWORD read(BYTE* pDest, DWORD cbMax);
+	bool failed() const { return bFailed; }
+
+	static bool isGzip(const void* pData, size_t cb);
+	static bool isGzipFile(const TCHAR* pszFilename);
+
+private:
+	static const int FastBits = 9;
+	// canonical code as counts per length and symbols in code order,
+	// plus the codes up to FastBits long looked up in one step
+	struct Huffman {
+		WORD anCount[16];
+		WORD anSymbol[288];
+		WORD anFast[1 << FastBits];
+	};
+	HANDLE hFile;
+	BYTE* pInput;
+	DWORD cbInput;
+	DWORD iInput;
+	DWORD cbPastEnd;
+	BYTE* pWindow;
+	DWORD iWindow;
+	ULONGLONG ullBits;
+	int nBits;
+	bool bInMember;
+	bool bInBlock;
+	bool bLastBlock;
+	bool bEnd;
+	bool bFailed;
+	DWORD nStored;
+	DWORD nCopy;
+	DWORD nDistance;
+	DWORD dwCrc;
+	DWORD cbMember;
+	Huffman lengths;
+	Huffman distances;
+	DWORD aCrcTable[256];
+	void need(int n);
+	DWORD bits(int n);
+	int decode(const Huffman& h);
+	bool build(Huffman& h, const BYTE* anLengths, int n);
+	bool startMember();
+	void endMember();
+	void startBlock();
+	bool readCodes();
+	BYTE emit(BYTE b);
+};
@@ -0,0 +1,317 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "gzipwriter.h"
+#include <stdlib.h>
+#include <string.h>
+
+// RFC 1951 length and distance codes
+static const WORD LengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const BYTE LengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const WORD DistanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const BYTE DistanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const int MinMatch = 3;
+static const int MaxMatch = 258;
+static const int WindowSize = 32768;
+
+
+/// LSB-first bit packer for the deflate stream.
+struct BitWriter {
+	BYTE* p;
+	DWORD dwBits;
+	int nBits;
+	BitWriter(BYTE* p) : p(p), dwBits(0), nBits(0) { /* ... */ }
+	void put(DWORD dwValue, int n)
+	{
+		dwBits |= dwValue << nBits;
+		nBits += n;
+		while (nBits >= 8) {
+			*p++ = (BYTE)dwBits;
+			dwBits >>= 8;
+			nBits -= 8;
+		}
+	}
+	void putCode(DWORD dwCode, int n)
+	{
+		// Huffman codes go out most significant bit first
+		DWORD dwReversed = 0;
+		for (int i = 0; i < n; ++i)
+			dwReversed |= ((dwCode >> i) & 1) << (n - 1 - i);
+		put(dwReversed, n);
+	}
+	void putSymbol(int nSymbol)
+	{
+		if (nSymbol < 144)
+			putCode(0x30 + nSymbol, 8);
+		else if (nSymbol < 256)
+			putCode(0x190 + nSymbol - 144, 9);
+		else if (nSymbol < 280)
+			putCode(nSymbol - 256, 7);
+		else
+			putCode(0xc0 + nSymbol - 280, 8);
+	}
+	void finish()
+	{
+		if (nBits > 0)
+			*p++ = (BYTE)dwBits;
+		dwBits = 0;
+		nBits = 0;
+	}
+};
+
+
+GzipWriter::GzipWriter()
+	: hFile(INVALID_HANDLE_VALUE)
+	, pIndex(NULL)
+	, ullOffset(0)
+	, hThread(NULL)
+	, hWakeEvent(NULL)
+	, hTakenEvent(NULL)
+	, bStop(false)
+	, pOut(NULL)
+	, aHead(NULL)
+	, aPrev(NULL)
+{
+	front.p = back.p = NULL;
+	front.cb = back.cb = 0;
+	for (DWORD n = 0; n < 256; ++n) {
+		DWORD c = n;
+		for (int k = 0; k < 8; ++k)
+			c = (c & 1)? 0xedb88320u ^ (c >> 1) : c >> 1;
+		aCrcTable[n] = c;
+	}
+	InitializeCriticalSection(&cs);
+}
+
+
+GzipWriter::~GzipWriter()
+{
+	close();
+	DeleteCriticalSection(&cs);
+}
+
+
+void GzipWriter::freeBuffers()
+{
+	free(front.p);
+	free(back.p);
+	free(pOut);
+	free(aHead);
+	free(aPrev);
+	front.p = back.p = pOut = NULL;
+	aHead = aPrev = NULL;
+}
+
+
+bool GzipWriter::open(HANDLE hFile, LogIndex* pIndex, ULONGLONG ullOffset)
+{
+	close();
+	this->hFile = hFile;
+	this->pIndex = pIndex;
+	this->ullOffset = ullOffset;
+	// fixed Huffman codes take at most 9 bits per input byte
+	front.p = (BYTE*)malloc(MemberSize);
+	back.p = (BYTE*)malloc(MemberSize);
+	pOut = (BYTE*)malloc(MemberSize / 8 * 9 + 64);
+	aHead = (int*)malloc((1 << HashBits) * sizeof(int));
+	aPrev = (int*)malloc(MemberSize * sizeof(int));
+	front.cb = back.cb = 0;
+	hWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	hTakenEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	bStop = false;
+	if (front.p && back.p && pOut && aHead && aPrev && hWakeEvent && hTakenEvent)
+		hThread = CreateThread(NULL, 0, threadProc, this, 0, NULL);
+	if (hThread == NULL) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+void GzipWriter::close()
+{
+	// the thread compresses whatever is left before it exits
+	if (hThread) {
+		bStop = true;
+		SetEvent(hWakeEvent);
+		WaitForSingleObject(hThread, INFINITE);
+		CloseHandle(hThread);
+		hThread = NULL;
+	}
+	if (hWakeEvent)
+		CloseHandle(hWakeEvent);
+	if (hTakenEvent)
+		CloseHandle(hTakenEvent);
+	hWakeEvent = hTakenEvent = NULL;
+	freeBuffers();
+	hFile = INVALID_HANDLE_VALUE;
+	pIndex = NULL;
+}
+
+
+void GzipWriter::write(const char* p, size_t cb, ULONGLONG ullUtc)
+{
+	if (hThread == NULL)
+		return;
+	if (cb > MemberSize)
+		cb = MemberSize;
+	EnterCriticalSection(&cs);
+	while (front.cb + cb > MemberSize) {
+		// only when a burst outruns the compressor
+		LeaveCriticalSection(&cs);
+		SetEvent(hWakeEvent);
+		WaitForSingleObject(hTakenEvent, INFINITE);
+		EnterCriticalSection(&cs);
+	}
+	if (front.cb == 0)
+		front.ullFirstUtc = ullUtc;
+	memcpy(front.p + front.cb, p, cb);
+	front.cb += (DWORD)cb;
+	LeaveCriticalSection(&cs);
+	SetEvent(hWakeEvent);
+}
+
+
+DWORD WINAPI GzipWriter::threadProc(LPVOID pParam)
+{
+	((GzipWriter*)pParam)->run();
+	return 0;
+}
+
+
+void GzipWriter::run()
+{
+	for (;;) {
+		WaitForSingleObject(hWakeEvent, INFINITE);
+		if (!bStop)
+			Sleep(GatherMs);
+		EnterCriticalSection(&cs);
+		const Buffer taken = front;
+		front = back;
+		front.cb = 0;
+		back = taken;
+		const bool bDone = bStop;
+		LeaveCriticalSection(&cs);
+		SetEvent(hTakenEvent);
+		if (back.cb > 0)
+			writeMember(back);
+		if (bDone)
+			return;
+	}
+}
+
+
+DWORD GzipWriter::crc32(const BYTE* p, DWORD cb) const
+{
+	DWORD c = 0xffffffffu;
+	for (DWORD i = 0; i < cb; ++i)
+		c = aCrcTable[(c ^ p[i]) & 0xff] ^ (c >> 8);
+	return c ^ 0xffffffffu;
+}
+
+
+size_t GzipWriter::deflate(const BYTE* p, DWORD cb, BYTE* pDest)
+{
+	// a single final block with the fixed codes
+	BitWriter w(pDest);
+	w.put(1, 1);
+	w.put(1, 2);
+	memset(aHead, 0xff, (1 << HashBits) * sizeof(int));
+	int i = 0;
+	const int n = (int)cb;
+	while (i < n) {
+		int nBestLength = 0;
+		int nBestDistance = 0;
+		if (i + MinMatch <= n) {
+			const DWORD h = ((p[i] << 10) ^ (p[i + 1] << 5) ^ p[i + 2]) & ((1 << HashBits) - 1);
+			int j = aHead[h];
+			aPrev[i] = j;
+			aHead[h] = i;
+			const int nMax = n - i < MaxMatch? n - i : MaxMatch;
+			for (int nChain = MaxChain; j >= 0 && i - j <= WindowSize && nChain > 0; --nChain, j = aPrev[j]) {
+				if (p[j + nBestLength] != p[i + nBestLength])
+					continue;
+				int nLength = 0;
+				while (nLength < nMax && p[j + nLength] == p[i + nLength])
+					++nLength;
+				if (nLength > nBestLength) {
+					nBestLength = nLength;
+					nBestDistance = i - j;
+					if (nLength == nMax)
+						break;
+				}
+			}
+		}
+		if (nBestLength < MinMatch) {
+			w.putSymbol(p[i++]);
+			continue;
+		}
+		int c = 28;
+		while (LengthBase[c] > nBestLength)
+			--c;
+		w.putSymbol(257 + c);
+		w.put(nBestLength - LengthBase[c], LengthExtra[c]);
+		int d = 29;
+		while (DistanceBase[d] > nBestDistance)
+			--d;
+		w.putCode(d, 5);
+		w.put(nBestDistance - DistanceBase[d], DistanceExtra[d]);
+		// the skipped positions still go into the hash chains
+		for (int k = 1; k < nBestLength && i + k + MinMatch <= n; ++k) {
+			const DWORD h = ((p[i + k] << 10) ^ (p[i + k + 1] << 5) ^ p[i + k + 2]) & ((1 << HashBits) - 1);
+			aPrev[i + k] = aHead[h];
+			aHead[h] = i + k;
+		}
+		i += nBestLength;
+	}
+	w.putSymbol(256);
+	w.finish();
+	return w.p - pDest;
+}
+
+
+void GzipWriter::writeMember(const Buffer& b)
+{
+	// RFC 1952: magic, deflate, no flags, no time stamp, NTFS
+	static const BYTE Header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 11 };
+	BYTE* q = pOut;
+	memcpy(q, Header, sizeof(Header));
+	q += sizeof(Header);
+	q += deflate(b.p, b.cb, q);
+	const DWORD dwCrc = crc32(b.p, b.cb);
+	memcpy(q, &dwCrc, 4);
+	memcpy(q + 4, &b.cb, 4);
+	q += 8;
+	if (pIndex)
+		pIndex->record(b.ullFirstUtc, ullOffset);
+	DWORD dwWritten;
+	if (WriteFile(hFile, pOut, (DWORD)(q - pOut), &dwWritten, NULL))
+		ullOffset += dwWritten;
+	FlushFileBuffers(hFile);
+}
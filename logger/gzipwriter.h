@@ -0,0 +1,78 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include "logindex.h"
+
+/// Compresses the lines handed to it by Logger into a gzip file on a
+/// thread of its own, so that the thread writing the log only copies
+/// the line into a buffer. Whatever has accumulated when the thread
+/// wakes up (it waits GatherMs for the rest of a burst of lines) becomes
+/// one complete gzip member, which is written and flushed to disk at
+/// once. A crash therefore loses at most the member being compressed,
+/// the file can be appended to, and concatenated members are read by
+/// any gzip decoder. Members start at a line, so with an index every
+/// member's offset is recorded with the time of its first line, and a
+/// reader can start decompressing at the member covering the time it
+/// is looking for.
+///
+/// The encoder is a plain LZ77 matcher with the fixed Huffman codes of
+/// RFC 1951; log text is repetitive enough that dynamic codes would
+/// gain little over it.
+class GzipWriter {
+public:
+	static const DWORD MemberSize = 256 * 1024;
+	static const DWORD GatherMs = 100;
+
+	GzipWriter();
+	~GzipWriter();
+	bool open(HANDLE hFile, LogIndex* pIndex, ULONGLONG ullOffset);
+	void close();
+	bool isOpen() const { return hThread != NULL; }
+	void write(const char* p, size_t cb, ULONGLONG ullUtc);
+
+private:
+	static const int HashBits = 15;
+	static const int MaxChain = 32;
+	struct Buffer {
+		BYTE* p;
+		DWORD cb;
+		ULONGLONG ullFirstUtc;
+	};
+	HANDLE hFile;
+	LogIndex* pIndex;
+	ULONGLONG ullOffset;
+	HANDLE hThread;
+	HANDLE hWakeEvent;
+	HANDLE hTakenEvent;
+	volatile bool bStop;
+	CRITICAL_SECTION cs;
+	Buffer front;
+	Buffer back;
+	BYTE* pOut;
+	int* aHead;
+	int* aPrev;
+	DWORD aCrcTable[256];
+	static DWORD WINAPI threadProc(LPVOID pParam);
+	void run();
+	void writeMember(const Buffer& b);
+	size_t deflate(const BYTE* p, DWORD cb, BYTE* pDest);
+	DWORD crc32(const BYTE* p, DWORD cb) const;
+	void freeBuffers();
+};
@@ -0,0 +1,173 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "journal.h"
+
+const DWORD Journal::Magic = 0x4e4a4c41; // "ALJN"
+const DWORD Journal::Version = 1;
+
+
+Journal::Journal()
+	: hFile(INVALID_HANDLE_VALUE)
+	, hMapping(NULL)
+	, pBase(NULL)
+	, cbPayload(0)
+	, cbSlot(0)
+	, ullSeq(0)
+{
+	// ...
+}
+
+
+Journal::~Journal()
+{
+	close();
+}
+
+
+void Journal::close()
+{
+	if (pBase) {
+		FlushViewOfFile(pBase, 0);
+		FlushFileBuffers(hFile);
+		UnmapViewOfFile(pBase);
+	}
+	pBase = NULL;
+	if (hMapping)
+		CloseHandle(hMapping);
+	hMapping = NULL;
+	if (hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(hFile);
+	hFile = INVALID_HANDLE_VALUE;
+}
+
+
+bool Journal::open(const TCHAR* pszFilename, DWORD cbPayload)
+{
+	close();
+	this->cbPayload = cbPayload;
+	// keep slots 8-byte aligned so that the sequence number is never split
+	cbSlot = (sizeof(Slot) + cbPayload + 7) & ~7;
+	const DWORD cbFile = sizeof(Header) + 2 * cbSlot;
+	hFile = CreateFile(pszFilename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	hMapping = CreateFileMapping(hFile, NULL, PAGE_READWRITE, 0, cbFile, NULL);
+	if (hMapping == NULL) {
+		close();
+		return false;
+	}
+	pBase = (BYTE*)MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, cbFile);
+	if (pBase == NULL) {
+		close();
+		return false;
+	}
+	Header* pHeader = (Header*)pBase;
+	if (pHeader->dwMagic != Magic || pHeader->dwVersion != Version || pHeader->cbPayload != cbPayload) {
+		// new file or incompatible layout: start from scratch
+		ZeroMemory(pBase, cbFile);
+		pHeader->dwMagic = Magic;
+		pHeader->dwVersion = Version;
+		pHeader->cbPayload = cbPayload;
+		FlushViewOfFile(pBase, 0);
+		FlushFileBuffers(hFile);
+	}
+	ullSeq = 0;
+	for (int i = 0; i < 2; ++i)
+		if (isValid(slot(i)) && slot(i)->ullSeq > ullSeq)
+			ullSeq = slot(i)->ullSeq;
+	return true;
+}
+
+
+DWORD Journal::checksum(const Slot* pSlot) const
+{
+	// FNV-1a over the slot, skipping the checksum field itself
+	const BYTE* p = (const BYTE*)pSlot;
+	const DWORD cbHead = (DWORD)((const BYTE*)&pSlot->dwChecksum - p);
+	DWORD h = 2166136261u;
+	for (DWORD i = 0; i < cbHead; ++i)
+		h = (h ^ p[i]) * 16777619u;
+	p += sizeof(Slot);
+	for (DWORD i = 0; i < cbPayload; ++i)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+
+bool Journal::isValid(const Slot* pSlot) const
+{
+	return pSlot->ullSeq != 0 && pSlot->dwChecksum == checksum(pSlot);
+}
+
+
+void Journal::write(const void* pPayload, const FILETIME& ftIntervalStart, DWORD dwPending)
+{
+	if (pBase == NULL)
+		return;
+	++ullSeq;
+	// never overwrite the slot holding the latest good checkpoint
+	Slot* pSlot = slot((int)(ullSeq & 1));
+	pSlot->ullSeq = ullSeq;
+	pSlot->ftIntervalStart = ftIntervalStart;
+	GetSystemTimeAsFileTime(&pSlot->ftCheckpoint);
+	pSlot->dwPending = dwPending;
+	if (pPayload)
+		CopyMemory((BYTE*)pSlot + sizeof(Slot), pPayload, cbPayload);
+	else
+		ZeroMemory((BYTE*)pSlot + sizeof(Slot), cbPayload);
+	MemoryBarrier();
+	pSlot->dwChecksum = checksum(pSlot);
+	// the mapped pages survive a killed process anyway; for a power
+	// loss FlushViewOfFile() only starts writing the pages back, and
+	// only FlushFileBuffers() waits until they are on the disk
+	FlushViewOfFile(pSlot, cbSlot);
+	FlushFileBuffers(hFile);
+}
+
+
+void Journal::checkpoint(const void* pPayload, const FILETIME& ftIntervalStart)
+{
+	write(pPayload, ftIntervalStart, TRUE);
+}
+
+
+void Journal::clear()
+{
+	FILETIME ftNone = { 0, 0 };
+	write(NULL, ftNone, FALSE);
+}
+
+
+bool Journal::recover(void* pPayload, FILETIME* pftIntervalStart, FILETIME* pftCheckpoint) const
+{
+	if (pBase == NULL)
+		return false;
+	const Slot* pLatest = NULL;
+	for (int i = 0; i < 2; ++i) {
+		const Slot* pSlot = slot(i);
+		if (isValid(pSlot) && (pLatest == NULL || pSlot->ullSeq > pLatest->ullSeq))
+			pLatest = pSlot;
+	}
+	if (pLatest == NULL || !pLatest->dwPending)
+		return false;
+	CopyMemory(pPayload, (const BYTE*)pLatest + sizeof(Slot), cbPayload);
+	if (pftIntervalStart)
+		*pftIntervalStart = pLatest->ftIntervalStart;
+	if (pftCheckpoint)
+		*pftCheckpoint = pLatest->ftCheckpoint;
+	return true;
+}
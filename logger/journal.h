@@ -0,0 +1,64 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// Memory-mapped write-ahead journal for the counters of the interval
+/// currently being collected. The file holds two slots which are written
+/// alternately; each slot carries a sequence number and a checksum, so a
+/// torn write never destroys the previous checkpoint.
+class Journal {
+public:
+	Journal();
+	~Journal();
+	bool open(const TCHAR* pszFilename, DWORD cbPayload);
+	void close();
+	bool isOpen() const { return pBase != NULL; }
+	void checkpoint(const void* pPayload, const FILETIME& ftIntervalStart);
+	void clear();
+	bool recover(void* pPayload, FILETIME* pftIntervalStart, FILETIME* pftCheckpoint) const;
+
+private:
+	static const DWORD Magic;
+	static const DWORD Version;
+	struct Header {
+		DWORD dwMagic;
+		DWORD dwVersion;
+		DWORD cbPayload;
+		DWORD dwReserved;
+	};
+	struct Slot {
+		ULONGLONG ullSeq;
+		FILETIME ftIntervalStart;
+		FILETIME ftCheckpoint;
+		DWORD dwPending;
+		DWORD dwChecksum;
+		// payload follows
+	};
+	HANDLE hFile;
+	HANDLE hMapping;
+	BYTE* pBase;
+	DWORD cbPayload;
+	DWORD cbSlot;
+	ULONGLONG ullSeq;
+	Slot* slot(int i) const { return (Slot*)(pBase + sizeof(Header) + i * cbSlot); }
+	DWORD checksum(const Slot* pSlot) const;
+	bool isValid(const Slot* pSlot) const;
+	void write(const void* pPayload, const FILETIME& ftIntervalStart, DWORD dwPending);
+};
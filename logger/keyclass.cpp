@@ -0,0 +1,55 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "keyclass.h"
+
+// short aliases to keep the table readable
+enum {
+	Let = KeyLetter,
+	Dig = KeyDigit,
+	Mod = KeyModifier,
+	Nav = KeyNavigation,
+	Edi = KeyEditing,
+	Fun = KeyFunction,
+	Oth = KeyOther
+};
+
+// letters: A-Z; digits: 0-9 and the numeric keypad digits; modifiers:
+// Shift, Ctrl, Alt, Windows, Caps/Num/Scroll Lock; navigation: Page
+// Up/Down, End, Home, arrows; editing: Backspace, Tab, Clear, Enter,
+// Space, Insert, Delete; function keys: F1-F24
+const BYTE KeyClassTable::aClasses[256] = {
+	Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Edi, Edi, Oth, Oth, Edi, Edi, Oth, Oth,	// 0x00
+	Mod, Mod, Mod, Oth, Mod, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth,	// 0x10
+	Edi, Nav, Nav, Nav, Nav, Nav, Nav, Nav, Nav, Oth, Oth, Oth, Oth, Edi, Edi, Oth,	// 0x20
+	Dig, Dig, Dig, Dig, Dig, Dig, Dig, Dig, Dig, Dig, Oth, Oth, Oth, Oth, Oth, Oth,	// 0x30
+	Oth, Let, Let, Let, Let, Let, Let, Let, Let, Let, Let, Let, Let, Let, Let, Let,	// 0x40
+	Let, Let, Let, Let, Let, Let, Let, Let, Let, Let, Let, Mod, Mod, Oth, Oth, Oth,	// 0x50
+	Dig, Dig, Dig, Dig, Dig, Dig, Dig, Dig, Dig, Dig, Oth, Oth, Oth, Oth, Oth, Oth,	// 0x60
+	Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun,	// 0x70
+	Fun, Fun, Fun, Fun, Fun, Fun, Fun, Fun, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth,	// 0x80
+	Mod, Mod, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth,	// 0x90
+	Mod, Mod, Mod, Mod, Mod, Mod, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth,	// 0xA0
+	Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth,	// 0xB0
+	Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth,	// 0xC0
+	Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth,	// 0xD0
+	Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth,	// 0xE0
+	Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth, Oth 	// 0xF0
+};
+
+const char* KeyClassTable::apszNames[NumKeyClasses] = {
+	"letters", "digits", "modifiers", "navigation", "editing", "function", "other"
+};
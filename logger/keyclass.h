@@ -0,0 +1,44 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+
+/// Coarse key classes for the privacy preserving key statistics: which
+/// kind of key was pressed, but not which one.
+enum KeyClass {
+	KeyLetter,
+	KeyDigit,
+	KeyModifier,
+	KeyNavigation,
+	KeyEditing,
+	KeyFunction,
+	KeyOther,
+	NumKeyClasses
+};
+
+/// Maps virtual key codes to key classes through a fixed 256-entry table,
+/// so the hook never stores a key code itself.
+class KeyClassTable {
+public:
+	static KeyClass classOf(DWORD dwKeyCode) { return (KeyClass)aClasses[dwKeyCode & 0xff]; }
+	static const char* name(int nClass) { return apszNames[nClass]; }
+
+private:
+	static const BYTE aClasses[256];
+	static const char* apszNames[NumKeyClasses];
+};
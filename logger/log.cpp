@@ -15,6 +15,7 @@
 ///
 
 #include "log.h"
+#include "gzipreader.h"
 #include <strsafe.h>
 #include <Shlwapi.h>
 
@@ -24,6 +25,11 @@ const TCHAR* Logger::ConsoleOutputFile = TEXT("CONOUT$");
 Logger::Logger()
 	: hOutputFile(NULL)
 	, pszOutputFile(ConsoleOutputFile)
+	, ullOffset(0)
+	, nIndexEvery(0)
+	, bCompress(false)
+	, ullLineUtc(0)
+	, cchPending(0)
 {
 	// ...
 }
@@ -37,9 +43,12 @@ Logger::~Logger()
 
 void Logger::close()
 {
+	writePending();
+	gzip.close();
 	if (hOutputFile)
 		CloseHandle(hOutputFile);
 	hOutputFile = NULL;
+	index.close();
 }
 
 
@@ -50,27 +59,77 @@ void Logger::setFilename(const TCHAR* pszFilename)
 }
 
 
+bool Logger::isConsole() const
+{
+	return StrCmp(pszOutputFile, ConsoleOutputFile) == 0;
+}
+
+
 bool Logger::open(bool bOverwrite, const TCHAR* pszFilename)
 {
 	close();
 	if (pszFilename)
 		setFilename(pszFilename);
-	if (StrCmp(pszOutputFile, ConsoleOutputFile) == 0)
+	if (isConsole())
 		bOverwrite = true;
-	hOutputFile = CreateFile(pszOutputFile, bOverwrite? GENERIC_WRITE : FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-	return hOutputFile != INVALID_HANDLE_VALUE;
+	hOutputFile = CreateFile(pszOutputFile, bOverwrite? GENERIC_WRITE : (FILE_APPEND_DATA | FILE_READ_ATTRIBUTES), FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hOutputFile == INVALID_HANDLE_VALUE)
+		return false;
+	ullOffset = 0;
+	cchPending = 0;
+	// a stale tail behind the new records would not even decompress
+	if (bOverwrite && !isConsole())
+		SetEndOfFile(hOutputFile);
+	LARGE_INTEGER liSize;
+	if (!bOverwrite && GetFileSizeEx(hOutputFile, &liSize))
+		ullOffset = liSize.QuadPart;
+	// readers tell from the first bytes how to read the whole file, so
+	// text and gzip members must never end up in the same one
+	if (ullOffset > 0 && !isConsole() && GzipReader::isGzipFile(pszOutputFile) != bCompress) {
+		CloseHandle(hOutputFile);
+		hOutputFile = NULL;
+		SetLastError(ERROR_BAD_FORMAT);
+		return false;
+	}
+	if (bCompress && !isConsole()) {
+		// the index then points at gzip members, one entry each
+		if (nIndexEvery > 0 && !index.open(pszOutputFile, 1, bOverwrite, ullOffset))
+			return false;
+		return gzip.open(hOutputFile, index.isOpen()? &index : NULL, ullOffset);
+	}
+	if (nIndexEvery > 0 && !isConsole())
+		return index.open(pszOutputFile, nIndexEvery, bOverwrite, ullOffset);
+	return true;
 }
 
 
-void Logger::logv(const TCHAR* pszFormat, va_list args)
+void Logger::writePending()
 {
-	static const DWORD dwBufSize = 2048;
-	TCHAR pszDest[dwBufSize];
-	size_t szLength;
-	StringCchVPrintf(pszDest, dwBufSize, pszFormat, args);
-	StringCchLength(pszDest, dwBufSize, &szLength);
+	if (cchPending == 0 || hOutputFile == NULL)
+		return;
+	if (gzip.isOpen()) {
+		gzip.write(achPending, cchPending, ullLineUtc);
+		ullOffset += cchPending;
+		cchPending = 0;
+		return;
+	}
 	DWORD dwBytesWritten;
-	WriteFile(hOutputFile, pszDest, szLength, &dwBytesWritten, NULL);
+	if (WriteFile(hOutputFile, achPending, (DWORD)cchPending, &dwBytesWritten, NULL))
+		ullOffset += dwBytesWritten;
+	cchPending = 0;
+}
+
+
+void Logger::logv(const TCHAR* pszFormat, va_list args)
+{
+	// the fragments of a line are collected and written in one go by
+	// flush(), instead of one WriteFile per fragment
+	if (PendingSize - cchPending < MaxFragment)
+		writePending();
+	size_t cchLength;
+	StringCchVPrintf(achPending + cchPending, PendingSize - cchPending, pszFormat, args);
+	StringCchLength(achPending + cchPending, PendingSize - cchPending, &cchLength);
+	cchPending += cchLength;
 }
 
 
@@ -83,8 +142,25 @@ void Logger::log(const TCHAR* pszFormat, ...)
 }
 
 
+void Logger::recordOffset()
+{
+	if (index.isOpen() || gzip.isOpen()) {
+		FILETIME ft;
+		GetSystemTimeAsFileTime(&ft);
+		ULARGE_INTEGER u;
+		u.LowPart = ft.dwLowDateTime;
+		u.HighPart = ft.dwHighDateTime;
+		ullLineUtc = u.QuadPart;
+		// with compression the writer thread indexes whole members
+		if (!gzip.isOpen())
+			index.record(u.QuadPart, offset());
+	}
+}
+
+
 void Logger::logTimestamp()
 {
+	recordOffset();
 	SYSTEMTIME t;
 	GetLocalTime(&t);
 	log(TEXT("%4d-%02d-%02d %02d:%02d:%02d "), t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond);
@@ -94,7 +170,9 @@ void Logger::logTimestamp()
 void Logger::flush()
 {
 	log(TEXT("\r\n"));
-	FlushFileBuffers(hOutputFile);
+	writePending();
+	if (!gzip.isOpen())
+		FlushFileBuffers(hOutputFile);
 }
 
 
@@ -123,3 +201,20 @@ void Logger::logWithTimestampNoLF(const TCHAR* pszFormat, ...)
 	logWithTimestampNoLFv(pszFormat, argp);
 	va_end(argp);
 }
+
+
+void Logger::writeRecord(const char* pData, size_t cbData)
+{
+	// a complete, already formatted record including its line break
+	writePending();
+	recordOffset();
+	if (gzip.isOpen()) {
+		gzip.write(pData, cbData, ullLineUtc);
+		ullOffset += cbData;
+		return;
+	}
+	DWORD dwBytesWritten;
+	if (WriteFile(hOutputFile, pData, (DWORD)cbData, &dwBytesWritten, NULL))
+		ullOffset += dwBytesWritten;
+	FlushFileBuffers(hOutputFile);
+}
@@ -19,25 +19,44 @@
 #include <windows.h>
 #include <tchar.h>
 #include <stdarg.h>
+#include "logindex.h"
+#include "gzipwriter.h"
 
 class Logger {
 public:
 	Logger();
 	~Logger();
 	void setFilename(const TCHAR* pszFilename);
+	void setIndex(UINT nEvery) { nIndexEvery = nEvery; }
+	void setCompression(bool bCompress) { this->bCompress = bCompress; }
 	bool open(bool bOverwrite, const TCHAR* pszFilename = NULL);
 	void log(const TCHAR* pszFormat, ...);
 	void flush();
 	void close();
 	void logWithTimestamp(const TCHAR* pszFormat, ...);
 	void logWithTimestampNoLF(const TCHAR* pszFormat, ...);
+	void writeRecord(const char* pData, size_t cbData);
 	const TCHAR* filename() const { return pszOutputFile; }
+	bool isConsole() const;
+	ULONGLONG offset() const { return ullOffset + cchPending; }
 
 private:
 	static const TCHAR* ConsoleOutputFile;
+	static const size_t PendingSize = 8192;
+	static const size_t MaxFragment = 2048;
 	const TCHAR* pszOutputFile;
 	HANDLE hOutputFile;
+	ULONGLONG ullOffset;
+	UINT nIndexEvery;
+	LogIndex index;
+	bool bCompress;
+	GzipWriter gzip;
+	ULONGLONG ullLineUtc;
+	TCHAR achPending[PendingSize];
+	size_t cchPending;
+	void writePending();
 	void logv(const TCHAR* pszFormat, va_list args);
+	void recordOffset();
 	void logTimestamp();
 	void logWithTimestampNoLFv(const TCHAR* pszFormat, va_list argp);
 };
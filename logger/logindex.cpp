@@ -0,0 +1,226 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "logindex.h"
+#include "logparse.h"
+#include "gzipreader.h"
+#include <strsafe.h>
+#include <stdlib.h>
+
+const TCHAR* LogIndex::Extension = TEXT(".idx");
+const DWORD LogIndex::Magic = 0x58444941; // "AIDX"
+const DWORD LogIndex::Version = 1;
+
+
+LogIndex::LogIndex()
+	: hFile(INVALID_HANDLE_VALUE)
+	, nEvery(1)
+	, nRecords(0)
+	, ullLastUtc(0)
+{
+	// ...
+}
+
+
+LogIndex::~LogIndex()
+{
+	close();
+}
+
+
+void LogIndex::close()
+{
+	if (hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(hFile);
+	hFile = INVALID_HANDLE_VALUE;
+}
+
+
+void LogIndex::indexFilename(const TCHAR* pszLogFile, TCHAR* pszDest, size_t cchDest)
+{
+	StringCchPrintf(pszDest, cchDest, TEXT("%s%s"), pszLogFile, Extension);
+}
+
+
+bool LogIndex::writeHeader()
+{
+	Header h = { Magic, Version, nEvery, 0 };
+	DWORD dwBytesWritten;
+	return WriteFile(hFile, &h, sizeof(h), &dwBytesWritten, NULL) && dwBytesWritten == sizeof(h);
+}
+
+
+bool LogIndex::open(const TCHAR* pszLogFile, UINT nEvery, bool bTruncate, ULONGLONG ullLogSize)
+{
+	close();
+	this->nEvery = nEvery > 0? nEvery : 1;
+	nRecords = 0;
+	ullLastUtc = 0;
+	TCHAR szIndexFile[MAX_PATH];
+	indexFilename(pszLogFile, szIndexFile, MAX_PATH);
+	if (!bTruncate) {
+		// an index that does not match the log is rebuilt from the log
+		bool bValid = false;
+		HANDLE h = CreateFile(szIndexFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h != INVALID_HANDLE_VALUE) {
+			Header hdr;
+			Entry last;
+			LARGE_INTEGER liSize;
+			DWORD dwRead;
+			if (ReadFile(h, &hdr, sizeof(hdr), &dwRead, NULL) && dwRead == sizeof(hdr)
+				&& hdr.dwMagic == Magic && hdr.dwVersion == Version && hdr.nEvery == this->nEvery
+				&& GetFileSizeEx(h, &liSize) && (liSize.QuadPart - sizeof(Header)) % sizeof(Entry) == 0) {
+				bValid = true;
+				if (liSize.QuadPart > (LONGLONG)sizeof(Header)) {
+					LARGE_INTEGER liPos;
+					liPos.QuadPart = liSize.QuadPart - sizeof(Entry);
+					bValid = SetFilePointerEx(h, liPos, NULL, FILE_BEGIN)
+						&& ReadFile(h, &last, sizeof(last), &dwRead, NULL) && dwRead == sizeof(last)
+						&& last.ullOffset < ullLogSize;
+					ullLastUtc = last.ullUtc;
+				}
+				else {
+					bValid = ullLogSize == 0;
+				}
+			}
+			CloseHandle(h);
+		}
+		// a compressed log is indexed by member as it is written, which
+		// cannot be redone from the file; rebuild() refuses it
+		if (!bValid && !rebuild(pszLogFile, this->nEvery))
+			return false;
+	}
+	hFile = CreateFile(szIndexFile, bTruncate? GENERIC_WRITE : FILE_APPEND_DATA, FILE_SHARE_READ, NULL, bTruncate? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	if (bTruncate && !writeHeader()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+void LogIndex::append(ULONGLONG ullUtc, ULONGLONG ullOffset)
+{
+	// keep the index sorted even if the wall clock is stepped back;
+	// a reader then merely starts scanning a little early
+	if (ullUtc < ullLastUtc)
+		ullUtc = ullLastUtc;
+	Entry e = { ullUtc, ullOffset };
+	DWORD dwBytesWritten;
+	WriteFile(hFile, &e, sizeof(e), &dwBytesWritten, NULL);
+	ullLastUtc = ullUtc;
+}
+
+
+void LogIndex::record(ULONGLONG ullUtc, ULONGLONG ullOffset)
+{
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+	if (nRecords++ % nEvery == 0)
+		append(ullUtc, ullOffset);
+}
+
+
+bool LogIndex::rebuild(const TCHAR* pszLogFile, UINT nEvery)
+{
+	// scan the whole log once and write a fresh index next to it; the
+	// offsets of a compressed log are those of its gzip members, which a
+	// scan for line starts cannot find, so its index is left alone
+	if (GzipReader::isGzipFile(pszLogFile))
+		return false;
+	HANDLE hLog = CreateFile(pszLogFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hLog == INVALID_HANDLE_VALUE)
+		return false;
+	LogIndex index;
+	index.nEvery = nEvery > 0? nEvery : 1;
+	TCHAR szIndexFile[MAX_PATH];
+	indexFilename(pszLogFile, szIndexFile, MAX_PATH);
+	index.hFile = CreateFile(szIndexFile, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (index.hFile == INVALID_HANDLE_VALUE || !index.writeHeader()) {
+		CloseHandle(hLog);
+		return false;
+	}
+	static const DWORD BufSize = 64 * 1024;
+	char* pBuf = (char*)malloc(BufSize);
+	char szLine[24];
+	size_t cbLine = 0;
+	bool bLineStart = true;
+	ULONGLONG ullOffset = 0, ullLineOffset = 0;
+	DWORD dwRead;
+	while (ReadFile(hLog, pBuf, BufSize, &dwRead, NULL) && dwRead > 0) {
+		for (DWORD i = 0; i < dwRead; ++i, ++ullOffset) {
+			const char c = pBuf[i];
+			if (bLineStart) {
+				ullLineOffset = ullOffset;
+				cbLine = 0;
+				bLineStart = false;
+			}
+			if (c == '\n') {
+				bLineStart = true;
+				ULONGLONG ullUtc;
+				if (LogParser::parseTimestamp(szLine, cbLine, &ullUtc))
+					index.record(ullUtc, ullLineOffset);
+			}
+			else if (cbLine < sizeof(szLine)) {
+				szLine[cbLine++] = c;
+			}
+		}
+	}
+	free(pBuf);
+	CloseHandle(hLog);
+	return true;
+}
+
+
+bool LogIndex::lookup(const TCHAR* pszLogFile, ULONGLONG ullUtc, ULONGLONG* pullOffset)
+{
+	// offset of the last indexed record not later than ullUtc (0 if none)
+	TCHAR szIndexFile[MAX_PATH];
+	indexFilename(pszLogFile, szIndexFile, MAX_PATH);
+	HANDLE h = CreateFile(szIndexFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (h == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER liSize;
+	bool bOk = false;
+	if (GetFileSizeEx(h, &liSize) && liSize.QuadPart >= (LONGLONG)sizeof(Header)) {
+		*pullOffset = 0;
+		bOk = true;
+		const ULONGLONG nEntries = (liSize.QuadPart - sizeof(Header)) / sizeof(Entry);
+		HANDLE hMapping = nEntries > 0? CreateFileMapping(h, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+		const BYTE* pBase = hMapping? (const BYTE*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (pBase) {
+			// only the O(log n) probed pages are ever faulted in
+			const Entry* pEntries = (const Entry*)(pBase + sizeof(Header));
+			ULONGLONG lo = 0, hi = nEntries;
+			while (lo < hi) {
+				const ULONGLONG mid = lo + (hi - lo) / 2;
+				if (pEntries[mid].ullUtc <= ullUtc)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			if (lo > 0)
+				*pullOffset = pEntries[lo - 1].ullOffset;
+			UnmapViewOfFile(pBase);
+		}
+		if (hMapping)
+			CloseHandle(hMapping);
+	}
+	CloseHandle(h);
+	return bOk;
+}
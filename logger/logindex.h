@@ -0,0 +1,61 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// Sparse time index for a log written by Logger. Every n-th record
+/// the UTC time (FILETIME units) and the byte offset of the record are
+/// appended to a sidecar file '<log>.idx'. Entries are kept in
+/// non-decreasing time order, so readers can binary-search for the
+/// offset to start scanning from.
+class LogIndex {
+public:
+	struct Entry {
+		ULONGLONG ullUtc;
+		ULONGLONG ullOffset;
+	};
+	static const TCHAR* Extension;
+
+	LogIndex();
+	~LogIndex();
+	bool open(const TCHAR* pszLogFile, UINT nEvery, bool bTruncate, ULONGLONG ullLogSize);
+	void close();
+	bool isOpen() const { return hFile != INVALID_HANDLE_VALUE; }
+	void record(ULONGLONG ullUtc, ULONGLONG ullOffset);
+
+	static bool rebuild(const TCHAR* pszLogFile, UINT nEvery);
+	static bool lookup(const TCHAR* pszLogFile, ULONGLONG ullUtc, ULONGLONG* pullOffset);
+
+private:
+	static const DWORD Magic;
+	static const DWORD Version;
+	struct Header {
+		DWORD dwMagic;
+		DWORD dwVersion;
+		DWORD nEvery;
+		DWORD dwReserved;
+	};
+	HANDLE hFile;
+	UINT nEvery;
+	UINT nRecords;
+	ULONGLONG ullLastUtc;
+	bool writeHeader();
+	void append(ULONGLONG ullUtc, ULONGLONG ullOffset);
+	static void indexFilename(const TCHAR* pszLogFile, TCHAR* pszDest, size_t cchDest);
+};
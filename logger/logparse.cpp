@@ -0,0 +1,317 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "logparse.h"
+#include <stdlib.h>
+#include <string.h>
+
+// with their lengths, which classify() compares before any text
+static const struct {
+	const char* pszName;
+	size_t cb;
+} TypeNames[NumRecordTypes] = {
+	{ "", 0 }, { "INTERVAL", 8 }, { "PARTIAL", 7 }, { "RECOVER", 7 },
+	{ "MOVE", 4 }, { "WHEEL", 5 }, { "CLICK", 5 }, { "DBLCLICK", 8 },
+	{ "KEYSTAT", 7 }, { "START", 5 }, { "STOP", 4 }, { "BREAK", 5 },
+	{ "CLOSED", 6 }, { "LOGOFF", 6 }, { "SHUTDOWN", 8 }, { "CLOCK", 5 },
+	{ "KEYCLASS", 8 }, { "SELFSTAT", 8 }, { "WARP", 4 }, { "ACTIVE", 6 },
+	{ "ANOMALY", 7 }, { "CONFIG", 6 }, { "DEVICE", 6 }
+};
+
+static const double Pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+
+
+static inline bool isDigit(char c)
+{
+	return (unsigned)(c - '0') < 10;
+}
+
+
+static inline const char* skipSpaces(const char* p, const char* pEnd)
+{
+	while (p < pEnd && *p == ' ')
+		++p;
+	return p;
+}
+
+
+static inline bool parseFourDigits(const char* p, int* anDest)
+{
+	// "d,d,d,d," in one 64-bit load: commas in the odd bytes, digits in
+	// the even ones. Each digit has 16 bits to itself, so adding to it
+	// carries into bit 8 of its lane and never into the next digit.
+	ULONGLONG u;
+	memcpy(&u, p, sizeof(u));
+	if ((u & 0xff00ff00ff00ff00ULL) != 0x2c002c002c002c00ULL)
+		return false;
+	const ULONGLONG x = u & 0x00ff00ff00ff00ffULL;
+	const ULONGLONG ullAbove9 = (x + 0x00c600c600c600c6ULL) & 0x0100010001000100ULL;
+	const ULONGLONG ullFrom0 = (x + 0x00d000d000d000d0ULL) & 0x0100010001000100ULL;
+	if (ullAbove9 != 0 || ullFrom0 != 0x0100010001000100ULL)
+		return false;
+	anDest[0] = (int)(x & 0xff) - '0';
+	anDest[1] = (int)((x >> 16) & 0xff) - '0';
+	anDest[2] = (int)((x >> 32) & 0xff) - '0';
+	anDest[3] = (int)((x >> 48) & 0xff) - '0';
+	return true;
+}
+
+
+static const char* parseUInt(const char* p, const char* pEnd, ULONGLONG* pullValue)
+{
+	ULONGLONG v = 0;
+	while (p < pEnd && isDigit(*p))
+		v = v * 10 + (*p++ - '0');
+	*pullValue = v;
+	return p;
+}
+
+
+static const char* parseInt(const char* p, const char* pEnd, int* pnValue)
+{
+	const bool bNegative = p < pEnd && *p == '-';
+	ULONGLONG v;
+	p = parseUInt(p + (bNegative? 1 : 0), pEnd, &v);
+	*pnValue = bNegative? -(int)v : (int)v;
+	return p;
+}
+
+
+static const char* parseReal(const char* p, const char* pEnd, double* pfValue)
+{
+	// "%lf" output: [-]digits[.digits]; anything else goes the slow way
+	const char* pStart = p;
+	const bool bNegative = p < pEnd && *p == '-';
+	if (bNegative)
+		++p;
+	ULONGLONG ullMantissa = 0;
+	int nDigits = 0;
+	int nDecimals = 0;
+	while (p < pEnd && isDigit(*p)) {
+		ullMantissa = ullMantissa * 10 + (*p++ - '0');
+		++nDigits;
+	}
+	if (p < pEnd && *p == '.') {
+		++p;
+		while (p < pEnd && isDigit(*p)) {
+			ullMantissa = ullMantissa * 10 + (*p++ - '0');
+			++nDigits;
+			++nDecimals;
+		}
+	}
+	if (nDigits > 18 || (p < pEnd && (*p == 'e' || *p == 'E' || *p == 'n' || *p == 'i'))) {
+		char sz[64];
+		const size_t cb = pEnd - pStart < 63? pEnd - pStart : 63;
+		memcpy(sz, pStart, cb);
+		sz[cb] = 0;
+		char* pStop;
+		*pfValue = strtod(sz, &pStop);
+		return pStart + (pStop - sz);
+	}
+	const double f = (double)ullMantissa / Pow10[nDecimals];
+	*pfValue = bNegative? -f : f;
+	return p;
+}
+
+
+const char* LogParser::name(RecordType type)
+{
+	return TypeNames[type].pszName;
+}
+
+
+RecordType LogParser::classify(const char* p, size_t cb)
+{
+	// the length and first letter rule out all but one or two names
+	for (int i = 1; i < NumRecordTypes; ++i)
+		if (TypeNames[i].cb == cb && TypeNames[i].pszName[0] == p[0] && memcmp(TypeNames[i].pszName, p, cb) == 0)
+			return (RecordType)i;
+	return RecordUnknown;
+}
+
+
+bool LogParser::parseStamp(const char* p, size_t cb, LogRecord* pRecord)
+{
+	// "YYYY-MM-DD hh:mm:ss "
+	if (cb < 20 || p[4] != '-' || p[7] != '-' || p[10] != ' ' || p[13] != ':' || p[16] != ':' || p[19] != ' ')
+		return false;
+	static const int aDigits[] = { 0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, 17, 18 };
+	unsigned uBad = 0;
+	for (int i = 0; i < 14; ++i)
+		uBad |= (unsigned)(p[aDigits[i]] - '0') >= 10;
+	if (uBad)
+		return false;
+	pRecord->wYear = (WORD)((p[0] - '0') * 1000 + (p[1] - '0') * 100 + (p[2] - '0') * 10 + (p[3] - '0'));
+	pRecord->wMonth = (WORD)((p[5] - '0') * 10 + (p[6] - '0'));
+	pRecord->wDay = (WORD)((p[8] - '0') * 10 + (p[9] - '0'));
+	pRecord->wHour = (WORD)((p[11] - '0') * 10 + (p[12] - '0'));
+	pRecord->wMinute = (WORD)((p[14] - '0') * 10 + (p[15] - '0'));
+	pRecord->wSecond = (WORD)((p[17] - '0') * 10 + (p[18] - '0'));
+	return true;
+}
+
+
+bool LogParser::toUtc(const LogRecord& r, ULONGLONG* pullUtc)
+{
+	// with the daylight saving rule in force on the stamp's own date, so
+	// that stamps from either side of a change convert like the UTC times
+	// Logger puts into a live index
+	SYSTEMTIME tLocal, t;
+	ZeroMemory(&tLocal, sizeof(tLocal));
+	tLocal.wYear = r.wYear;
+	tLocal.wMonth = r.wMonth;
+	tLocal.wDay = r.wDay;
+	tLocal.wHour = r.wHour;
+	tLocal.wMinute = r.wMinute;
+	tLocal.wSecond = r.wSecond;
+	FILETIME ft;
+	if (!TzSpecificLocalTimeToSystemTime(NULL, &tLocal, &t) || !SystemTimeToFileTime(&t, &ft))
+		return false;
+	ULARGE_INTEGER u;
+	u.LowPart = ft.dwLowDateTime;
+	u.HighPart = ft.dwHighDateTime;
+	*pullUtc = u.QuadPart;
+	return true;
+}
+
+
+bool LogParser::parseTimestamp(const char* p, size_t cb, ULONGLONG* pullUtc)
+{
+	LogRecord r;
+	return parseStamp(p, cb, &r) && toUtc(r, pullUtc);
+}
+
+
+void LogParser::parseArgs(LogRecord& r, int* anKeys)
+{
+	const char* p = r.args.p;
+	const char* const pEnd = r.args.p + r.args.cb;
+	switch (r.type)
+	{
+	case RecordInterval:
+		// "start end ns, events first last ns"
+		p = parseUInt(p, pEnd, &r.ullStartNs);
+		p = parseUInt(skipSpaces(p, pEnd), pEnd, &r.ullEndNs);
+		while (p < pEnd && !isDigit(*p))
+			++p;
+		p = parseUInt(p, pEnd, &r.ullFirstEventNs);
+		parseUInt(skipSpaces(p, pEnd), pEnd, &r.ullLastEventNs);
+		break;
+	case RecordPartial:
+		// "secs secs"
+		parseReal(p, pEnd, &r.fValue);
+		break;
+	case RecordMove:
+		// "px px (m m)"
+		p = parseReal(p, pEnd, &r.fValue);
+		while (p < pEnd && *p != '(')
+			++p;
+		if (p < pEnd)
+			parseReal(p + 1, pEnd, &r.fMeters);
+		break;
+	case RecordWarp:
+		// "n (px px)"
+		p = parseInt(p, pEnd, &r.nCount);
+		while (p < pEnd && *p != '(')
+			++p;
+		if (p < pEnd)
+			parseReal(p + 1, pEnd, &r.fValue);
+		break;
+	case RecordWheel:
+	case RecordClick:
+	case RecordDoubleClick:
+		parseInt(p, pEnd, &r.nCount);
+		break;
+	case RecordKeyStat:
+		// 256 comma-separated counts; the hot path of KEYSTAT-heavy logs.
+		// Most counts are single digits, which go four at a time.
+		if (anKeys == NULL)
+			break;
+		while (p < pEnd && r.nCount < 256) {
+			while (pEnd - p >= 8 && r.nCount <= 252 && parseFourDigits(p, anKeys + r.nCount)) {
+				p += 8;
+				r.nCount += 4;
+			}
+			if (p == pEnd || r.nCount == 256)
+				break;
+			ULONGLONG v = 0;
+			while (p < pEnd && isDigit(*p))
+				v = v * 10 + (*p++ - '0');
+			anKeys[r.nCount++] = (int)v;
+			if (p == pEnd || *p != ',')
+				break;
+			++p;
+		}
+		break;
+	case RecordKeyClass:
+		// "letters n, digits n, ..." in KeyClass order
+		if (anKeys == NULL)
+			break;
+		while (p < pEnd && r.nCount < 256) {
+			while (p < pEnd && !isDigit(*p))
+				++p;
+			if (p == pEnd)
+				break;
+			ULONGLONG v;
+			p = parseUInt(p, pEnd, &v);
+			anKeys[r.nCount++] = (int)v;
+		}
+		break;
+	case RecordStart:
+		// "interval = n secs, dpi = x"
+		while (p < pEnd && !isDigit(*p))
+			++p;
+		p = parseInt(p, pEnd, &r.nCount);
+		while (p < pEnd && *p != ',')
+			++p;
+		while (p < pEnd && !isDigit(*p) && *p != '-')
+			++p;
+		parseReal(p, pEnd, &r.fValue);
+		break;
+	default:
+		break;
+	}
+}
+
+
+bool LogParser::parse(const char* p, size_t cb, LogRecord* pRecord, int* anKeys)
+{
+	LogRecord& r = *pRecord;
+	if (cb > 0 && p[cb - 1] == '\r')
+		--cb;
+	if (!parseStamp(p, cb, &r))
+		return false;
+	r.ullStartNs = 0;
+	r.ullEndNs = 0;
+	r.ullFirstEventNs = 0;
+	r.ullLastEventNs = 0;
+	r.fValue = 0;
+	r.fMeters = 0;
+	r.nCount = 0;
+	const char* pType = p + 20;
+	const char* pEnd = p + cb;
+	const char* pSpace = (const char*)memchr(pType, ' ', pEnd - pType);
+	r.name.p = pType;
+	r.name.cb = (pSpace? pSpace : pEnd) - pType;
+	r.args.p = pSpace? pSpace + 1 : pEnd;
+	r.args.cb = pEnd - r.args.p;
+	r.type = r.name.cb > 0? classify(r.name.p, r.name.cb) : RecordUnknown;
+	parseArgs(r, anKeys);
+	return true;
+}
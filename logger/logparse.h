@@ -0,0 +1,107 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// A piece of a line. It points into the caller's buffer; nothing is
+/// copied, so it is only valid as long as that buffer is.
+struct TextSpan {
+	const char* p;
+	size_t cb;
+};
+
+
+/// Types of the lines written by Logger::logWithTimestamp().
+enum RecordType {
+	RecordUnknown,
+	RecordInterval,
+	RecordPartial,
+	RecordRecover,
+	RecordMove,
+	RecordWheel,
+	RecordClick,
+	RecordDoubleClick,
+	RecordKeyStat,
+	RecordStart,
+	RecordStop,
+	RecordBreak,
+	RecordClosed,
+	RecordLogoff,
+	RecordShutdown,
+	RecordClock,
+	RecordKeyClass,
+	RecordSelfStat,
+	RecordWarp,
+	RecordActive,
+	RecordAnomaly,
+	RecordConfig,
+	RecordDevice,
+	NumRecordTypes
+};
+
+
+/// One parsed line. The numeric fields are filled in for the types they
+/// belong to and are zero otherwise:
+///   INTERVAL  ullStartNs, ullEndNs, ullFirstEventNs, ullLastEventNs
+///   PARTIAL   fValue = seconds
+///   MOVE      fValue = pixels, fMeters
+///   WHEEL, CLICK, DBLCLICK  nCount
+///   WARP      nCount, fValue = pixels
+///   KEYSTAT   nCount = number of counts stored in the caller's array
+///   KEYCLASS  the same, one count per KeyClass
+///   START     nCount = interval in seconds, fValue = dpi
+struct LogRecord {
+	RecordType type;
+	WORD wYear;
+	WORD wMonth;
+	WORD wDay;
+	WORD wHour;
+	WORD wMinute;
+	WORD wSecond;
+	TextSpan name;
+	TextSpan args;
+	ULONGLONG ullStartNs;
+	ULONGLONG ullEndNs;
+	ULONGLONG ullFirstEventNs;
+	ULONGLONG ullLastEventNs;
+	double fValue;
+	double fMeters;
+	int nCount;
+};
+
+
+/// Parser for the text log format, "YYYY-MM-DD hh:mm:ss TYPE args" with
+/// the time stamp in local time. It works in place on the caller's
+/// buffer, which need not be NUL-terminated, never reads past the given
+/// length, and converts numbers without the C runtime (no locale, no
+/// copies), so that KEYSTAT-heavy logs are limited by the disk rather
+/// than by parsing. Malformed numbers end the field where they stop
+/// being numbers instead of failing the whole line.
+class LogParser {
+public:
+	static bool parse(const char* p, size_t cb, LogRecord* pRecord, int* anKeys = NULL);
+	static bool parseTimestamp(const char* p, size_t cb, ULONGLONG* pullUtc);
+	static bool toUtc(const LogRecord& r, ULONGLONG* pullUtc);
+	static const char* name(RecordType type);
+
+private:
+	static bool parseStamp(const char* p, size_t cb, LogRecord* pRecord);
+	static RecordType classify(const char* p, size_t cb);
+	static void parseArgs(LogRecord& r, int* anKeys);
+};
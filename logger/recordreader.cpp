@@ -0,0 +1,272 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "recordreader.h"
+#include <string.h>
+
+
+RecordReader::RecordReader(Arena& arena)
+	: arena(arena)
+	, hFile(INVALID_HANDLE_VALUE)
+	, nSlots(0)
+	, iSlot(0)
+	, bLoaded(false)
+	, bDirect(false)
+	, bCompressed(false)
+	, ullNextOffset(0)
+	, cbSkip(0)
+	, pPos(NULL)
+	, pEnd(NULL)
+	, aRecords(NULL)
+	, nBatchSize(0)
+	, bEof(true)
+	, bSkipLine(false)
+	, bFailed(false)
+{
+	for (int i = 0; i < QueueDepth; ++i) {
+		ZeroMemory(&aSlots[i].ov, sizeof(OVERLAPPED));
+		aSlots[i].bPending = false;
+	}
+}
+
+
+RecordReader::~RecordReader()
+{
+	close();
+	for (int i = 0; i < QueueDepth; ++i)
+		if (aSlots[i].ov.hEvent)
+			CloseHandle(aSlots[i].ov.hEvent);
+}
+
+
+void RecordReader::close()
+{
+	// the buffers belong to the arena, so no read may still be
+	// writing into them once the file is closed
+	if (hFile != INVALID_HANDLE_VALUE) {
+		if (bDirect) {
+			CancelIo(hFile);
+			for (int i = 0; i < nSlots; ++i)
+				complete(aSlots[i]);
+		}
+		CloseHandle(hFile);
+	}
+	hFile = INVALID_HANDLE_VALUE;
+	bEof = true;
+}
+
+
+bool RecordReader::open(const TCHAR* pszFilename, UINT nBatchSize, bool bDirect)
+{
+	close();
+	this->nBatchSize = nBatchSize > 0? nBatchSize : 1;
+	hFile = INVALID_HANDLE_VALUE;
+	// compressed data is not read at sector boundaries
+	bCompressed = GzipReader::isGzipFile(pszFilename);
+	if (bDirect && !bCompressed)
+		hFile = CreateFile(pszFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING, NULL);
+	this->bDirect = hFile != INVALID_HANDLE_VALUE;
+	if (hFile == INVALID_HANDLE_VALUE)
+		hFile = CreateFile(pszFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	// unbuffered reads need sector-aligned buffers; MaxLineLength is a
+	// multiple of every common sector size, so the data stays aligned
+	nSlots = this->bDirect? QueueDepth : 1;
+	for (int i = 0; i < nSlots; ++i) {
+		char* pSlot = (char*)arena.alloc(MaxLineLength + ReadBufSize, MaxLineLength);
+		aSlots[i].pData = pSlot? pSlot + MaxLineLength : NULL;
+		aSlots[i].bPending = false;
+		aSlots[i].cbRead = 0;
+		if (this->bDirect && aSlots[i].ov.hEvent == NULL)
+			aSlots[i].ov.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (pSlot == NULL || (this->bDirect && aSlots[i].ov.hEvent == NULL)) {
+			close();
+			return false;
+		}
+	}
+	aRecords = (ParsedRecord*)arena.alloc(this->nBatchSize * sizeof(ParsedRecord));
+	if (aRecords == NULL) {
+		close();
+		return false;
+	}
+	if (bCompressed) {
+		BYTE* pInput = (BYTE*)arena.alloc(GzipReader::InputSize);
+		BYTE* pWindow = (BYTE*)arena.alloc(GzipReader::WindowSize);
+		if (pInput == NULL || pWindow == NULL) {
+			close();
+			return false;
+		}
+		gzip.attach(hFile, pInput, pWindow);
+	}
+	iSlot = 0;
+	bLoaded = false;
+	ullNextOffset = 0;
+	cbSkip = 0;
+	pPos = pEnd = aSlots[0].pData;
+	bEof = false;
+	bSkipLine = false;
+	bFailed = false;
+	if (this->bDirect)
+		for (int i = 0; i < nSlots; ++i)
+			issue(aSlots[i]);
+	return true;
+}
+
+
+bool RecordReader::seek(ULONGLONG ullOffset)
+{
+	// unbuffered reads must start on a sector boundary, so reading starts
+	// at the boundary below and the bytes up to the offset are dropped;
+	// a compressed file is entered at a member, offset and all
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	if (bDirect) {
+		CancelIo(hFile);
+		for (int i = 0; i < nSlots; ++i)
+			complete(aSlots[i]);
+	}
+	ullNextOffset = bCompressed? ullOffset : ullOffset / MaxLineLength * MaxLineLength;
+	cbSkip = (DWORD)(ullOffset - ullNextOffset);
+	if (!bDirect) {
+		LARGE_INTEGER liOffset;
+		liOffset.QuadPart = (LONGLONG)ullNextOffset;
+		if (!SetFilePointerEx(hFile, liOffset, NULL, FILE_BEGIN))
+			return false;
+	}
+	if (bCompressed)
+		gzip.restart();
+	iSlot = 0;
+	bLoaded = false;
+	pPos = pEnd = aSlots[0].pData;
+	bEof = false;
+	bSkipLine = false;
+	if (bDirect)
+		for (int i = 0; i < nSlots; ++i)
+			issue(aSlots[i]);
+	return true;
+}
+
+
+void RecordReader::issue(Slot& slot)
+{
+	ULARGE_INTEGER u;
+	u.QuadPart = ullNextOffset;
+	ullNextOffset += ReadBufSize;
+	slot.ov.Offset = u.LowPart;
+	slot.ov.OffsetHigh = u.HighPart;
+	slot.cbRead = 0;
+	// completed or not, the result is collected by complete()
+	slot.bPending = ReadFile(hFile, slot.pData, ReadBufSize, NULL, &slot.ov) || GetLastError() == ERROR_IO_PENDING;
+	if (!slot.bPending && GetLastError() != ERROR_HANDLE_EOF)
+		bFailed = true;
+}
+
+
+DWORD RecordReader::complete(Slot& slot)
+{
+	if (!slot.bPending)
+		return slot.cbRead;
+	slot.bPending = false;
+	if (!GetOverlappedResult(hFile, &slot.ov, &slot.cbRead, TRUE)) {
+		const DWORD dwError = GetLastError();
+		if (dwError != ERROR_HANDLE_EOF && dwError != ERROR_OPERATION_ABORTED)
+			bFailed = true;
+		slot.cbRead = 0;
+	}
+	return slot.cbRead;
+}
+
+
+bool RecordReader::refill()
+{
+	// carry the incomplete last line over in front of the next block
+	size_t cbTail = pEnd - pPos;
+	if (cbTail > MaxLineLength) {
+		bSkipLine = true;
+		cbTail = 0;
+	}
+	const int iNext = bLoaded? (iSlot + 1) % nSlots : iSlot;
+	Slot& slot = aSlots[iNext];
+	memmove(slot.pData - cbTail, pPos, cbTail);
+	DWORD dwRead = 0;
+	if (bDirect) {
+		// the block just parsed is free again and can be read ahead
+		if (bLoaded)
+			issue(aSlots[iSlot]);
+		dwRead = complete(slot);
+	}
+	else if (bCompressed) {
+		dwRead = gzip.read((BYTE*)slot.pData, ReadBufSize);
+		if (gzip.failed())
+			bFailed = true;
+	}
+	else if (!ReadFile(hFile, slot.pData, ReadBufSize, &dwRead, NULL)) {
+		bFailed = true;
+		dwRead = 0;
+	}
+	iSlot = iNext;
+	bLoaded = true;
+	pPos = slot.pData - cbTail;
+	pEnd = slot.pData + dwRead;
+	if (cbSkip > 0) {
+		pPos += cbSkip < dwRead? cbSkip : dwRead;
+		cbSkip = 0;
+	}
+	if (dwRead == 0)
+		bEof = true;
+	return dwRead > 0;
+}
+
+
+void RecordReader::add(const char* pLine, size_t cbLine, UINT& nRecords)
+{
+	// lines without a time stamp are not records
+	ParsedRecord& r = aRecords[nRecords];
+	if (LogParser::parse(pLine, cbLine, &r.rec, r.anKeys))
+		++nRecords;
+}
+
+
+UINT RecordReader::next()
+{
+	UINT nRecords = 0;
+	if (hFile == INVALID_HANDLE_VALUE)
+		return 0;
+	while (nRecords < nBatchSize) {
+		char* pNewline = (char*)memchr(pPos, '\n', pEnd - pPos);
+		if (pNewline == NULL) {
+			if (bEof) {
+				if (pPos < pEnd && !bSkipLine)
+					add(pPos, pEnd - pPos, nRecords);
+				pPos = pEnd;
+				break;
+			}
+			// refilling moves the buffer under the records already parsed
+			if (nRecords > 0)
+				break;
+			if (!refill() && pPos == pEnd)
+				break;
+			continue;
+		}
+		if (bSkipLine)
+			bSkipLine = false;
+		else
+			add(pPos, pNewline - pPos, nRecords);
+		pPos = pNewline + 1;
+	}
+	return nRecords;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+#include "arena.h"
+#include "logparse.h"
+#include "gzipreader.h"
+
+/// A parsed line with room for all 256 KEYSTAT counters, so that a batch
+/// of records is one flat array of equally sized elements.
+struct ParsedRecord {
+	LogRecord rec;
+	int anKeys[256];
+};
+
+
+/// Reads a log file sequentially and parses it a batch of records at a
+/// time. The read buffer and the batch are taken from the caller's arena
+/// when the file is opened and are reused for every batch, so reading
+/// does not allocate after open(); resetting the arena before opening the
+/// next file recycles them across files as well. The records point into
+/// the read buffer and are valid until the next call to next(). Lines
+/// longer than MaxLineLength are skipped. seek() continues reading at
+/// a byte offset, e.g. one that LogIndex::lookup() has found.
+///
+/// With bDirect the file is read unbuffered and overlapped: QueueDepth
+/// sector-aligned blocks are in flight at any time, so that the disk is
+/// kept busy while the previous block is parsed, and the archive being
+/// scanned does not evict everything else from the file cache. If the
+/// file cannot be opened that way, reading falls back to plain ReadFile.
+///
+/// A gzip file, such as actilog --gzip writes, is inflated as it is
+/// read, always through plain ReadFile. Its input buffer and window come
+/// from the arena as well. Offsets passed to seek() are then those of
+/// gzip members, which is what the index of a compressed log records.
+class RecordReader {
+public:
+	static const DWORD ReadBufSize = 256 * 1024;
+	static const DWORD MaxLineLength = 4096;
+	static const UINT DefaultBatchSize = 1024;
+	static const int QueueDepth = 4;
+
+	RecordReader(Arena& arena);
+	~RecordReader();
+	bool open(const TCHAR* pszFilename, UINT nBatchSize = DefaultBatchSize, bool bDirect = false);
+	void close();
+	bool seek(ULONGLONG ullOffset);
+	UINT next();
+	const ParsedRecord& record(UINT i) const { return aRecords[i]; }
+	bool failed() const { return bFailed; }
+	bool isDirect() const { return bDirect; }
+	bool isCompressed() const { return bCompressed; }
+
+private:
+	// a block to read into, preceded by room for the incomplete last
+	// line of the block before it
+	struct Slot {
+		char* pData;
+		OVERLAPPED ov;
+		bool bPending;
+		DWORD cbRead;
+	};
+	Arena& arena;
+	HANDLE hFile;
+	Slot aSlots[QueueDepth];
+	int nSlots;
+	int iSlot;
+	bool bLoaded;
+	bool bDirect;
+	bool bCompressed;
+	GzipReader gzip;
+	ULONGLONG ullNextOffset;
+	DWORD cbSkip;
+	char* pPos;
+	char* pEnd;
+	ParsedRecord* aRecords;
+	UINT nBatchSize;
+	bool bEof;
+	bool bSkipLine;
+	bool bFailed;
+	bool refill();
+	void issue(Slot& slot);
+	DWORD complete(Slot& slot);
+	void add(const char* pLine, size_t cbLine, UINT& nRecords);
+};
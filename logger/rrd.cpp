@@ -0,0 +1,189 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "rrd.h"
+
+const DWORD RoundRobinArchive::Magic = 0x44525241; // "ARRD"
+const DWORD RoundRobinArchive::Version = 1;
+
+
+RoundRobinArchive::RoundRobinArchive()
+	: hFile(INVALID_HANDLE_VALUE)
+	, hMapping(NULL)
+	, pBase(NULL)
+	, uStep(0)
+	, uRows(0)
+	, bReadOnly(false)
+{
+	// ...
+}
+
+
+RoundRobinArchive::~RoundRobinArchive()
+{
+	close();
+}
+
+
+void RoundRobinArchive::close()
+{
+	if (pBase) {
+		if (!bReadOnly)
+			FlushViewOfFile(pBase, 0);
+		UnmapViewOfFile(pBase);
+	}
+	pBase = NULL;
+	bReadOnly = false;
+	if (hMapping)
+		CloseHandle(hMapping);
+	hMapping = NULL;
+	if (hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(hFile);
+	hFile = INVALID_HANDLE_VALUE;
+}
+
+
+bool RoundRobinArchive::open(const TCHAR* pszFilename, UINT uStep, UINT uRows)
+{
+	close();
+	if (uStep == 0 || uRows == 0)
+		return false;
+	this->uStep = uStep;
+	this->uRows = uRows;
+	ULARGE_INTEGER cbFile;
+	cbFile.QuadPart = sizeof(Header) + (ULONGLONG)uRows * sizeof(RrdRecord);
+	hFile = CreateFile(pszFilename, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	// the mapping extends the file to its full size right away
+	hMapping = CreateFileMapping(hFile, NULL, PAGE_READWRITE, cbFile.HighPart, cbFile.LowPart, NULL);
+	if (hMapping == NULL) {
+		close();
+		return false;
+	}
+	pBase = (BYTE*)MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)cbFile.QuadPart);
+	if (pBase == NULL) {
+		close();
+		return false;
+	}
+	Header* pHeader = header();
+	if (pHeader->dwMagic != Magic || pHeader->dwVersion != Version || pHeader->uStep != uStep || pHeader->uRows != uRows) {
+		ZeroMemory(pBase, (SIZE_T)cbFile.QuadPart);
+		pHeader->dwMagic = Magic;
+		pHeader->dwVersion = Version;
+		pHeader->uStep = uStep;
+		pHeader->uRows = uRows;
+		pHeader->ullLastSlot = 0;
+	}
+	return true;
+}
+
+
+bool RoundRobinArchive::open(const TCHAR* pszFilename)
+{
+	close();
+	hFile = CreateFile(pszFilename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER liSize;
+	if (!GetFileSizeEx(hFile, &liSize) || liSize.QuadPart < (LONGLONG)sizeof(Header)) {
+		close();
+		return false;
+	}
+	hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hMapping == NULL) {
+		close();
+		return false;
+	}
+	pBase = (BYTE*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	if (pBase == NULL) {
+		close();
+		return false;
+	}
+	bReadOnly = true;
+	const Header* pHeader = header();
+	if (pHeader->dwMagic != Magic || pHeader->dwVersion != Version || pHeader->uStep == 0 || pHeader->uRows == 0
+		|| (ULONGLONG)liSize.QuadPart < sizeof(Header) + (ULONGLONG)pHeader->uRows * sizeof(RrdRecord)) {
+		close();
+		return false;
+	}
+	uStep = pHeader->uStep;
+	uRows = pHeader->uRows;
+	return true;
+}
+
+
+void RoundRobinArchive::update(ULONGLONG ullUtc, const RrdRecord& values)
+{
+	if (pBase == NULL || bReadOnly)
+		return;
+	Header* pHeader = header();
+	const ULONGLONG ullSlot = slotOf(ullUtc);
+	if (ullSlot > pHeader->ullLastSlot) {
+		// start the rows between the last update and now afresh; never
+		// more than one full turn of the ring
+		ULONGLONG ullFirst = pHeader->ullLastSlot + 1;
+		if (pHeader->ullLastSlot == 0 || ullSlot - ullFirst >= uRows)
+			ullFirst = ullSlot >= uRows? ullSlot - uRows + 1 : 0;
+		for (ULONGLONG s = ullFirst; s <= ullSlot; ++s) {
+			RrdRecord* pRow = row(s);
+			ZeroMemory(pRow, sizeof(RrdRecord));
+			pRow->ullSlot = s;
+		}
+		pHeader->ullLastSlot = ullSlot;
+	}
+	else if (pHeader->ullLastSlot - ullSlot >= uRows) {
+		// older than anything the archive still holds
+		return;
+	}
+	RrdRecord* pRow = row(ullSlot);
+	if (pRow->ullSlot != ullSlot)
+		return;
+	pRow->fMouseDist += values.fMouseDist;
+	pRow->nClicks += values.nClicks;
+	pRow->nDoubleClicks += values.nDoubleClicks;
+	pRow->nWheel += values.nWheel;
+	pRow->nKeys += values.nKeys;
+}
+
+
+UINT RoundRobinArchive::query(ULONGLONG ullFromUtc, ULONGLONG ullToUtc, RrdRecord* pDest, UINT nMax) const
+{
+	// copies the rows covering [ullFromUtc, ullToUtc) that are still held
+	if (pBase == NULL)
+		return 0;
+	const ULONGLONG ullLast = header()->ullLastSlot;
+	ULONGLONG ullFrom = slotOf(ullFromUtc);
+	ULONGLONG ullTo = slotOf(ullToUtc + 10000000ULL * uStep - 1);
+	if (ullLast >= uRows && ullFrom < ullLast - uRows + 1)
+		ullFrom = ullLast - uRows + 1;
+	if (ullTo > ullLast + 1)
+		ullTo = ullLast + 1;
+	UINT n = 0;
+	for (ULONGLONG s = ullFrom; s < ullTo && n < nMax; ++s) {
+		const RrdRecord* pRow = row(s);
+		if (pRow->ullSlot == s)
+			pDest[n++] = *pRow;
+	}
+	return n;
+}
+
+
+void RoundRobinArchive::sync()
+{
+	if (pBase && !bReadOnly)
+		FlushViewOfFile(pBase, 0);
+}
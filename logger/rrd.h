@@ -0,0 +1,76 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+#include <tchar.h>
+
+/// One consolidated data point of a round-robin archive.
+struct RrdRecord {
+	ULONGLONG ullSlot; // UTC time in units of the archive's step
+	double fMouseDist;
+	DWORD nClicks;
+	DWORD nDoubleClicks;
+	DWORD nWheel;
+	DWORD nKeys;
+};
+
+
+/// Round-robin archive in the spirit of RRDtool: a preallocated,
+/// memory-mapped file of a fixed number of rows, each covering 'step'
+/// seconds of UTC time. Updates are added into the row of their slot
+/// (SUM consolidation), so coarser archives fed from the same stream
+/// consolidate incrementally on every write. The row of a slot is
+/// slot % rows, which makes seeking to a point in time O(1). Opened
+/// with the file name only, an existing archive is mapped read-only with
+/// the step and rows from its header, e.g. for reading it while actilog
+/// keeps updating it.
+class RoundRobinArchive {
+public:
+	RoundRobinArchive();
+	~RoundRobinArchive();
+	bool open(const TCHAR* pszFilename, UINT uStep, UINT uRows);
+	bool open(const TCHAR* pszFilename);
+	void close();
+	bool isOpen() const { return pBase != NULL; }
+	void update(ULONGLONG ullUtc, const RrdRecord& values);
+	UINT query(ULONGLONG ullFromUtc, ULONGLONG ullToUtc, RrdRecord* pDest, UINT nMax) const;
+	void sync();
+	UINT step() const { return uStep; }
+	UINT rows() const { return uRows; }
+	ULONGLONG lastUtc() const { return pBase? header()->ullLastSlot * 10000000ULL * uStep : 0; }
+
+private:
+	static const DWORD Magic;
+	static const DWORD Version;
+	struct Header {
+		DWORD dwMagic;
+		DWORD dwVersion;
+		DWORD uStep;
+		DWORD uRows;
+		ULONGLONG ullLastSlot;
+	};
+	HANDLE hFile;
+	HANDLE hMapping;
+	BYTE* pBase;
+	UINT uStep;
+	UINT uRows;
+	bool bReadOnly;
+	Header* header() const { return (Header*)pBase; }
+	RrdRecord* row(ULONGLONG ullSlot) const { return (RrdRecord*)(pBase + sizeof(Header)) + (ullSlot % uRows); }
+	ULONGLONG slotOf(ULONGLONG ullUtc) const { return ullUtc / (10000000ULL * uStep); }
+};
@@ -0,0 +1,126 @@
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include "textbuf.h"
+
+
+void TextBuffer::append(char ch)
+{
+	if (cbData < Capacity)
+		aData[cbData++] = ch;
+	else
+		bOverflow = true;
+}
+
+
+void TextBuffer::append(const char* psz)
+{
+	while (*psz)
+		append(*psz++);
+}
+
+
+void TextBuffer::appendUInt(ULONGLONG ullValue)
+{
+	char aDigits[20];
+	int n = 0;
+	do {
+		aDigits[n++] = (char)('0' + ullValue % 10);
+		ullValue /= 10;
+	} while (ullValue != 0);
+	while (n > 0)
+		append(aDigits[--n]);
+}
+
+
+void TextBuffer::appendInt(LONGLONG llValue)
+{
+	if (llValue < 0) {
+		append('-');
+		appendUInt((ULONGLONG)(-(llValue + 1)) + 1);
+	}
+	else {
+		appendUInt((ULONGLONG)llValue);
+	}
+}
+
+
+void TextBuffer::appendFixed(double fValue, int nDecimals)
+{
+	// counters never come close to 2^64 / 10^nDecimals, so scaling to an
+	// integer and printing that loses nothing that %lf would have shown
+	if (fValue < 0) {
+		append('-');
+		fValue = -fValue;
+	}
+	ULONGLONG ullScale = 1;
+	for (int i = 0; i < nDecimals; ++i)
+		ullScale *= 10;
+	const ULONGLONG ullScaled = (ULONGLONG)(fValue * (double)ullScale + 0.5);
+	appendUInt(ullScaled / ullScale);
+	if (nDecimals == 0)
+		return;
+	append('.');
+	ULONGLONG ullFraction = ullScaled % ullScale;
+	for (ULONGLONG ullDigit = ullScale / 10; ullDigit > 0; ullDigit /= 10) {
+		append((char)('0' + ullFraction / ullDigit));
+		ullFraction %= ullDigit;
+	}
+}
+
+
+void TextBuffer::appendUtc(ULONGLONG ullUtc)
+{
+	// ISO 8601 in UTC with 100 ns resolution, e.g. 2013-05-17T08:10:00.0000000Z
+	ULARGE_INTEGER u;
+	u.QuadPart = ullUtc;
+	FILETIME ft;
+	ft.dwLowDateTime = u.LowPart;
+	ft.dwHighDateTime = u.HighPart;
+	SYSTEMTIME t;
+	FileTimeToSystemTime(&ft, &t);
+	const WORD aFields[6] = { t.wYear, t.wMonth, t.wDay, t.wHour, t.wMinute, t.wSecond };
+	static const char aSeparators[6] = { '-', '-', 'T', ':', ':', '.' };
+	for (int i = 0; i < 6; ++i) {
+		if (i == 0) {
+			append((char)('0' + aFields[0] / 1000));
+			append((char)('0' + aFields[0] / 100 % 10));
+		}
+		append((char)('0' + aFields[i] / 10 % 10));
+		append((char)('0' + aFields[i] % 10));
+		append(aSeparators[i]);
+	}
+	UINT uFraction = (UINT)(ullUtc % 10000000);
+	for (UINT uDigit = 1000000; uDigit > 0; uDigit /= 10) {
+		append((char)('0' + uFraction / uDigit));
+		uFraction %= uDigit;
+	}
+	append('Z');
+}
+
+
+void TextBuffer::appendQuoted(const char* psz)
+{
+	// only used for fixed identifiers, so escaping quotes and
+	// backslashes is all JSON needs here
+	append('"');
+	for (; *psz; ++psz) {
+		if (*psz == '"' || *psz == '\\')
+			append('\\');
+		append(*psz);
+	}
+	append('"');
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+///    Copyright (C) 2013 Oliver Lau <ola@ct.de>
+///
+///    This program is free software: you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation, either version 3 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License
+///    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+///
+
+#include <windows.h>
+
+/// Fixed-size text buffer with hand-rolled number formatting for the
+/// structured output modes. Nothing is allocated and no locale or
+/// format string is consulted; if the buffer runs full further appends
+/// are dropped and overflowed() reports it.
+class TextBuffer {
+public:
+	static const size_t Capacity = 8192;
+	TextBuffer() : cbData(0), bOverflow(false) { /* ... */ }
+	void clear() { cbData = 0; bOverflow = false; }
+	const char* data() const { return aData; }
+	size_t size() const { return cbData; }
+	bool overflowed() const { return bOverflow; }
+	void append(char ch);
+	void append(const char* psz);
+	void appendUInt(ULONGLONG ullValue);
+	void appendInt(LONGLONG llValue);
+	void appendFixed(double fValue, int nDecimals);
+	void appendUtc(ULONGLONG ullUtc);
+	void appendQuoted(const char* psz);
+
+private:
+	char aData[Capacity];
+	size_t cbData;
+	bool bOverflow;
+};